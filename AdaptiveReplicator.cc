@@ -0,0 +1,436 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/core-module.h"
+#include "process-launcher.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+// Replicates one configuration of HomeNetwork or IITGoaNetwork until the
+// metrics of interest are known precisely enough.
+//
+// Independent RNG runs (--RngRun=firstRun, firstRun+1, ...) are started in
+// parallel, one per core, each in <out>/run-<r> with its --results summary.
+// Finished runs are folded into a running mean and variance (Welford) per
+// metric in run order, so the outcome does not depend on which run
+// finishes first.  From minRuns on, a metric has converged once the
+// half-width of its Student t confidence interval is at most precision
+// times its mean (or at most absolute, for metrics close to zero).  When
+// all have, the runs still going are stopped and no more are started.
+//
+// A metric whose interval, shrinking as 1/sqrt(n), would need more than
+// maxRuns runs is reported as not converging as soon as that is clear,
+// and the replication gives up at maxRuns.  A failed run is replaced by
+// the next one, up to maxFailures failures; then the replication stops
+// with what it has and exits with 1.  Runs with a summary from an
+// earlier invocation are reused.  <out>/convergence.csv holds the final
+// estimate of every metric and <out>/runs.csv the metrics of every run.
+//
+//   build/scratch/AdaptiveReplicator --program=build/scratch/IITGoaNetwork
+//       --metrics=rtt_mean_ms,echo_loss --precision=0.02 --out=replicas
+//       --args="--tracing=false --animation=false --nWifi=32"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("AdaptiveReplicator");
+
+// Running mean and variance, Welford's update.
+struct MetricEstimate
+{
+  MetricEstimate()
+    : n(0),
+      mean(0),
+      m2(0),
+      converged(false),
+      flagged(false)
+  {
+  }
+
+  void Add(double x)
+  {
+    n++;
+    double delta = x - mean;
+    mean += delta / n;
+    m2 += delta * (x - mean);
+  }
+
+  double Stddev() const
+  {
+    return n > 1 ? std::sqrt(m2 / (n - 1)) : 0.0;
+  }
+
+  uint32_t n;
+  double mean;
+  double m2;
+  bool converged;
+  bool flagged;
+};
+
+// Regularized incomplete beta function I_x(a, b), continued fraction
+// evaluated with the modified Lentz method.
+static double IncompleteBeta(double a, double b, double x)
+{
+  if (x <= 0)
+  {
+    return 0;
+  }
+  if (x >= 1)
+  {
+    return 1;
+  }
+  if (x > (a + 1) / (a + b + 2))
+  {
+    return 1 - IncompleteBeta(b, a, 1 - x);
+  }
+  double front = std::exp(std::lgamma(a + b) - std::lgamma(a) - std::lgamma(b) + a * std::log(x) + b * std::log(1 - x)) / a;
+  const double tiny = 1e-300;
+  double f = 1;
+  double c = 1;
+  double d = 0;
+  for (int i = 0; i <= 400; i++)
+  {
+    int m = i / 2;
+    double numerator;
+    if (i == 0)
+    {
+      numerator = 1;
+    }
+    else if (i % 2 == 0)
+    {
+      numerator = m * (b - m) * x / ((a + 2 * m - 1) * (a + 2 * m));
+    }
+    else
+    {
+      numerator = -(a + m) * (a + b + m) * x / ((a + 2 * m) * (a + 2 * m + 1));
+    }
+    d = 1 + numerator * d;
+    d = std::fabs(d) < tiny ? tiny : d;
+    d = 1 / d;
+    c = 1 + numerator / c;
+    c = std::fabs(c) < tiny ? tiny : c;
+    double step = c * d;
+    f *= step;
+    if (std::fabs(1 - step) < 1e-12)
+    {
+      break;
+    }
+  }
+  return front * (f - 1);
+}
+
+// Quantile p > 0.5 of Student's t distribution with df degrees of
+// freedom, by bisection on its distribution function.
+static double StudentQuantile(double p, uint32_t df)
+{
+  double lo = 0;
+  double hi = 1e4;
+  for (int i = 0; i < 200; i++)
+  {
+    double t = 0.5 * (lo + hi);
+    double cdf = 1 - 0.5 * IncompleteBeta(df / 2.0, 0.5, df / (df + t * t));
+    if (cdf < p)
+    {
+      lo = t;
+    }
+    else
+    {
+      hi = t;
+    }
+  }
+  return 0.5 * (lo + hi);
+}
+
+static bool ReadSummary(const std::string &path, std::map<std::string, double> &values)
+{
+  std::ifstream in(path.c_str());
+  std::string header;
+  std::string line;
+  if (!std::getline(in, header) || !std::getline(in, line))
+  {
+    return false;
+  }
+  std::vector<std::string> names = ProcessLauncher::Split(header, ',');
+  std::vector<std::string> cells = ProcessLauncher::Split(line, ',');
+  for (size_t c = 0; c < names.size() && c < cells.size(); c++)
+  {
+    values[names[c]] = std::atof(cells[c].c_str());
+  }
+  return true;
+}
+
+static pid_t Launch(const std::string &program, const std::string &dir, uint32_t seed, uint32_t run,
+                    const std::vector<std::string> &extra, int cpu)
+{
+  std::vector<std::string> args;
+  args.push_back(program);
+  args.push_back("--RngSeed=" + std::to_string(seed));
+  args.push_back("--RngRun=" + std::to_string(run));
+  args.push_back("--results=summary.csv");
+  args.insert(args.end(), extra.begin(), extra.end());
+
+  return ProcessLauncher::Launch(program, args, dir, cpu);
+}
+
+int main(int argc, char *argv[])
+{
+  std::string program = "";
+  std::string args = "";
+  std::string out = "replicas";
+  std::string metrics = "rtt_mean_ms,echo_loss";
+  double precision = 0.05;
+  double absolute = 1e-6;
+  double confidence = 0.95;
+  uint32_t minRuns = 5;
+  uint32_t maxRuns = 200;
+  uint32_t maxFailures = 10;
+  uint32_t firstRun = 1;
+  uint32_t seed = 1;
+  uint32_t jobs = 0;
+
+  CommandLine cmd(__FILE__);
+  cmd.AddValue("program", "Scenario binary to run (e.g. build/scratch/IITGoaNetwork)", program);
+  cmd.AddValue("args", "Extra arguments passed to every run", args);
+  cmd.AddValue("out", "Directory holding one sub-directory per run", out);
+  cmd.AddValue("metrics", "Summary columns that have to converge, comma separated", metrics);
+  cmd.AddValue("precision", "Largest confidence interval half-width, relative to the mean", precision);
+  cmd.AddValue("absolute", "Half-width that is always small enough (for metrics near zero)", absolute);
+  cmd.AddValue("confidence", "Confidence level of the intervals", confidence);
+  cmd.AddValue("minRuns", "Runs before convergence is first checked", minRuns);
+  cmd.AddValue("maxRuns", "Runs after which the replication gives up", maxRuns);
+  cmd.AddValue("maxFailures", "Failed runs after which the replication stops", maxFailures);
+  cmd.AddValue("firstRun", "First RngRun value", firstRun);
+  cmd.AddValue("seed", "RngSeed passed to every run", seed);
+  cmd.AddValue("jobs", "Concurrent runs (0: one per available core)", jobs);
+  cmd.Parse(argc, argv);
+
+  NS_ABORT_MSG_IF(program.empty(), "--program is required");
+  NS_ABORT_MSG_UNLESS(confidence > 0 && confidence < 1, "--confidence must be between 0 and 1");
+  NS_ABORT_MSG_UNLESS(minRuns >= 2 && maxRuns >= minRuns, "Need 2 <= minRuns <= maxRuns");
+  NS_ABORT_MSG_IF(maxFailures == 0, "--maxFailures must be at least 1");
+  std::vector<std::string> names = ProcessLauncher::Split(metrics, ',');
+  NS_ABORT_MSG_IF(names.empty(), "--metrics is empty");
+  char resolved[PATH_MAX];
+  NS_ABORT_MSG_UNLESS(realpath(program.c_str(), resolved), "Cannot find " << program);
+  program = resolved;
+  ProcessLauncher::MakeDirs(out);
+  NS_ABORT_MSG_UNLESS(realpath(out.c_str(), resolved), "Cannot resolve " << out);
+  out = resolved;
+
+  // One slot per core this process may use.
+  std::vector<int> cpus = ProcessLauncher::GetCpus();
+  if (jobs == 0 || jobs > cpus.size())
+  {
+    jobs = cpus.size();
+  }
+
+  std::vector<std::string> extra = ProcessLauncher::Split(args, ' ');
+  std::vector<MetricEstimate> estimates(names.size());
+  std::vector<std::map<std::string, double> > folded;
+  std::map<uint32_t, std::map<std::string, double> > finished;
+  std::vector<pid_t> slots(jobs, 0);
+  std::map<pid_t, uint32_t> running;
+  uint32_t next = firstRun;
+  uint32_t nextFold = firstRun;
+  uint32_t failed = 0;
+  bool done = false;
+  std::cout << "Replicating with up to " << jobs << " runs in parallel" << std::endl;
+
+  while (!done)
+  {
+    // Runs that are folded in by the time they finish never exceed maxRuns.
+    for (size_t s = 0; s < slots.size() && next < firstRun + maxRuns + failed; s++)
+    {
+      if (slots[s] != 0)
+      {
+        continue;
+      }
+      uint32_t run = next++;
+      std::string dir = out + "/run-" + std::to_string(run);
+      std::map<std::string, double> values;
+      if (ReadSummary(dir + "/summary.csv", values))
+      {
+        finished[run] = values;
+        continue;
+      }
+      ProcessLauncher::MakeDirs(dir);
+      slots[s] = Launch(program, dir, seed, run, extra, cpus[s]);
+      running[slots[s]] = run;
+    }
+
+    if (finished.find(nextFold) == finished.end() && !running.empty())
+    {
+      int status = 0;
+      pid_t pid = waitpid(-1, &status, 0);
+      if (pid < 0)
+      {
+        NS_ABORT_MSG_UNLESS(errno == EINTR, "waitpid failed: " << std::strerror(errno));
+        continue;
+      }
+      uint32_t run = running[pid];
+      running.erase(pid);
+      for (size_t s = 0; s < slots.size(); s++)
+      {
+        if (slots[s] == pid)
+        {
+          slots[s] = 0;
+        }
+      }
+      std::string dir = out + "/run-" + std::to_string(run);
+      std::map<std::string, double> values;
+      if (WIFEXITED(status) && WEXITSTATUS(status) == 0 && ReadSummary(dir + "/summary.csv", values))
+      {
+        finished[run] = values;
+      }
+      else
+      {
+        // A failed run is skipped, and one more is started in its place.
+        failed++;
+        finished[run] = std::map<std::string, double>();
+        std::cerr << "Run failed (see " << dir << "/output.log)" << std::endl;
+        if (failed >= maxFailures)
+        {
+          std::cerr << "Giving up after " << failed << " failed runs" << std::endl;
+          done = true;
+        }
+      }
+    }
+
+    // Fold finished runs in run order and check the stopping rule.
+    while (!done && finished.count(nextFold))
+    {
+      std::map<std::string, double> values = finished[nextFold];
+      finished.erase(nextFold++);
+      if (values.empty())
+      {
+        continue;
+      }
+      for (size_t m = 0; m < names.size(); m++)
+      {
+        NS_ABORT_MSG_UNLESS(values.count(names[m]), "Run summaries have no column " << names[m]);
+        estimates[m].Add(values[names[m]]);
+      }
+      folded.push_back(values);
+      uint32_t n = folded.size();
+      if (n < minRuns)
+      {
+        continue;
+      }
+
+      double t = StudentQuantile(0.5 + confidence / 2, n - 1);
+      bool all = true;
+      for (size_t m = 0; m < names.size(); m++)
+      {
+        MetricEstimate &e = estimates[m];
+        double halfWidth = t * e.Stddev() / std::sqrt(double(n));
+        double target = std::max(precision * std::fabs(e.mean), absolute);
+        e.converged = halfWidth <= target;
+        all = all && e.converged;
+        // Runs needed if the interval keeps shrinking as 1/sqrt(n).
+        double needed = n * (halfWidth / target) * (halfWidth / target);
+        if (!e.converged && !e.flagged && needed > maxRuns)
+        {
+          e.flagged = true;
+          std::cerr << names[m] << " is not converging: +-" << halfWidth << " around " << e.mean
+                    << " after " << n << " runs, about " << uint64_t(std::ceil(needed))
+                    << " runs would be needed" << std::endl;
+        }
+      }
+      done = all || n >= maxRuns;
+    }
+    done = done || (running.empty() && next >= firstRun + maxRuns + failed && finished.empty());
+  }
+
+  // Runs still going are no longer needed.
+  for (std::map<pid_t, uint32_t>::const_iterator it = running.begin(); it != running.end(); it++)
+  {
+    kill(it->first, SIGTERM);
+  }
+  while (!running.empty())
+  {
+    int status = 0;
+    pid_t pid = waitpid(-1, &status, 0);
+    if (pid < 0 && errno != EINTR)
+    {
+      break;
+    }
+    running.erase(pid);
+  }
+
+  uint32_t n = folded.size();
+  double t = n > 1 ? StudentQuantile(0.5 + confidence / 2, n - 1) : 0.0;
+  std::ofstream convergence((out + "/convergence.csv").c_str());
+  NS_ABORT_MSG_UNLESS(convergence.is_open(), "Cannot write " << out << "/convergence.csv");
+  convergence.precision(9);
+  convergence << "metric,runs,mean,stddev,ci_low,ci_high,relative_half_width,converged\n";
+  bool all = true;
+  std::cout << std::setprecision(6);
+  for (size_t m = 0; m < names.size(); m++)
+  {
+    const MetricEstimate &e = estimates[m];
+    double halfWidth = n > 1 ? t * e.Stddev() / std::sqrt(double(n)) : 0.0;
+    double relative = e.mean != 0 ? halfWidth / std::fabs(e.mean) : 0.0;
+    convergence << names[m] << "," << n << "," << e.mean << "," << e.Stddev() << "," << e.mean - halfWidth
+                << "," << e.mean + halfWidth << "," << relative << "," << (e.converged ? 1 : 0) << "\n";
+    std::cout << names[m] << ": " << e.mean << " +- " << halfWidth << " (" << confidence * 100 << "%, "
+              << n << " runs)" << (e.converged ? "" : " NOT CONVERGED") << std::endl;
+    all = all && e.converged;
+  }
+
+  // Every folded run, in run order.
+  std::ofstream runs((out + "/runs.csv").c_str());
+  NS_ABORT_MSG_UNLESS(runs.is_open(), "Cannot write " << out << "/runs.csv");
+  runs.precision(9);
+  runs << "run";
+  for (size_t m = 0; m < names.size(); m++)
+  {
+    runs << "," << names[m];
+  }
+  runs << "\n";
+  for (size_t r = 0; r < folded.size(); r++)
+  {
+    runs << folded[r]["run"];
+    for (size_t m = 0; m < names.size(); m++)
+    {
+      runs << "," << folded[r][names[m]];
+    }
+    runs << "\n";
+  }
+
+  if (failed)
+  {
+    std::cerr << failed << " runs failed" << std::endl;
+  }
+  if (failed >= maxFailures)
+  {
+    return 1;
+  }
+  return all ? 0 : 2;
+}
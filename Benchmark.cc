@@ -0,0 +1,360 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/core-module.h"
+#include "process-launcher.h"
+
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+// Benchmark of HomeNetwork and IITGoaNetwork at a set of scale points.
+//
+// Runs every scale point (nWifi for HomeNetwork, nWifi x nCsma x campus
+// replicas for IITGoaNetwork) with each of the given event schedulers a
+// number of times (RngRun 1, 2, ...), one run after the other on a single
+// core so the runs do not disturb each other.  The campus replicas are
+// copies of the Wi-Fi building in one simulation, passed as the nReplicas
+// topology variable, which IITGoaCampus.topo has.  Every run writes its
+// --results summary, which holds the phase times, executed events, events
+// per second, simulated-to-wall ratio, peak RSS and, when the programs
+// were built with PHASE_TIMER_ALLOCATIONS=1, allocation counts (see
+// phase-timer.h).  The rows are collected, together with the CPU time and
+// peak RSS the kernel reports for the process, into <out>/benchmark.csv
+// and <out>/benchmark.json, labelled with --label so that the files of
+// two builds can be compared.
+//
+//   build/scratch/Benchmark --home=build/scratch/HomeNetwork
+//       --campus=build/scratch/IITGoaNetwork --topology=$PWD/scratch/IITGoaCampus.topo
+//       --nWifi=8,32 --nCsma=3,12 --campusReplicas=1,4,16 --schedulers=map,calendar,ladder
+//       --runs=3 --label=$(git rev-parse --short HEAD)
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("Benchmark");
+
+struct BenchmarkRun
+{
+  std::string program;
+  std::string name;
+  std::string nWifi;
+  std::string nCsma;
+  std::string nReplicas;
+  std::string scheduler;
+  uint32_t rngRun;
+  std::string dir;
+  std::vector<std::pair<std::string, std::string> > columns;
+};
+
+static std::string Resolve(const std::string &path)
+{
+  char resolved[PATH_MAX];
+  NS_ABORT_MSG_UNLESS(realpath(path.c_str(), resolved), "Cannot find " << path);
+  return resolved;
+}
+
+static std::string Number(double value)
+{
+  std::ostringstream out;
+  out.precision(9);
+  out << value;
+  return out.str();
+}
+
+static double ToSeconds(const struct timeval &tv)
+{
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+// Runs one program to completion in run.dir and appends its summary and
+// the kernel's accounting of the process to run.columns.
+static bool Execute(BenchmarkRun &run, const std::vector<std::string> &args, int cpu)
+{
+  ProcessLauncher::MakeDirs(run.dir);
+  unlink((run.dir + "/summary.csv").c_str());
+  struct timeval start;
+  gettimeofday(&start, 0);
+
+  pid_t pid = ProcessLauncher::Launch(run.program, args, run.dir, cpu);
+  int status = 0;
+  struct rusage usage;
+  while (wait4(pid, &status, 0, &usage) < 0)
+  {
+    NS_ABORT_MSG_UNLESS(errno == EINTR, "wait4 failed: " << std::strerror(errno));
+  }
+  struct timeval end;
+  gettimeofday(&end, 0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+  {
+    return false;
+  }
+
+  std::ifstream in((run.dir + "/summary.csv").c_str());
+  std::string header;
+  std::string values;
+  if (!std::getline(in, header) || !std::getline(in, values))
+  {
+    return false;
+  }
+  std::vector<std::string> names = ProcessLauncher::Split(header, ',');
+  std::vector<std::string> cells = ProcessLauncher::Split(values, ',');
+  for (size_t c = 0; c < names.size() && c < cells.size(); c++)
+  {
+    // The scale point is written as its own columns.
+    if (names[c] != "nWifi" && names[c] != "nCsma")
+    {
+      run.columns.push_back(std::make_pair(names[c], cells[c]));
+    }
+  }
+  run.columns.push_back(std::make_pair("process_wall_s", Number(ToSeconds(end) - ToSeconds(start))));
+  run.columns.push_back(std::make_pair("process_user_s", Number(ToSeconds(usage.ru_utime))));
+  run.columns.push_back(std::make_pair("process_sys_s", Number(ToSeconds(usage.ru_stime))));
+  run.columns.push_back(std::make_pair("process_max_rss_mb", Number(usage.ru_maxrss / 1024.0)));
+  return true;
+}
+
+static void WriteCsv(const std::vector<BenchmarkRun> &runs, const std::string &label, const std::string &path)
+{
+  std::vector<std::string> columns;
+  std::map<std::string, bool> seen;
+  for (size_t r = 0; r < runs.size(); r++)
+  {
+    for (size_t c = 0; c < runs[r].columns.size(); c++)
+    {
+      if (!seen[runs[r].columns[c].first])
+      {
+        seen[runs[r].columns[c].first] = true;
+        columns.push_back(runs[r].columns[c].first);
+      }
+    }
+  }
+
+  std::ofstream out(path.c_str());
+  NS_ABORT_MSG_UNLESS(out.is_open(), "Cannot write " << path);
+  out << "label,program,nWifi,nCsma,nReplicas,scheduler,rngRun";
+  for (size_t c = 0; c < columns.size(); c++)
+  {
+    out << "," << columns[c];
+  }
+  out << "\n";
+  for (size_t r = 0; r < runs.size(); r++)
+  {
+    std::map<std::string, std::string> row(runs[r].columns.begin(), runs[r].columns.end());
+    out << label << "," << runs[r].name << "," << runs[r].nWifi << "," << runs[r].nCsma << "," << runs[r].nReplicas
+        << "," << runs[r].scheduler << "," << runs[r].rngRun;
+    for (size_t c = 0; c < columns.size(); c++)
+    {
+      out << "," << row[columns[c]];
+    }
+    out << "\n";
+  }
+}
+
+static std::string JsonValue(const std::string &text)
+{
+  char *end = 0;
+  std::strtod(text.c_str(), &end);
+  if (!text.empty() && *end == '\0' && text.find_first_of("ni") == std::string::npos)
+  {
+    return text;
+  }
+  return "\"" + text + "\"";
+}
+
+static void WriteJson(const std::vector<BenchmarkRun> &runs, const std::string &label, const std::string &path)
+{
+  std::ofstream out(path.c_str());
+  NS_ABORT_MSG_UNLESS(out.is_open(), "Cannot write " << path);
+  out << "{\n  \"label\": \"" << label << "\",\n  \"runs\": [";
+  for (size_t r = 0; r < runs.size(); r++)
+  {
+    out << (r ? "," : "") << "\n    {\"program\": \"" << runs[r].name << "\", \"nWifi\": " << runs[r].nWifi;
+    if (!runs[r].nCsma.empty())
+    {
+      out << ", \"nCsma\": " << runs[r].nCsma << ", \"nReplicas\": " << runs[r].nReplicas;
+    }
+    out << ", \"scheduler\": \"" << runs[r].scheduler << "\", \"rngRun\": " << runs[r].rngRun;
+    for (size_t c = 0; c < runs[r].columns.size(); c++)
+    {
+      out << ", \"" << runs[r].columns[c].first << "\": " << JsonValue(runs[r].columns[c].second);
+    }
+    out << "}";
+  }
+  out << "\n  ]\n}\n";
+}
+
+int main(int argc, char *argv[])
+{
+  std::string home = "";
+  std::string campus = "";
+  std::string topology = "";
+  std::string nWifi = "2,8,32";
+  std::string nCsma = "3";
+  std::string campusReplicas = "1";
+  std::string schedulers = "map";
+  uint32_t rngRuns = 3;
+  std::string out = "benchmark";
+  std::string label = "";
+  std::string args = "";
+
+  CommandLine cmd(__FILE__);
+  cmd.AddValue("home", "HomeNetwork binary (empty: skip)", home);
+  cmd.AddValue("campus", "IITGoaNetwork binary (empty: skip)", campus);
+  cmd.AddValue("topology", "Topology file passed to IITGoaNetwork", topology);
+  cmd.AddValue("nWifi", "Comma separated numbers of Wi-Fi stations", nWifi);
+  cmd.AddValue("nCsma", "Comma separated numbers of LAN nodes (IITGoaNetwork)", nCsma);
+  cmd.AddValue("campusReplicas", "Comma separated numbers of copies of the campus building (IITGoaNetwork)",
+               campusReplicas);
+  cmd.AddValue("schedulers", "Comma separated event schedulers (map, list, heap, calendar, ladder)", schedulers);
+  cmd.AddValue("runs", "Runs per scale point, with RngRun 1..runs", rngRuns);
+  cmd.AddValue("out", "Directory for the runs and the benchmark files", out);
+  cmd.AddValue("label", "Name of this build in the benchmark files (e.g. a commit id)", label);
+  cmd.AddValue("args", "Extra arguments passed to every run", args);
+  cmd.Parse(argc, argv);
+
+  NS_ABORT_MSG_IF(home.empty() && campus.empty(), "Give --home and/or --campus");
+  ProcessLauncher::MakeDirs(out);
+  out = Resolve(out);
+
+  // Tracing, animation and logging are off unless --args turns them on.
+  std::vector<std::string> common;
+  common.push_back("--tracing=false");
+  common.push_back("--animation=false");
+  common.push_back("--verbose=false");
+  common.push_back("--results=summary.csv");
+  std::vector<std::string> extra = ProcessLauncher::Split(args, ' ');
+
+  std::vector<BenchmarkRun> runs;
+  std::vector<std::string> wifiPoints = ProcessLauncher::Split(nWifi, ',');
+  std::vector<std::string> csmaPoints = ProcessLauncher::Split(nCsma, ',');
+  std::vector<std::string> replicaPoints = ProcessLauncher::Split(campusReplicas, ',');
+  std::vector<std::string> schedulerPoints = ProcessLauncher::Split(schedulers, ',');
+  for (size_t w = 0; w < wifiPoints.size(); w++)
+  {
+    for (size_t s = 0; s < schedulerPoints.size(); s++)
+    {
+      for (uint32_t r = 1; r <= rngRuns; r++)
+      {
+        std::string suffix = "_scheduler-" + schedulerPoints[s] + "/run-" + std::to_string(r);
+        if (!home.empty())
+        {
+          BenchmarkRun run;
+          run.program = Resolve(home);
+          run.name = "HomeNetwork";
+          run.nWifi = wifiPoints[w];
+          run.scheduler = schedulerPoints[s];
+          run.rngRun = r;
+          run.dir = out + "/home_nWifi-" + run.nWifi + suffix;
+          runs.push_back(run);
+        }
+        for (size_t c = 0; !campus.empty() && c < csmaPoints.size(); c++)
+        {
+          for (size_t p = 0; p < replicaPoints.size(); p++)
+          {
+            BenchmarkRun run;
+            run.program = Resolve(campus);
+            run.name = "IITGoaNetwork";
+            run.nWifi = wifiPoints[w];
+            run.nCsma = csmaPoints[c];
+            run.nReplicas = replicaPoints[p];
+            run.scheduler = schedulerPoints[s];
+            run.rngRun = r;
+            run.dir = out + "/campus_nWifi-" + run.nWifi + "_nCsma-" + run.nCsma + "_nReplicas-" + run.nReplicas +
+                      suffix;
+            runs.push_back(run);
+          }
+        }
+      }
+    }
+  }
+
+  // All runs share the first core this process may use.
+  int cpu = ProcessLauncher::GetCpus().front();
+
+  std::vector<BenchmarkRun> done;
+  uint32_t failed = 0;
+  for (size_t i = 0; i < runs.size(); i++)
+  {
+    BenchmarkRun &run = runs[i];
+    std::vector<std::string> argList;
+    argList.push_back(run.program);
+    argList.insert(argList.end(), common.begin(), common.end());
+    argList.push_back("--nWifi=" + run.nWifi);
+    argList.push_back("--scheduler=" + run.scheduler);
+    if (!run.nCsma.empty())
+    {
+      argList.push_back("--nCsma=" + run.nCsma);
+      if (!topology.empty())
+      {
+        argList.push_back("--topology=" + Resolve(topology));
+      }
+    }
+    argList.push_back("--RngRun=" + std::to_string(run.rngRun));
+    argList.insert(argList.end(), extra.begin(), extra.end());
+    if (!run.nReplicas.empty())
+    {
+      // Added to the --vars of --args, if there are any.
+      std::string vars = "nReplicas=" + run.nReplicas;
+      size_t v = 0;
+      while (v < argList.size() && argList[v].compare(0, 7, "--vars=") != 0)
+      {
+        v++;
+      }
+      if (v < argList.size())
+      {
+        argList[v] += ";" + vars;
+      }
+      else
+      {
+        argList.push_back("--vars=" + vars);
+      }
+    }
+
+    std::cout << "[" << i + 1 << "/" << runs.size() << "] " << run.dir << std::flush;
+    if (!Execute(run, argList, cpu))
+    {
+      failed++;
+      std::cout << " failed (see " << run.dir << "/output.log)" << std::endl;
+      continue;
+    }
+    std::map<std::string, std::string> row(run.columns.begin(), run.columns.end());
+    std::cout << " wall " << row["process_wall_s"] << " s, " << row["events_per_s"] << " events/s, peak RSS "
+              << row["peak_rss_mb"] << " MB" << std::endl;
+    done.push_back(run);
+  }
+
+  WriteCsv(done, label, out + "/benchmark.csv");
+  WriteJson(done, label, out + "/benchmark.json");
+  std::cout << done.size() << " runs written to " << out << "/benchmark.csv and benchmark.json";
+  if (failed)
+  {
+    std::cout << ", " << failed << " failed";
+  }
+  std::cout << std::endl;
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,99 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "event-log.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+// Prints an --eventLog file written by HomeNetwork or IITGoaNetwork as the
+// UdpEcho*Application INFO lines those programs used to print, or as CSV.
+//
+//   build/scratch/EventLogDecoder --input=events.bin
+//   build/scratch/EventLogDecoder --input=events.bin --node=0 --csv
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("EventLogDecoder");
+
+static void PrintText(const EventRecord &record)
+{
+  static const char *what[] = {"client sent", "client received", "server received", "server sent"};
+  bool sent = record.type == EventRecord::CLIENT_SENT || record.type == EventRecord::SERVER_SENT;
+  std::cout << "At time " << NanoSeconds(record.time).As(Time::S) << " " << what[record.type] << " "
+            << record.size << " bytes " << (sent ? "to " : "from ") << Ipv4Address(record.peer) << " port "
+            << record.port << "\n";
+}
+
+static void PrintCsv(const EventRecord &record)
+{
+  static const char *type[] = {"client_sent", "client_received", "server_received", "server_sent"};
+  std::cout << record.time << "," << record.node << "," << record.app << "," << type[record.type] << ","
+            << record.size << "," << Ipv4Address(record.peer) << "," << record.port << "\n";
+}
+
+int main(int argc, char *argv[])
+{
+  std::string input = "";
+  int node = -1;
+  bool csv = false;
+
+  CommandLine cmd(__FILE__);
+  cmd.AddValue("input", "Event log written with --eventLog", input);
+  cmd.AddValue("node", "Only print the events of this node (-1: all)", node);
+  cmd.AddValue("csv", "Print CSV (time_ns,node,app,type,size,peer,port) instead of log lines", csv);
+  cmd.Parse(argc, argv);
+
+  std::FILE *file = std::fopen(input.c_str(), "rb");
+  NS_ABORT_MSG_IF(file == 0, "Cannot open " << input);
+  EventLogHeader header;
+  NS_ABORT_MSG_UNLESS(std::fread(&header, sizeof(header), 1, file) == 1 &&
+                          std::memcmp(header.magic, "NS3EVLOG", 8) == 0,
+                      input << " is not an event log");
+  NS_ABORT_MSG_UNLESS(header.version == 1 && header.recordSize == sizeof(EventRecord),
+                      input << " has an unsupported version or record size");
+
+  if (csv)
+  {
+    std::cout << "time_ns,node,app,type,size,peer,port\n";
+  }
+  std::vector<EventRecord> block(4096);
+  size_t count;
+  while ((count = std::fread(&block[0], sizeof(EventRecord), block.size(), file)) > 0)
+  {
+    for (size_t i = 0; i < count; i++)
+    {
+      const EventRecord &record = block[i];
+      if ((node >= 0 && record.node != uint32_t(node)) || record.type > EventRecord::SERVER_SENT)
+      {
+        continue;
+      }
+      if (csv)
+      {
+        PrintCsv(record);
+      }
+      else
+      {
+        PrintText(record);
+      }
+    }
+  }
+  std::fclose(file);
+  return 0;
+}
@@ -24,7 +24,25 @@
 #include "ns3/internet-module.h"
 #include "ns3/yans-wifi-helper.h"
 #include "ns3/ssid.h"
-#include "ns3/netanim-module.h"
+#include "run-summary.h"
+#include "flow-metrics.h"
+#include "event-log.h"
+#include "routing-cache.h"
+#include "phase-timer.h"
+#include "ladder-scheduler.h"
+#include "traffic-generators.h"
+#include "pcapng-writer.h"
+#include "animation-stream.h"
+#include "spatial-wifi-channel.h"
+#include "trajectory-mobility-model.h"
+#include "scalable-grid-position-allocator.h"
+#include "stack-profile.h"
+#include "latency-histogram.h"
+#include "queue-telemetry.h"
+#include "warm-start.h"
+#include "live-monitor.h"
+#include "wifi-standard-helper.h"
+#include "wifi-goodput.h"
 //   Wifi 10.1.3.0
 //
 //    *     *     *
@@ -40,28 +58,102 @@ NS_LOG_COMPONENT_DEFINE("HomeNetwork");
 int main(int argc, char *argv[])
 {
     bool verbose = true;
+    std::string eventLog = "";
+    std::string profile = "echo";
+    std::string loadRate = "1Mbps";
     //uint32_t nCsma = 3;
     uint32_t nWifi = 2;
     bool tracing = true;
+    std::string pcapng = "";
+    uint32_t snaplen = 0;
+    bool animation = true;
+    std::string animFile = "HomeNetwork.xml";
+    Time animPoll = Seconds(0.25);
+    Time animStart = Seconds(0);
+    Time animStop = Seconds(0);
+    uint32_t animSample = 1;
+    bool animPerFlow = false;
+    std::string results = "";
+    std::string flows = "";
+    Time flowInterval = Seconds(1);
+    std::string latency = "";
+    std::string aqm = "none";
+    std::string queues = "";
+    Time queueInterval = MilliSeconds(100);
+    std::string routeCache = "";
+    bool routeIncremental = false;
+    std::string scheduler = "map";
+    std::string stackProfile = "full";
+    std::string nodeMemory = "";
+    bool spatialChannel = false;
+    std::string mobilityModel = "walk";
+    double side = 100.0;
+    Time warmStart = Seconds(0);
+    uint32_t variants = 1;
+    uint32_t jobs = 0;
+    std::string warmDir = "warm";
+    std::string monitor = "";
+    std::string standard = "a";
+    uint32_t channelWidth = 0;
+    std::string manager = "aarf";
+    uint32_t mcs = 0;
+    uint32_t ampdu = 65535;
+    uint32_t amsdu = 0;
+    std::string goodput = "";
 
     CommandLine cmd(__FILE__);
 
     cmd.AddValue("nWifi", "Number of wifi STA devices", nWifi);
     cmd.AddValue("verbose", "Tell echo applications to log if true", verbose);
+    cmd.AddValue("eventLog", "Record echo events into this binary log instead (see EventLogDecoder)", eventLog);
+    cmd.AddValue("profile", "Load next to each echo client: echo (none), cbr, poisson, onoff, web or bulk", profile);
+    cmd.AddValue("loadRate", "Sending rate of each load generator", loadRate);
     cmd.AddValue("tracing", "Enable pcap tracing", tracing);
+    cmd.AddValue("pcapng", "Trace into this one PCAP-NG file (.gz/.zst to compress) instead of per-device pcap files", pcapng);
+    cmd.AddValue("snaplen", "Bytes of each packet kept in the PCAP-NG trace (0: whole packet)", snaplen);
+    cmd.AddValue("animation", "Write a NetAnim trace", animation);
+    cmd.AddValue("animFile", "NetAnim trace file (.gz/.zst to compress)", animFile);
+    cmd.AddValue("animPoll", "Interval between NetAnim mobility updates", animPoll);
+    cmd.AddValue("animStart", "Start of the recorded NetAnim window", animStart);
+    cmd.AddValue("animStop", "End of the recorded NetAnim window (0: end of the run)", animStop);
+    cmd.AddValue("animSample", "Record one packet (or flow, see animPerFlow) in N", animSample);
+    cmd.AddValue("animPerFlow", "Sample whole IPv4 flows instead of single packets", animPerFlow);
+    cmd.AddValue("results", "Write a one-row CSV summary of the run to this file", results);
+    cmd.AddValue("flows", "Write per-flow metrics to <flows>-flows.csv, -histograms.csv and -snapshots.csv", flows);
+    cmd.AddValue("flowInterval", "Interval between per-flow snapshots", flowInterval);
+    cmd.AddValue("latency", "Write echo RTT and device queue latency percentiles to <latency>-latency.csv and -latency-buckets.csv", latency);
+    cmd.AddValue("aqm", "Queue disc on the AP uplink to Rs: none, fqcodel, pie or red", aqm);
+    cmd.AddValue("queues", "Write uplink queue length and sojourn time to <queues>-queues.csv and -queue-samples.csv", queues);
+    cmd.AddValue("queueInterval", "Interval between uplink queue samples", queueInterval);
+    cmd.AddValue("routeCache", "Load the global routes from this file, computing and saving them when the topology changed", routeCache);
+    cmd.AddValue("routeIncremental", "Only recompute the routes a topology change can affect", routeIncremental);
+    cmd.AddValue("scheduler", "Event scheduler: map, list, heap, calendar or ladder", scheduler);
+    cmd.AddValue("stack", "Internet stack: full, or lean (IPv4, ARP, ICMP, UDP, TCP only for bulk load, no queue discs)", stackProfile);
+    cmd.AddValue("nodeMemory", "Write the heap bytes of each node's internet stack to this CSV file", nodeMemory);
+    cmd.AddValue("spatialChannel", "Only deliver Wi-Fi frames to PHYs within detection range", spatialChannel);
+    cmd.AddValue("mobility", "Station mobility: walk (RandomWalk2d) or trajectory (the same walk without events)", mobilityModel);
+    cmd.AddValue("side", "Side (m) of the square the stations walk in", side);
+    cmd.AddValue("warmStart", "Run to this time once, then fork one process per RNG run from there (0: off)", warmStart);
+    cmd.AddValue("variants", "RNG runs forked after --warmStart, from RngRun on", variants);
+    cmd.AddValue("jobs", "Concurrent --warmStart runs (0: one per available core)", jobs);
+    cmd.AddValue("warmDir", "Directory of the --warmStart runs; relative output paths land in <warmDir>/run-<r>", warmDir);
+    cmd.AddValue("monitor", "Answer progress queries on this Unix socket while running (see MonitorClient)", monitor);
+    cmd.AddValue("standard", "Wi-Fi standard: a, b, g, n-2.4, n-5, ac, ax-2.4 or ax-5", standard);
+    cmd.AddValue("channelWidth", "Wi-Fi channel width in MHz (0: the standard's default)", channelWidth);
+    cmd.AddValue("manager", "Wi-Fi rate manager: aarf, minstrel-ht, ideal or constant", manager);
+    cmd.AddValue("mcs", "MCS (or legacy rate index) of the constant rate manager", mcs);
+    cmd.AddValue("ampdu", "Largest A-MPDU in bytes, 802.11n and later (0: no A-MPDU)", ampdu);
+    cmd.AddValue("amsdu", "Largest A-MSDU in bytes, 802.11n and later (0: no A-MSDU)", amsdu);
+    cmd.AddValue("goodput", "Write the goodput of each Wi-Fi station and the run's cost per delivered MB to this CSV file", goodput);
 
     cmd.Parse(argc, argv);
 
-    // The underlying restriction of 18 is due to the grid position
-    // allocator's configuration; the grid layout will exceed the
-    // bounding box if more than 18 nodes are provided.
-    if (nWifi > 18)
-    {
-        std::cout << "nWifi should be 18 or less; otherwise grid layout exceeds the bounding box" << std::endl;
-        return 1;
-    }
+    //Wall time of each step, reported in the --results summary
+    PhaseTimer phases;
+    phases.Start("devices");
+    UseScheduler(scheduler);
 
-    if (verbose)
+    if (verbose && eventLog.empty())
     {
         LogComponentEnable("UdpEchoClientApplication", LOG_LEVEL_INFO);
         LogComponentEnable("UdpEchoServerApplication", LOG_LEVEL_INFO);
@@ -80,8 +172,10 @@ int main(int argc, char *argv[])
     NetDeviceContainer p2pDevices;
     p2pDevices = pointToPoint.Install(p2pNodes);
 
-    InternetStackHelper stack;
-    stack.Install(p2pNodes.Get(1));
+    //Only bulk load runs over TCP
+    StackProfileHelper stack(stackProfile);
+    bool tcp = profile == "bulk";
+    stack.Install(p2pNodes.Get(1), tcp);
 
     //-----------------------------------------------------------------------------------------------------------------------
 
@@ -89,12 +183,28 @@ int main(int argc, char *argv[])
     wifiStaNodes.Create(nWifi);
     NodeContainer wifiApNode = p2pNodes.Get(0);
 
-    YansWifiChannelHelper channel = YansWifiChannelHelper::Default();
     YansWifiPhyHelper phy;
-    phy.SetChannel(channel.Create());
+    if (spatialChannel)
+    {
+        phy = SpatialYansWifiPhyHelper();
+        phy.SetChannel(SpatialYansWifiChannelHelper::Default().Create());
+    }
+    else
+    {
+        YansWifiChannelHelper channel = YansWifiChannelHelper::Default();
+        phy.SetChannel(channel.Create());
+    }
+
+    //Standard, rate manager and aggregation of the home BSS
+    WifiStandardHelper radio;
+    radio.SetStandard(standard);
+    radio.SetChannelWidth(channelWidth);
+    radio.SetRemoteStationManager(manager, mcs);
+    radio.SetAggregation(ampdu, amsdu);
+    NS_ABORT_MSG_UNLESS(radio.Check().empty(), radio.Check());
 
     WifiHelper wifi;
-    wifi.SetRemoteStationManager("ns3::AarfWifiManager");
+    radio.Configure(wifi);
 
     WifiMacHelper mac;
     Ssid ssid = Ssid("ns-3-ssid");
@@ -110,30 +220,54 @@ int main(int argc, char *argv[])
 
     NetDeviceContainer apDevices;
     apDevices = wifi.Install(phy, mac, wifiApNode);
+    radio.Apply(staDevices);
+    radio.Apply(apDevices);
+    stack.ShareWifiModels(staDevices);
+    stack.ShareWifiModels(apDevices);
 
     MobilityHelper mobility;
+    Rectangle bounds(-side / 2, side / 2, -side / 2, side / 2);
 
-    mobility.SetPositionAllocator("ns3::GridPositionAllocator",
-                                  "MinX", DoubleValue(0.0),
-                                  "MinY", DoubleValue(0.0),
-                                  "DeltaX", DoubleValue(5.0),
-                                  "DeltaY", DoubleValue(10.0),
-                                  "GridWidth", UintegerValue(3),
-                                  "LayoutType", StringValue("RowFirst"));
+    // The fixed 3-wide grid only fits 18 stations in the default walk area;
+    // larger BSSs are spread evenly over the whole area instead.
+    if (nWifi <= 18 && side == 100.0)
+    {
+        mobility.SetPositionAllocator("ns3::GridPositionAllocator",
+                                      "MinX", DoubleValue(0.0),
+                                      "MinY", DoubleValue(0.0),
+                                      "DeltaX", DoubleValue(5.0),
+                                      "DeltaY", DoubleValue(10.0),
+                                      "GridWidth", UintegerValue(3),
+                                      "LayoutType", StringValue("RowFirst"));
+    }
+    else
+    {
+        mobility.SetPositionAllocator("ns3::ScalableGridPositionAllocator",
+                                      "Bounds", RectangleValue(bounds),
+                                      "N", UintegerValue(nWifi));
+    }
 
-    mobility.SetMobilityModel("ns3::RandomWalk2dMobilityModel",
-                              "Bounds", RectangleValue(Rectangle(-50, 50, -50, 50)));
+    NS_ABORT_MSG_UNLESS(mobilityModel == "walk" || mobilityModel == "trajectory",
+                        "--mobility is walk or trajectory");
+    mobility.SetMobilityModel(mobilityModel == "trajectory" ? "ns3::TrajectoryMobilityModel"
+                                                            : "ns3::RandomWalk2dMobilityModel",
+                              "Bounds", RectangleValue(bounds));
     mobility.Install(wifiStaNodes);
 
     //Access Point AP is stationary and does not move
     mobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
     mobility.Install(wifiApNode);
     mobility.Install(p2pNodes.Get(1));
+    //Fixed places of the AP and Rs, also when there is no animation
+    wifiApNode.Get(0)->GetObject<MobilityModel>()->SetPosition(Vector(3.0, 3.0, 0.0));
+    p2pNodes.Get(1)->GetObject<MobilityModel>()->SetPosition(Vector(10.0, 20.0, 0.0));
 
-    stack.Install(wifiApNode);
-    stack.Install(wifiStaNodes);
+    phases.Start("stack");
+    stack.Install(wifiApNode, tcp);
+    stack.Install(wifiStaNodes, tcp);
 
     //Assign IP addresses to net devices
+    phases.Start("addresses");
     Ipv4AddressHelper address;
 
     address.SetBase("10.1.1.0", "255.255.255.0"); //10.1.1.2 remote server
@@ -147,11 +281,19 @@ int main(int argc, char *argv[])
     wifiNodesInterfaces = address.Assign(staDevices);
 
     apNodeInterface = address.Assign(apDevices);
+    stack.RemoveQueueDiscs(p2pDevices);
+    stack.RemoveQueueDiscs(staDevices);
+    stack.RemoveQueueDiscs(apDevices);
+
+    //AQM on the AP uplink, the bottleneck between the WiFi and Rs
+    AqmHelper aqmHelper(aqm);
+    aqmHelper.Install(p2pDevices);
 
     //--------------------------------------------------------------------------------------
     // Setting  applications
     //--------------------------------------------------------------------------------------
 
+    phases.Start("applications");
     //Laptop to Rs and Mobile to Rs
     UdpEchoServerHelper echoServer(9);
     //Make server Rs
@@ -188,21 +330,235 @@ int main(int argc, char *argv[])
     client3Apps.Start(Seconds(12.0));
     client3Apps.Stop(Seconds(20.0));
 
-    Ipv4GlobalRoutingHelper::PopulateRoutingTables();
+    //Load between the same pairs, to sinks on the echo port + 1000
+    ApplicationContainer allLoadApps;
+    ApplicationContainer sinkApps;
+    if (profile != "echo")
+    {
+        NS_ABORT_MSG_UNLESS(WorkloadHelper::IsProfile(profile), "Unknown profile " << profile);
+        sinkApps.Add(WorkloadHelper::InstallSink(profile, p2pNodes.Get(1), 1009));
+        sinkApps.Add(WorkloadHelper::InstallSink(profile, wifiStaNodes.Get(0), 1013));
+
+        WorkloadHelper load(profile, InetSocketAddress(p2pInterfaces.GetAddress(1), 1009));
+        load.SetAttribute("PacketSize", UintegerValue(1024));
+        load.SetAttribute("DataRate", DataRateValue(DataRate(loadRate)));
+        ApplicationContainer loadApps = load.Install(wifiStaNodes.Get(nWifi - 1));
+        loadApps.Start(Seconds(2.0));
+        loadApps.Stop(Seconds(10.0));
+        ApplicationContainer load1Apps = load.Install(wifiStaNodes.Get(nWifi - 2));
+        load1Apps.Start(Seconds(3.0));
+        load1Apps.Stop(Seconds(10.0));
+
+        WorkloadHelper load3(profile, InetSocketAddress(wifiNodesInterfaces.GetAddress(0), 1013));
+        load3.SetAttribute("PacketSize", UintegerValue(1024));
+        load3.SetAttribute("DataRate", DataRateValue(DataRate(loadRate)));
+        ApplicationContainer load3Apps = load3.Install(wifiStaNodes.Get(1));
+        load3Apps.Start(Seconds(12.0));
+        load3Apps.Stop(Seconds(20.0));
+        allLoadApps.Add(loadApps);
+        allLoadApps.Add(load1Apps);
+        allLoadApps.Add(load3Apps);
+    }
+
+    phases.Start("routing");
+    RoutingCache routes;
+    if (routeCache.empty())
+    {
+        Ipv4GlobalRoutingHelper::PopulateRoutingTables();
+    }
+    else
+    {
+        routes.Populate(routeCache, routeIncremental);
+    }
 
-    Simulator::Stop(Seconds(20.0));
+    Time stopTime = Seconds(20.0);
+    Simulator::Stop(stopTime);
 
-    if (tracing == true)
+    //Seed sweep: every run continues from the same warmed-up state. The
+    //instrumentation below is set up in each run, so the warm-up must end
+    //before the first client or load flow starts
+    WarmStart warm;
+    if (warmStart > Seconds(0))
+    {
+        NS_ABORT_MSG_IF(warmStart >= stopTime, "--warmStart must end before the simulation stops");
+        NS_ABORT_MSG_IF(warmStart > WarmStart::GetFirstStart(clientApps) ||
+                        warmStart > WarmStart::GetFirstStart(allLoadApps),
+                        "--warmStart must end before the first flow starts");
+        NS_ABORT_MSG_IF(!results.empty() && results[0] == '/', "--warmStart needs a relative --results path");
+        // Each run answers on its own socket in its run directory.
+        NS_ABORT_MSG_IF(!monitor.empty() && monitor[0] == '/', "--warmStart needs a relative --monitor path");
+        phases.Start("warmup");
+        warm.SetDirectory(warmDir);
+        warm.SetRuns(RngSeedManager::GetRun(), variants);
+        warm.SetJobs(jobs);
+        if (!warm.Fork(warmStart, NodeContainer::GetGlobal()))
+        {
+            if (!results.empty())
+            {
+                uint32_t merged = warm.Merge(results, results);
+                std::cout << merged << " runs merged into " << results << std::endl;
+            }
+            Simulator::Destroy();
+            return warm.GetFailed() ? 1 : 0;
+        }
+    }
+
+    phases.Start("instrumentation");
+    RunSummary summary;
+    summary.Set("nWifi", nWifi);
+    if (!routeCache.empty())
+    {
+        summary.Set("route_columns_computed", routes.GetComputedColumns());
+    }
+    summary.TrackEchoClients(clientApps);
+    summary.TrackEchoClients(client1Apps);
+    summary.TrackEchoClients(client3Apps);
+
+    EventLog events;
+    if (!eventLog.empty())
+    {
+        events.Open(eventLog);
+        events.TrackEchoServers(serverApps);
+        events.TrackEchoServers(server1Apps);
+        events.TrackEchoClients(clientApps);
+        events.TrackEchoClients(client1Apps);
+        events.TrackEchoClients(client3Apps);
+    }
+
+    //Per-flow metrics, named after the diagram above
+    FlowMetrics flowMetrics;
+    if (!flows.empty())
+    {
+        flowMetrics.Install(NodeContainer(p2pNodes, wifiStaNodes));
+        flowMetrics.NameNode(p2pNodes.Get(1), "Rs");
+        flowMetrics.NameNode(p2pNodes.Get(0), "n0");
+        for (uint32_t i = 0; i < nWifi; i++)
+        {
+            flowMetrics.NameNode(wifiStaNodes.Get(i), "n" + std::to_string(nWifi - i));
+        }
+        flowMetrics.EnableSnapshots(flows + "-snapshots.csv", flowInterval);
+    }
+
+    //Latency histograms of the echo clients and of every device queue
+    LatencyMonitor latencyMonitor;
+    if (!latency.empty())
+    {
+        latencyMonitor.NameNode(p2pNodes.Get(1), "Rs");
+        latencyMonitor.NameNode(p2pNodes.Get(0), "n0");
+        for (uint32_t i = 0; i < nWifi; i++)
+        {
+            latencyMonitor.NameNode(wifiStaNodes.Get(i), "n" + std::to_string(nWifi - i));
+        }
+        latencyMonitor.TrackEchoClients(clientApps);
+        latencyMonitor.TrackEchoClients(client1Apps);
+        latencyMonitor.TrackEchoClients(client3Apps);
+        latencyMonitor.TrackNodes(NodeContainer(p2pNodes, wifiStaNodes));
+    }
+
+    //Queue length and sojourn time on both ends of the uplink
+    QueueTelemetry queueTelemetry;
+    if (!queues.empty())
+    {
+        queueTelemetry.NameNode(p2pNodes.Get(1), "Rs");
+        queueTelemetry.NameNode(p2pNodes.Get(0), "n0");
+        queueTelemetry.Track(p2pDevices, aqm);
+        queueTelemetry.EnableSampling(queues + "-queue-samples.csv", queueInterval);
+    }
+
+    //Goodput of the stations, for comparing standards and aggregation
+    WifiGoodput wifiGoodput;
+    if (!goodput.empty())
+    {
+        for (uint32_t i = 0; i < nWifi; i++)
+        {
+            wifiGoodput.NameNode(wifiStaNodes.Get(i), "n" + std::to_string(nWifi - i));
+        }
+        wifiGoodput.TrackStations(wifiStaNodes);
+        wifiGoodput.Install(NodeContainer(p2pNodes, wifiStaNodes));
+    }
+
+    //Live progress and per-flow counters, queried with MonitorClient
+    LiveMonitor liveMonitor;
+    if (!monitor.empty())
+    {
+        liveMonitor.NameNode(p2pNodes.Get(1), "Rs");
+        liveMonitor.NameNode(p2pNodes.Get(0), "n0");
+        for (uint32_t i = 0; i < nWifi; i++)
+        {
+            liveMonitor.NameNode(wifiStaNodes.Get(i), "n" + std::to_string(nWifi - i));
+        }
+        liveMonitor.TrackEchoClients(clientApps);
+        liveMonitor.TrackEchoClients(client1Apps);
+        liveMonitor.TrackEchoClients(client3Apps);
+        liveMonitor.TrackLoads(allLoadApps);
+        liveMonitor.TrackSinks(sinkApps);
+        liveMonitor.Open(monitor);
+    }
+
+    phases.Start("tracing");
+    PcapNgWriter pcapngWriter;
+    if (tracing == true && !pcapng.empty())
+    {
+        //Same devices as the pcap files below
+        pcapngWriter.Open(pcapng, snaplen);
+        pcapngWriter.AddDevices(p2pDevices);
+        pcapngWriter.AddDevice(apDevices.Get(0));
+        pcapngWriter.AddDevice(staDevices.Get(0));
+        pcapngWriter.AddDevice(staDevices.Get(1));
+    }
+    else if (tracing == true)
     {
         pointToPoint.EnablePcapAll("Home_Network", p2pDevices.Get(0));
         phy.EnablePcap("Home_Network", apDevices.Get(0));
         phy.EnablePcap("Home_Network", staDevices.Get(0));
         phy.EnablePcap("Home_Network", staDevices.Get(1));
     }
-    AnimationInterface anim("HomeNetwork.xml");
-    anim.SetConstantPosition(p2pNodes.Get(1), 10.0, 20.0);
-    anim.SetConstantPosition(p2pNodes.Get(0), 3.0, 3.0);
+    AnimationStream anim;
+    if (animation)
+    {
+        anim.SetMobilityPollInterval(animPoll);
+        anim.SetWindow(animStart, animStop);
+        anim.SetPacketSampling(animSample, animPerFlow);
+        anim.Open(animFile);
+    }
+    phases.Start("run");
     Simulator::Run();
+    phases.Start("output");
+    liveMonitor.Close();
+    anim.Close();
+    pcapngWriter.Close();
+    events.Close();
+    if (!flows.empty())
+    {
+        flowMetrics.Write(flows);
+        flowMetrics.Summarize(summary);
+    }
+    if (!latency.empty())
+    {
+        latencyMonitor.Write(latency);
+        latencyMonitor.Summarize(summary);
+    }
+    if (!queues.empty())
+    {
+        queueTelemetry.Write(queues + "-queues.csv");
+        queueTelemetry.Summarize(summary);
+    }
+    if (!goodput.empty())
+    {
+        wifiGoodput.SetRunCost(phases.GetWall("run"), phases.GetEvents("run"));
+        wifiGoodput.Write(goodput);
+        wifiGoodput.Summarize(summary);
+    }
+    if (!results.empty())
+    {
+        phases.Summarize(summary);
+        stack.Summarize(summary);
+        summary.Write(results);
+    }
+    if (!nodeMemory.empty())
+    {
+        stack.WriteNodeMemory(nodeMemory);
+    }
     Simulator::Destroy();
     return 0;
 }
@@ -13,17 +13,21 @@
  * along with this program; if not, write to the Free Software
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
-#include "ns3/core-module.h"
-#include "ns3/network-module.h"
-#include "ns3/internet-module.h"
-#include "ns3/point-to-point-module.h"
-#include "ns3/applications-module.h"
-#include "ns3/netanim-module.h"
-#include "ns3/mobility-module.h"
-#include "ns3/csma-module.h"
-#include "ns3/yans-wifi-helper.h"
-#include "ns3/ssid.h"
-#include "ns3/ipv4-global-routing-helper.h"
+#include "topology-engine.h"
+#include "run-summary.h"
+#include "latency-histogram.h"
+#include "flow-metrics.h"
+#include "event-log.h"
+#include "routing-cache.h"
+#include "phase-timer.h"
+#include "ladder-scheduler.h"
+#include "warm-start.h"
+#include "live-monitor.h"
+#include "wifi-goodput.h"
+
+#ifdef NS3_MPI
+#include "ns3/mpi-interface.h"
+#endif
 
 //Udp server --> (Local0, Remote0, Remote1) -->R0, L0 R1
 
@@ -68,358 +72,385 @@ NS_LOG_COMPONENT_DEFINE("IITGoaNetwork");
 
 int main(int argc, char *argv[])
 {
-  // Defining Constants Used
-  uint32_t nCsma = 3;
-  uint32_t nWifi = 2;
+  std::string topology = "scratch/IITGoaNetwork.topo";
+  std::string assets = "/home/percy/ns3/ns-allinone-3.33/ns-3.33/assets/";
+  std::string nCsma = "";
+  std::string nWifi = "";
+  std::string lanFabric = "";
+  std::string aqm = "";
+  std::string bgLoad = "";
+  std::string background = "fluid";
+  std::string vars = "";
+  bool tracing = true;
+  std::string pcapng = "";
+  uint32_t snaplen = 0;
+  bool animation = true;
+  std::string animFile = "IITGoaNetwork.xml";
+  Time animPoll = Seconds(0.25);
+  Time animStart = Seconds(0);
+  Time animStop = Seconds(0);
+  uint32_t animSample = 1;
+  bool animPerFlow = false;
+  bool animMeta = false;
+  bool mpi = false;
+  std::string sync = "gtw";
+  std::string results = "";
+  bool verbose = true;
+  std::string eventLog = "";
+  std::string flows = "";
+  Time flowInterval = Seconds(1);
+  std::string latency = "";
+  std::string queues = "";
+  Time queueInterval = MilliSeconds(100);
+  std::string routeCache = "";
+  bool routeIncremental = false;
+  std::string scheduler = "map";
+  std::string stack = "full";
+  std::string nodeMemory = "";
+  Time warmStart = Seconds(0);
+  uint32_t variants = 1;
+  uint32_t jobs = 0;
+  std::string warmDir = "warm";
+  std::string monitor = "";
+  std::string goodput = "";
+
+  CommandLine cmd(__FILE__);
+  cmd.AddValue("topology", "Topology file describing the campus", topology);
+  cmd.AddValue("nCsma", "Number of extra LAN nodes (overrides the topology file)", nCsma);
+  cmd.AddValue("nWifi", "Number of wifi STA devices (overrides the topology file)", nWifi);
+  cmd.AddValue("aqm", "Queue disc on the L0-R0 and R1-L0 bottlenecks: none, fqcodel, pie or red (overrides the topology file)", aqm);
+  cmd.AddValue("bgLoad", "Background load on the backbone links, a rate or a percentage of each link's rate (overrides the topology file)", bgLoad);
+  cmd.AddValue("background", "Background load simulated as fluid or as packet (the reference)", background);
+  cmd.AddValue("lanFabric", "LAN built as a shared CSMA bus or a learning switch: bus or switch (overrides the topology file)", lanFabric);
+  cmd.AddValue("vars", "Other topology variables, e.g. \"wifiChannel=spatial;wifiStandard=ac;wifiAmpdu=1048575\"", vars);
+  cmd.AddValue("tracing", "Enable pcap tracing", tracing);
+  cmd.AddValue("pcapng", "Trace every device into this one PCAP-NG file (.gz/.zst to compress) instead of per-device pcap files", pcapng);
+  cmd.AddValue("snaplen", "Bytes of each packet kept in the PCAP-NG trace (0: whole packet)", snaplen);
+  cmd.AddValue("animation", "Write a NetAnim trace", animation);
+  cmd.AddValue("animFile", "NetAnim trace file (.gz/.zst to compress)", animFile);
+  cmd.AddValue("animPoll", "Interval between NetAnim mobility updates", animPoll);
+  cmd.AddValue("animStart", "Start of the recorded NetAnim window", animStart);
+  cmd.AddValue("animStop", "End of the recorded NetAnim window (0: end of the run)", animStop);
+  cmd.AddValue("animSample", "Record one packet (or flow, see animPerFlow) in N", animSample);
+  cmd.AddValue("animPerFlow", "Sample whole IPv4 flows instead of single packets", animPerFlow);
+  cmd.AddValue("animMeta", "Add packet contents to the NetAnim trace", animMeta);
+  cmd.AddValue("assets", "Directory holding the NetAnim node images", assets);
+  cmd.AddValue("mpi", "Run distributed over MPI ranks (mpirun -np N)", mpi);
+  cmd.AddValue("sync", "MPI synchronizer: gtw (granted time window) or null (null message)", sync);
+  cmd.AddValue("results", "Write a one-row CSV summary of the run to this file", results);
+  cmd.AddValue("verbose", "Tell echo applications to log if true", verbose);
+  cmd.AddValue("eventLog", "Record echo events into this binary log instead (see EventLogDecoder)", eventLog);
+  cmd.AddValue("flows", "Write per-flow metrics to <flows>-flows.csv, -histograms.csv and -snapshots.csv", flows);
+  cmd.AddValue("flowInterval", "Interval between per-flow snapshots", flowInterval);
+  cmd.AddValue("latency", "Write echo RTT and device queue latency percentiles to <latency>-latency.csv and -latency-buckets.csv", latency);
+  cmd.AddValue("queues", "Write bottleneck queue length and sojourn time to <queues>-queues.csv and -queue-samples.csv", queues);
+  cmd.AddValue("queueInterval", "Interval between bottleneck queue samples", queueInterval);
+  cmd.AddValue("routeCache", "Load the global routes from this file, computing and saving them when the topology changed", routeCache);
+  cmd.AddValue("routeIncremental", "Only recompute the routes a topology change can affect", routeIncremental);
+  cmd.AddValue("scheduler", "Event scheduler: map, list, heap, calendar or ladder", scheduler);
+  cmd.AddValue("stack", "Internet stack: full, or lean (IPv4, ARP, ICMP, UDP, TCP only for bulk flows, no queue discs)", stack);
+  cmd.AddValue("nodeMemory", "Write the heap bytes of each node's internet stack to this CSV file", nodeMemory);
+  cmd.AddValue("warmStart", "Run to this time once, then fork one process per RNG run from there (0: off)", warmStart);
+  cmd.AddValue("variants", "RNG runs forked after --warmStart, from RngRun on", variants);
+  cmd.AddValue("jobs", "Concurrent --warmStart runs (0: one per available core)", jobs);
+  cmd.AddValue("warmDir", "Directory of the --warmStart runs; relative output paths land in <warmDir>/run-<r>", warmDir);
+  cmd.AddValue("monitor", "Answer progress queries on this Unix socket while running (see MonitorClient)", monitor);
+  cmd.AddValue("goodput", "Write the goodput of each Wi-Fi station and the run's cost per delivered MB to this CSV file", goodput);
+  cmd.Parse(argc, argv);
+
+  // Wall time of each step, reported in the --results summary.
+  PhaseTimer phases;
+  phases.Start("setup");
+
+  // Distributed mode: the simulator implementation must be chosen before
+  // MPI is enabled and before any event is scheduled.
+  uint32_t systemId = 0;
+  uint32_t systemCount = 1;
+  if (mpi)
+  {
+#ifdef NS3_MPI
+    if (sync == "null")
+    {
+      GlobalValue::Bind("SimulatorImplementationType", StringValue("ns3::NullMessageSimulatorImpl"));
+    }
+    else
+    {
+      NS_ABORT_MSG_UNLESS(sync == "gtw", "Unknown synchronizer " << sync << ", use gtw or null");
+      GlobalValue::Bind("SimulatorImplementationType", StringValue("ns3::DistributedSimulatorImpl"));
+    }
+    MpiInterface::Enable(&argc, &argv);
+    systemId = MpiInterface::GetSystemId();
+    systemCount = MpiInterface::GetSize();
+#else
+    NS_FATAL_ERROR("--mpi needs ns-3 configured with --enable-mpi");
+#endif
+  }
 
   Time::SetResolution(Time::NS);
-  LogComponentEnable("UdpEchoClientApplication", LOG_LEVEL_INFO);
-  LogComponentEnable("UdpEchoServerApplication", LOG_LEVEL_INFO);
+  UseScheduler(scheduler);
+  if (verbose && eventLog.empty())
+  {
+    LogComponentEnable("UdpEchoClientApplication", LOG_LEVEL_INFO);
+    LogComponentEnable("UdpEchoServerApplication", LOG_LEVEL_INFO);
+  }
   NS_LOG_INFO("Creating Topology");
 
   // ------------------------------------------------------------------------------------------------------------
 
-  // Create nodes R0 and L0
-  NodeContainer server1Nodes;
-  server1Nodes.Create(2);
-
-  // Establish P2P connection in R0 and L0
-  PointToPointHelper pointToPoint1;
-  pointToPoint1.SetDeviceAttribute("DataRate", StringValue("5Mbps"));
-  pointToPoint1.SetChannelAttribute("Delay", StringValue("2ms"));
-  NetDeviceContainer server1Devices;
-  server1Devices = pointToPoint1.Install(server1Nodes);
-
-  // Import internet stack on nodes.
-  InternetStackHelper stack1;
-  stack1.Install(server1Nodes);
-
-  // Assign IP addresses to net devices
-  Ipv4AddressHelper address1;
-  address1.SetBase("152.66.1.0", "255.255.255.0");
-  Ipv4InterfaceContainer interfaces1 = address1.Assign(server1Devices);
-
-  // Make server on R0
-  UdpEchoServerHelper echoServer1(9);
-  ApplicationContainer serverApps1 = echoServer1.Install(server1Nodes.Get(1));
-  serverApps1.Start(Seconds(0.0));
-  serverApps1.Stop(Seconds(11.0));
-
-  // Make client on for R0 on L0
-  UdpEchoClientHelper echoClient1(interfaces1.GetAddress(1), 9);
-  echoClient1.SetAttribute("MaxPackets", UintegerValue(4));
-  echoClient1.SetAttribute("Interval", TimeValue(Seconds(1.0)));
-  echoClient1.SetAttribute("PacketSize", UintegerValue(1024));
-  ApplicationContainer clientApps1 = echoClient1.Install(server1Nodes.Get(0));
-  clientApps1.Start(Seconds(1.0));
-  clientApps1.Stop(Seconds(7.0));
-
-  // ------------------------------------------------------------------------------------------------------------
-
-  // Create node R1
-  NodeContainer server2Nodes;
-  server2Nodes.Create(1);
-
-  // Establish P2P connection in R1 and L0
-  PointToPointHelper pointToPoint2;
-  pointToPoint2.SetDeviceAttribute("DataRate", StringValue("2Mbps"));
-  pointToPoint2.SetChannelAttribute("Delay", StringValue("10ms"));
-  NetDeviceContainer server2Devices;
-  server2Devices = pointToPoint2.Install(server2Nodes.Get(0), server1Nodes.Get(0));
-
-  // Import internet stack on nodes.
-  InternetStackHelper stack2;
-  stack2.Install(server2Nodes);
-
-  // Assign IP addresses to net devices
-  Ipv4AddressHelper address2;
-  address2.SetBase("100.10.1.0", "255.255.255.0");
-  Ipv4InterfaceContainer interfaces2 = address2.Assign(server2Devices);
-
-  // Make server on R1
-  UdpEchoServerHelper echoServer2(20);
-  ApplicationContainer serverApps2 = echoServer2.Install(server2Nodes.Get(0));
-  serverApps2.Start(Seconds(0.0));
-  serverApps2.Stop(Seconds(11.0));
-
-  // Make client for R1 on L0
-  UdpEchoClientHelper echoClient2(interfaces2.GetAddress(0), 20);
-  echoClient2.SetAttribute("MaxPackets", UintegerValue(4));
-  echoClient2.SetAttribute("Interval", TimeValue(Seconds(0.5)));
-  echoClient2.SetAttribute("PacketSize", UintegerValue(256));
-  ApplicationContainer clientApps2 = echoClient2.Install(server1Nodes.Get(0));
-  clientApps2.Start(Seconds(2.5));
-  clientApps2.Stop(Seconds(5.0));
-
-  // ------------------------------------------------------------------------------------------------------------
-  // Create LAN Network
-
-  // Create node n1
-  NodeContainer LANServerNodes;
-  LANServerNodes.Create(1);
-
-  // Establish P2P connection in n1 and L0
-  PointToPointHelper pointToPoint3;
-  pointToPoint3.SetDeviceAttribute("DataRate", StringValue("10Mbps"));
-  pointToPoint3.SetChannelAttribute("Delay", StringValue("1ms"));
-  NetDeviceContainer LANServerDevices;
-  LANServerDevices = pointToPoint3.Install(server1Nodes.Get(0), LANServerNodes.Get(0));
-
-  // Create csma nodes and add node n1 to the container.
-  NodeContainer csmaNodes;
-  csmaNodes.Add(LANServerNodes.Get(0));
-  csmaNodes.Create(nCsma);
-
-  // Making Mobility Model for CSMA nodes.
-  MobilityHelper mobility;
-  mobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
-  mobility.Install(csmaNodes);
-
-  // Giving channel Attributes to csma nodes
-  CsmaHelper csma;
-  csma.SetChannelAttribute("DataRate", StringValue("100Mbps"));
-  csma.SetChannelAttribute("Delay", TimeValue(NanoSeconds(6560)));
-
-  // Make csma devices
-  NetDeviceContainer csmaDevices;
-  csmaDevices = csma.Install(csmaNodes);
-
-  // Import internet stack on nodes.
-  InternetStackHelper stack3;
-  stack3.Install(csmaNodes);
-
-  // Assign IP addresses to net devices
-  Ipv4AddressHelper address3;
-  address3.SetBase("10.1.0.0", "255.255.0.0");
-  Ipv4InterfaceContainer interfaces3 = address3.Assign(LANServerDevices);
-
-  // Assign IP addresses to csma devices.
-  Ipv4AddressHelper address4;
-  address4.SetBase("10.1.1.0", "255.255.255.0");
-  Ipv4InterfaceContainer csmaInterfaces;
-  csmaInterfaces = address4.Assign(csmaDevices);
-
-  // Make server on node L0
-  UdpEchoServerHelper echoServerLocal(30);
-  ApplicationContainer serverAppsLocal = echoServerLocal.Install(server1Nodes.Get(0));
-  serverAppsLocal.Start(Seconds(0.0));
-  serverAppsLocal.Stop(Seconds(11.0));
-
-  // Make client for L0 on node n4
-  UdpEchoClientHelper echoClientLAN(interfaces3.GetAddress(0), 30);
-  echoClientLAN.SetAttribute("MaxPackets", UintegerValue(3));
-  echoClientLAN.SetAttribute("Interval", TimeValue(Seconds(1.5)));
-  echoClientLAN.SetAttribute("PacketSize", UintegerValue(512));
-  ApplicationContainer clientAppsLAN = echoClientLAN.Install(csmaNodes.Get(nCsma));
-  clientAppsLAN.Start(Seconds(4.0));
-  clientAppsLAN.Stop(Seconds(8.0));
-
-  // ------------------------------------------------------------------------------------------------------------
-  // Create WIFI Network
-
-  // Create node n0*
-  NodeContainer WifiServerNode;
-  WifiServerNode.Create(1);
-
-  // Establish P2P connection in n0* and L0
-  PointToPointHelper pointToPoint4;
-  pointToPoint4.SetDeviceAttribute("DataRate", StringValue("10Mbps"));
-  pointToPoint4.SetChannelAttribute("Delay", StringValue("2ms"));
-  NetDeviceContainer WifiServerDevices;
-  WifiServerDevices = pointToPoint4.Install(WifiServerNode.Get(0), server1Nodes.Get(0));
-
-  // Create wifi nodes
-  NodeContainer wifiStaNodes;
-  wifiStaNodes.Create(nWifi);
-  NodeContainer wifiApNode = WifiServerNode.Get(0);
-
-  // Giving channel Attributes to wifi nodes
-  YansWifiChannelHelper channel = YansWifiChannelHelper::Default();
-  YansWifiPhyHelper phy;
-  phy.SetChannel(channel.Create());
-
-  WifiHelper wifi;
-  wifi.SetRemoteStationManager("ns3::AarfWifiManager");
-
-  WifiMacHelper mac;
-  Ssid ssid = Ssid("ns-3-ssid");
-  mac.SetType("ns3::StaWifiMac",
-              "Ssid", SsidValue(ssid),
-              "ActiveProbing", BooleanValue(false));
-
-  NetDeviceContainer staDevices;
-  staDevices = wifi.Install(phy, mac, wifiStaNodes);
-
-  mac.SetType("ns3::ApWifiMac",
-              "Ssid", SsidValue(ssid));
-
-  NetDeviceContainer apDevices;
-  apDevices = wifi.Install(phy, mac, wifiApNode);
-
-  // Setting mobility model for wifi nodes
-  MobilityHelper mobility1;
-
-  mobility1.SetPositionAllocator("ns3::GridPositionAllocator",
-                                 "MinX", DoubleValue(100.0),
-                                 "MinY", DoubleValue(100.0),
-                                 "DeltaX", DoubleValue(5.0),
-                                 "DeltaY", DoubleValue(10.0),
-                                 "GridWidth", UintegerValue(3),
-                                 "LayoutType", StringValue("RowFirst"));
-
-  mobility1.SetMobilityModel("ns3::RandomWalk2dMobilityModel",
-                             "Bounds", RectangleValue(Rectangle(-50, 150, -50, 150)));
-  mobility1.Install(wifiStaNodes);
-
-  mobility1.SetMobilityModel("ns3::ConstantPositionMobilityModel");
-  mobility1.Install(wifiApNode);
-
-  // Import internet stack on nodes
-  InternetStackHelper stack4;
-  stack4.Install(wifiApNode);
-  stack4.Install(wifiStaNodes);
-
-  // Assign IP addresses to Devices
-  Ipv4AddressHelper address5;
-  address5.SetBase("10.10.10.0", "255.255.255.0");
-  Ipv4InterfaceContainer interfaces4;
-  interfaces4 = address5.Assign(WifiServerDevices);
-
-  address5.SetBase("10.10.30.0", "255.255.255.0");
-  Ipv4InterfaceContainer wifiNodesInterfaces;
-  Ipv4InterfaceContainer apNodeInterface;
-
-  wifiNodesInterfaces = address5.Assign(staDevices);
-  apNodeInterface = address5.Assign(apDevices);
-
-  // Make server on L0
-  UdpEchoServerHelper echoServer3(100);
-
-  ApplicationContainer serverApps3 = echoServer3.Install(server1Nodes.Get(0));
-  serverApps3.Start(Seconds(0.0));
-  serverApps3.Stop(Seconds(11.0));
-
-  // Make client on n2* to L0
-  UdpEchoClientHelper echoClient3(interfaces3.GetAddress(0), 100);
-  echoClient3.SetAttribute("MaxPackets", UintegerValue(3));
-  echoClient3.SetAttribute("Interval", TimeValue(Seconds(1.25)));
-  echoClient3.SetAttribute("PacketSize", UintegerValue(1024));
+  TopologySpec spec;
+  if (!nCsma.empty())
+  {
+    spec.SetVariable("nCsma", nCsma);
+  }
+  if (!nWifi.empty())
+  {
+    spec.SetVariable("nWifi", nWifi);
+  }
+  if (!lanFabric.empty())
+  {
+    spec.SetVariable("lanFabric", lanFabric);
+  }
+  if (!aqm.empty())
+  {
+    spec.SetVariable("aqm", aqm);
+  }
+  if (!bgLoad.empty())
+  {
+    spec.SetVariable("bgLoad", bgLoad);
+  }
+  std::stringstream overrides(vars);
+  std::string var;
+  while (std::getline(overrides, var, ';'))
+  {
+    size_t eq = var.find('=');
+    NS_ABORT_MSG_IF(eq == std::string::npos, "--vars expects name=value pairs separated by ';'");
+    spec.SetVariable(var.substr(0, eq), var.substr(eq + 1));
+  }
+  spec.Load(topology);
 
-  ApplicationContainer clientApps3 = echoClient3.Install(wifiStaNodes.Get(nWifi - 1));
-  clientApps3.Start(Seconds(4.0));
-  clientApps3.Stop(Seconds(9.0));
+  TopologyBuilder campus(spec);
+  campus.SetStackProfile(stack);
+  campus.SetBackgroundMode(background);
+  if (mpi)
+  {
+    campus.Partition(systemCount);
+    campus.SetLocalRank(systemId);
+  }
+  campus.Build(&phases);
+  // Fixed streams, the same whether the run is sequential or on any number
+  // of ranks.
+  campus.AssignStreams(0);
 
   // ------------------------------------------------------------------------------------------------------------
-  // Data transfer between n3 and R0
 
-  // Make client on n3 to R0
-  echoClient1.SetAttribute("MaxPackets", UintegerValue(3));
-  echoClient1.SetAttribute("Interval", TimeValue(Seconds(1.0)));
-  echoClient1.SetAttribute("PacketSize", UintegerValue(512));
+  phases.Start("routing");
+  RoutingCache routes;
+  if (routeCache.empty())
+  {
+    Ipv4GlobalRoutingHelper::PopulateRoutingTables();
+  }
+  else
+  {
+    routes.Populate(routeCache, routeIncremental);
+  }
+  Simulator::Stop(spec.stopTime);
 
-  ApplicationContainer clientApps4 = echoClient1.Install(csmaNodes.Get(nCsma - 1));
-  clientApps4.Start(Seconds(5.0));
-  clientApps4.Stop(Seconds(10.0));
+  // Seed sweep: every run continues from the same warmed-up state.  The
+  // instrumentation below is set up in each run, so it misses the warm-up,
+  // which must end before the first client starts.
+  WarmStart warm;
+  if (warmStart > Seconds(0))
+  {
+    NS_ABORT_MSG_IF(mpi, "--warmStart cannot be used with --mpi");
+    NS_ABORT_MSG_IF(warmStart >= spec.stopTime, "--warmStart must end before the simulation stops");
+    NS_ABORT_MSG_IF(warmStart > WarmStart::GetFirstStart(campus.GetClientApps()) ||
+                    warmStart > WarmStart::GetFirstStart(campus.GetLoadApps()),
+                    "--warmStart must end before the first flow starts");
+    NS_ABORT_MSG_IF(!results.empty() && results[0] == '/', "--warmStart needs a relative --results path");
+    // Each run answers on its own socket in its run directory.
+    NS_ABORT_MSG_IF(!monitor.empty() && monitor[0] == '/', "--warmStart needs a relative --monitor path");
+    phases.Start("warmup");
+    warm.SetDirectory(warmDir);
+    warm.SetRuns(RngSeedManager::GetRun(), variants);
+    warm.SetJobs(jobs);
+    if (!warm.Fork(warmStart, NodeContainer::GetGlobal()))
+    {
+      if (!results.empty())
+      {
+        uint32_t merged = warm.Merge(results, results);
+        std::cout << merged << " runs merged into " << results << std::endl;
+      }
+      Simulator::Destroy();
+      return warm.GetFailed() ? 1 : 0;
+    }
+  }
 
   // ------------------------------------------------------------------------------------------------------------
-  // Data transfer between n1* and R1
-
-  // Make client on n1* to R1
-  echoClient2.SetAttribute("MaxPackets", UintegerValue(3));
-  echoClient2.SetAttribute("Interval", TimeValue(Seconds(0.3)));
-  echoClient2.SetAttribute("PacketSize", UintegerValue(1024));
 
-  ApplicationContainer clientApps5 = echoClient2.Install(wifiStaNodes.Get(nWifi - 2));
-  clientApps5.Start(Seconds(6.5));
-  clientApps5.Stop(Seconds(9.0));
+  phases.Start("instrumentation");
 
-  // ------------------------------------------------------------------------------------------------------------
-  // Data transfer between n2 and n2*
+  RunSummary summary;
+  std::map<std::string, std::string>::const_iterator it;
+  for (it = spec.GetVariables().begin(); it != spec.GetVariables().end(); it++)
+  {
+    // Numeric topology variables become columns of the summary.
+    char *end = 0;
+    double value = std::strtod(it->second.c_str(), &end);
+    if (!it->second.empty() && *end == '\0')
+    {
+      summary.Set(it->first, value);
+    }
+  }
+  if (!routeCache.empty())
+  {
+    summary.Set("route_columns_computed", routes.GetComputedColumns());
+  }
+  summary.TrackEchoClients(campus.GetClientApps());
 
-  // Make server on n2*
-  UdpEchoServerHelper echoServerWifi(122);
-  ApplicationContainer serverAppsWifi = echoServerWifi.Install(wifiStaNodes.Get(nWifi - 1));
-  serverAppsWifi.Start(Seconds(0.0));
-  serverAppsWifi.Stop(Seconds(11.0));
+  std::string rankSuffix = systemCount > 1 ? ".rank" + std::to_string(systemId) : "";
+  EventLog events;
+  if (!eventLog.empty())
+  {
+    events.Open(eventLog + rankSuffix);
+    events.TrackEchoClients(campus.GetClientApps());
+    events.TrackEchoServers(campus.GetServerApps());
+  }
 
-  // Make client on n2 to n2*
-  UdpEchoClientHelper echoClient6(wifiNodesInterfaces.GetAddress(1), 122);
-  echoClient6.SetAttribute("MaxPackets", UintegerValue(3));
-  echoClient6.SetAttribute("Interval", TimeValue(Seconds(1)));
-  echoClient6.SetAttribute("PacketSize", UintegerValue(1024));
-  ApplicationContainer clientApps6 = echoClient6.Install(csmaNodes.Get(nCsma - 2));
-  clientApps6.Start(Seconds(6.0));
-  clientApps6.Stop(Seconds(10.0));
+  // Per-flow metrics, labelled with the node names of the topology file.
+  FlowMetrics flowMetrics;
+  if (!flows.empty())
+  {
+    flowMetrics.Install(campus.GetLocalNodes());
+    for (uint32_t i = 0; i < spec.nodes.size(); i++)
+    {
+      flowMetrics.NameNode(campus.GetNodes().Get(i), spec.nodes[i].name);
+    }
+    flowMetrics.EnableSnapshots(flows + "-snapshots.csv" + rankSuffix, flowInterval);
+  }
 
-  // ------------------------------------------------------------------------------------------------------------
+  // Latency histograms of the echo clients and of every device queue.
+  LatencyMonitor latencyMonitor;
+  if (!latency.empty())
+  {
+    for (uint32_t i = 0; i < spec.nodes.size(); i++)
+    {
+      latencyMonitor.NameNode(campus.GetNodes().Get(i), spec.nodes[i].name);
+    }
+    latencyMonitor.TrackEchoClients(campus.GetClientApps());
+    latencyMonitor.TrackNodes(campus.GetLocalNodes());
+  }
 
-  mobility1.Install(server1Nodes);
-  mobility1.Install(server2Nodes);
+  // Queue length and sojourn time on the aqm= links.
+  QueueTelemetry queueTelemetry;
+  if (!queues.empty())
+  {
+    campus.TrackBottlenecks(queueTelemetry);
+    queueTelemetry.EnableSampling(queues + "-queue-samples.csv" + rankSuffix, queueInterval);
+  }
 
-  // ------------------------------------------------------------------------------------------------------------
+  // Goodput of the Wi-Fi stations, for comparing standards and aggregation.
+  WifiGoodput wifiGoodput;
+  if (!goodput.empty())
+  {
+    for (uint32_t i = 0; i < spec.nodes.size(); i++)
+    {
+      wifiGoodput.NameNode(campus.GetNodes().Get(i), spec.nodes[i].name);
+    }
+    wifiGoodput.TrackStations(campus.GetStations());
+    wifiGoodput.Install(campus.GetLocalNodes());
+  }
 
-  Ipv4GlobalRoutingHelper::PopulateRoutingTables();
-  Simulator::Stop(Seconds(11.0));
+  // Live progress and per-flow counters, queried with MonitorClient.
+  LiveMonitor liveMonitor;
+  if (!monitor.empty())
+  {
+    for (uint32_t i = 0; i < spec.nodes.size(); i++)
+    {
+      liveMonitor.NameNode(campus.GetNodes().Get(i), spec.nodes[i].name);
+    }
+    liveMonitor.TrackEchoClients(campus.GetClientApps());
+    liveMonitor.TrackLoads(campus.GetLoadApps());
+    liveMonitor.TrackSinks(campus.GetSinkApps());
+    liveMonitor.Open(monitor + rankSuffix);
+  }
 
   // -------------------------------------------
-  pointToPoint1.EnablePcapAll("IITGoa_Network", server1Nodes.Get(0));
-  pointToPoint3.EnablePcapAll("IITGoa_Network", LANServerNodes.Get(0));
-  csma.EnablePcapAll("IITGoa_Network", csmaNodes.Get(nCsma));
-  phy.EnablePcapAll("IITGoa_Network", WifiServerNode.Get(0));
-  phy.EnablePcapAll("IITGoa_Network", wifiStaNodes.Get(nWifi - 1));
+  phases.Start("tracing");
+  PcapNgWriter pcapngWriter;
+  if (tracing && !pcapng.empty())
+  {
+    pcapngWriter.Open(pcapng + rankSuffix, snaplen);
+    campus.EnablePcapNg(pcapngWriter);
+  }
+  else if (tracing)
+  {
+    campus.EnablePcapAll("IITGoa_Network");
+  }
   // -------------------------------------------
-  // Setting the position of nodes on NetAnim
-  AnimationInterface anim("IITGoaNetwork.xml");
-
-  anim.UpdateNodeDescription(0, "Local Server");
-  anim.UpdateNodeDescription(1, "Remote Server 1");
-  anim.UpdateNodeDescription(2, "Remote Server 2");
-  anim.UpdateNodeDescription(3, "LAN Node 1");
-  anim.UpdateNodeDescription(4, "LAN Node 2");
-  anim.UpdateNodeDescription(5, "LAN Node 3");
-  anim.UpdateNodeDescription(6, "LAN Node 4");
-  anim.UpdateNodeDescription(7, "WiFi AP Node");
-  anim.UpdateNodeDescription(8, "WiFi Device 1");
-  anim.UpdateNodeDescription(9, "WiFi Deivce 2");
-
-  std::string path = "/home/percy/ns3/ns-allinone-3.33/ns-3.33/assets/";
-  uint32_t mobileImg = anim.AddResource(path + "mobile.png");
-  uint32_t laptopImg = anim.AddResource(path + "laptop.png");
-  uint32_t routerImg = anim.AddResource(path + "router.png");
-  uint32_t serverImg = anim.AddResource(path + "server.png");
-
-  anim.UpdateNodeImage(0, serverImg);
-  anim.UpdateNodeSize(0, 20.0, 20.0);
-  anim.UpdateNodeImage(1, serverImg);
-  anim.UpdateNodeSize(1, 20.0, 20.0);
-  anim.UpdateNodeImage(2, serverImg);
-  anim.UpdateNodeSize(2, 20.0, 20.0);
-  anim.UpdateNodeImage(3, laptopImg);
-  anim.UpdateNodeSize(3, 20.0, 20.0);
-  anim.UpdateNodeImage(4, laptopImg);
-  anim.UpdateNodeSize(4, 20.0, 20.0);
-  anim.UpdateNodeImage(5, laptopImg);
-  anim.UpdateNodeSize(5, 20.0, 20.0);
-  anim.UpdateNodeImage(6, laptopImg);
-  anim.UpdateNodeSize(6, 20.0, 20.0);
-  anim.UpdateNodeImage(7, routerImg);
-  anim.UpdateNodeSize(7, 20.0, 20.0);
-  anim.UpdateNodeImage(8, mobileImg);
-  anim.UpdateNodeSize(8, 20.0, 20.0);
-  anim.UpdateNodeImage(9, mobileImg);
-  anim.UpdateNodeSize(9, 20.0, 20.0);
+  // Node descriptions, images and sizes come from the topology file.
+  // NetAnim only sees one rank's events, so it is left out of MPI runs.
+  AnimationStream anim;
+  if (animation && !mpi)
+  {
+    anim.SetMobilityPollInterval(animPoll);
+    anim.SetWindow(animStart, animStop);
+    anim.SetPacketSampling(animSample, animPerFlow);
+    anim.EnablePacketMetadata(animMeta);
+    anim.Open(animFile);
+    campus.SetupAnimation(anim, assets);
+  }
+  phases.Start("run");
+  Simulator::Run();
+  phases.Start("output");
+  liveMonitor.Close();
+  anim.Close();
 
-  anim.SetConstantPosition(server1Nodes.Get(0), 50.0, 50.0);
-  anim.SetConstantPosition(server1Nodes.Get(1), 0.0, 0.0);
-  anim.SetConstantPosition(server2Nodes.Get(0), 100.0, 0.0);
+  pcapngWriter.Close();
+  events.Close();
 
-  for (uint32_t i = 0; i <= nCsma; i++)
+  if (!flows.empty())
   {
-    anim.SetConstantPosition(csmaNodes.Get(i), double(25 * i), double(150));
+    flowMetrics.Write(flows + rankSuffix);
+    flowMetrics.Summarize(summary);
+  }
+  if (!latency.empty())
+  {
+    latencyMonitor.Write(latency + rankSuffix);
+    latencyMonitor.Summarize(summary);
+  }
+  if (!queues.empty())
+  {
+    queueTelemetry.Write(queues + "-queues.csv" + rankSuffix);
+    queueTelemetry.Summarize(summary);
+  }
+  if (!goodput.empty())
+  {
+    wifiGoodput.SetRunCost(phases.GetWall("run"), phases.GetEvents("run"));
+    wifiGoodput.Write(goodput + rankSuffix);
+    wifiGoodput.Summarize(summary);
+  }
+  if (!results.empty())
+  {
+    // Each rank only sees its own clients.
+    phases.Summarize(summary);
+    campus.GetStackProfile().Summarize(summary);
+    if (!campus.GetBackground().IsEmpty())
+    {
+      campus.GetBackground().Summarize(summary);
+    }
+    summary.Write(results + rankSuffix);
+  }
+  if (!nodeMemory.empty())
+  {
+    campus.GetStackProfile().WriteNodeMemory(nodeMemory + rankSuffix);
   }
-
-  anim.SetConstantPosition(WifiServerNode.Get(0), 100.0, 75.0);
-  Simulator::Run();
   Simulator::Destroy();
+
+#ifdef NS3_MPI
+  if (mpi)
+  {
+    MpiInterface::Disable();
+  }
+#endif
   return 0;
 }
@@ -0,0 +1,109 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/core-module.h"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Queries a HomeNetwork or IITGoaNetwork run started with --monitor and
+// prints the answer (see live-monitor.h): simulated time, events executed
+// and queued, event rate, memory, and per-flow packet counters.
+//
+//   build/scratch/IITGoaNetwork --monitor=/tmp/campus.sock &
+//   build/scratch/MonitorClient --socket=/tmp/campus.sock --command=status
+//   build/scratch/MonitorClient --socket=/tmp/campus.sock --watch=2
+//
+// With --watch the query is repeated every so many seconds until the run
+// ends and its socket goes away.
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("MonitorClient");
+
+// Sends command and returns the answer, or false when nothing listens.
+static bool Query(const std::string &path, const std::string &command, std::string &answer)
+{
+  sockaddr_un address;
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  NS_ABORT_MSG_IF(fd < 0, "socket failed: " << std::strerror(errno));
+  if (connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0)
+  {
+    close(fd);
+    return false;
+  }
+  std::string line = command + "\n";
+  if (send(fd, line.data(), line.size(), MSG_NOSIGNAL) != ssize_t(line.size()))
+  {
+    close(fd);
+    return false;
+  }
+  answer.clear();
+  char buffer[4096];
+  ssize_t n;
+  while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0)
+  {
+    answer.append(buffer, n);
+  }
+  close(fd);
+  return true;
+}
+
+int main(int argc, char *argv[])
+{
+  std::string path = "";
+  std::string command = "all";
+  double watch = 0;
+
+  CommandLine cmd(__FILE__);
+  cmd.AddValue("socket", "Unix socket given to the simulation with --monitor", path);
+  cmd.AddValue("command", "What to ask: status, flows or all", command);
+  cmd.AddValue("watch", "Repeat the query every so many seconds until the run ends (0: once)", watch);
+  cmd.Parse(argc, argv);
+
+  NS_ABORT_MSG_IF(path.empty(), "Give the simulation's --monitor socket with --socket");
+  NS_ABORT_MSG_UNLESS(command == "status" || command == "flows" || command == "all",
+                      "Unknown command " << command << ", use status, flows or all");
+  NS_ABORT_MSG_IF(watch < 0, "--watch must not be negative");
+
+  std::string answer;
+  if (!Query(path, command, answer))
+  {
+    std::cerr << "Nothing answers on " << path << ": " << std::strerror(errno) << std::endl;
+    return 1;
+  }
+  if (watch == 0)
+  {
+    std::cout << answer;
+    return 0;
+  }
+  do
+  {
+    // Clear the terminal and home the cursor.
+    std::cout << "\033[2J\033[H" << path << "\n" << answer << std::flush;
+    usleep(useconds_t(watch * 1e6));
+  } while (Query(path, command, answer));
+  std::cout << "Run ended" << std::endl;
+  return 0;
+}
@@ -0,0 +1,1056 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/core-module.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sched.h>
+#include <sstream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+// Per-flow delay, RTT, throughput and loss from the pcap files of one run
+// of HomeNetwork or IITGoaNetwork, without Wireshark.
+//
+// Every capture file (classic pcap, or uncompressed PCAP-NG from --pcapng)
+// is mapped into memory and parsed in place by a pool of threads, one
+// file per thread at a time.  Point-to-point, CSMA and Wi-Fi (802.11,
+// with or without radiotap, A-MPDU and A-MSDU included) frames are reduced to the
+// IPv4 fields that matter.  The devices' captures are then merged by
+// timestamp and spread over one shard per thread by packet identity.
+//
+// A packet is identified by its flow (addresses, ports, protocol) and
+// IPv4 identification; ns-3 numbers packets per source, destination and
+// protocol, and an identification seen again more than maxDelay after
+// its last sighting is a new packet.  The device that sees a packet first
+// sent it, which tells which device owns which address.  A packet is
+// delivered when the device owning its destination saw it (last time,
+// so that MAC retries and overheard frames count right), or, for
+// addresses that never sent anything, when any other device did.
+// Packets sent within maxDelay of the end of the captures are in flight
+// and count neither as delivered nor as lost.
+//
+// UDP flows with traffic in both directions are echo flows; the direction
+// that started first carries the requests.  Each reply is matched to the
+// latest unanswered request that had reached the server when the reply
+// left, and the round trip runs from request sent to reply delivered.
+//
+// The summary has one row per flow:
+//
+//   src,sport,dst,dport,proto,sent,delivered,lost,loss,bytes,
+//   throughput_kbps,delay_mean_ms,delay_min_ms,delay_max_ms,
+//   rtt_samples,rtt_mean_ms,rtt_min_ms,rtt_max_ms
+//
+// where bytes are transport payload bytes delivered and throughput is
+// over the time from first packet sent to last delivered.
+//
+//   build/scratch/PcapAnalyzer --input=IITGoa_Network --output=flows.csv
+//   build/scratch/PcapAnalyzer --input=run-1/,capture.pcapng --jobs=8
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("PcapAnalyzer");
+
+static const uint32_t LINKTYPE_ETHERNET = 1;
+static const uint32_t LINKTYPE_PPP = 9;
+static const uint32_t LINKTYPE_RAW = 101;
+static const uint32_t LINKTYPE_IEEE802_11 = 105;
+static const uint32_t LINKTYPE_RADIOTAP = 127;
+static const uint32_t LINKTYPE_IPV4 = 228;
+
+// One IPv4 packet as one device saw it.
+struct Capture
+{
+  uint64_t time; // ns
+  uint32_t src;
+  uint32_t dst;
+  uint32_t bytes; // transport payload
+  uint16_t sport;
+  uint16_t dport;
+  uint16_t id;
+  uint8_t proto;
+};
+
+struct Device
+{
+  std::string name;
+  std::vector<Capture> captures;
+};
+
+// A capture after the merge: flow index instead of addresses and ports.
+struct Sighting
+{
+  uint64_t time;
+  uint32_t flow;
+  uint32_t device;
+  uint32_t bytes;
+  uint16_t id;
+};
+
+struct FlowKey
+{
+  uint32_t src;
+  uint32_t dst;
+  uint16_t sport;
+  uint16_t dport;
+  uint8_t proto;
+
+  bool operator==(const FlowKey &other) const
+  {
+    return src == other.src && dst == other.dst && sport == other.sport && dport == other.dport &&
+           proto == other.proto;
+  }
+};
+
+struct FlowKeyHash
+{
+  size_t operator()(const FlowKey &key) const
+  {
+    uint64_t a = (uint64_t(key.src) << 32) | key.dst;
+    uint64_t b = (uint64_t(key.sport) << 24) | (uint64_t(key.dport) << 8) | key.proto;
+    return std::hash<uint64_t>()(a * 0x9E3779B97F4A7C15ull ^ b);
+  }
+};
+
+// One packet, over all the devices that saw it.
+struct TracedPacket
+{
+  uint32_t flow;
+  uint32_t firstDevice;
+  uint32_t bytes;
+  bool atOwner;
+  bool elsewhere;
+  uint64_t sent;
+  uint64_t last;
+  uint64_t arrival; // last sighting at the destination's device
+  uint64_t lastElsewhere;
+};
+
+struct FlowStats
+{
+  FlowStats()
+    : sent(0),
+      delivered(0),
+      inFlight(0),
+      bytes(0),
+      firstSent(UINT64_MAX),
+      lastArrival(0),
+      delaySum(0),
+      delayMin(UINT64_MAX),
+      delayMax(0),
+      rttSamples(0),
+      rttSum(0),
+      rttMin(UINT64_MAX),
+      rttMax(0)
+  {
+  }
+
+  uint64_t sent;
+  uint64_t delivered;
+  uint64_t inFlight;
+  uint64_t bytes;
+  uint64_t firstSent;
+  uint64_t lastArrival;
+  double delaySum;
+  uint64_t delayMin;
+  uint64_t delayMax;
+  uint64_t rttSamples;
+  double rttSum;
+  uint64_t rttMin;
+  uint64_t rttMax;
+};
+
+static std::vector<std::string> Split(const std::string &text, char sep)
+{
+  std::vector<std::string> items;
+  std::stringstream ss(text);
+  std::string item;
+  while (std::getline(ss, item, sep))
+  {
+    if (!item.empty())
+    {
+      items.push_back(item);
+    }
+  }
+  return items;
+}
+
+static bool EndsWith(const std::string &text, const std::string &suffix)
+{
+  return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static std::string AddressString(uint32_t address)
+{
+  std::ostringstream oss;
+  oss << (address >> 24) << "." << ((address >> 16) & 0xff) << "." << ((address >> 8) & 0xff) << "." << (address & 0xff);
+  return oss.str();
+}
+
+// Runs fn(0) ... fn(n - 1) on up to jobs threads.
+static void ParallelFor(size_t n, uint32_t jobs, const std::function<void(size_t)> &fn)
+{
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> threads;
+  for (uint32_t t = 0; t < jobs && t < n; t++)
+  {
+    threads.push_back(std::thread([&]() {
+      for (size_t i = next++; i < n; i = next++)
+      {
+        fn(i);
+      }
+    }));
+  }
+  for (size_t t = 0; t < threads.size(); t++)
+  {
+    threads[t].join();
+  }
+}
+
+// --input items: files, directories (every .pcap and .pcapng in them) and
+// prefixes (every <prefix>-*.pcap, the names EnablePcap gives).
+static std::vector<std::string> FindInputs(const std::string &input)
+{
+  std::vector<std::string> files;
+  std::vector<std::string> items = Split(input, ',');
+  for (size_t i = 0; i < items.size(); i++)
+  {
+    struct stat st;
+    std::string dir;
+    std::string prefix;
+    if (stat(items[i].c_str(), &st) == 0 && !S_ISDIR(st.st_mode))
+    {
+      files.push_back(items[i]);
+      continue;
+    }
+    if (stat(items[i].c_str(), &st) == 0)
+    {
+      dir = items[i];
+    }
+    else
+    {
+      size_t slash = items[i].rfind('/');
+      dir = slash == std::string::npos ? "." : items[i].substr(0, slash);
+      prefix = items[i].substr(slash == std::string::npos ? 0 : slash + 1) + "-";
+    }
+    DIR *d = opendir(dir.c_str());
+    NS_ABORT_MSG_IF(d == 0, "No capture file, directory or prefix " << items[i]);
+    std::vector<std::string> found;
+    for (struct dirent *entry = readdir(d); entry != 0; entry = readdir(d))
+    {
+      std::string name = entry->d_name;
+      if (name.compare(0, prefix.size(), prefix) == 0 &&
+          (EndsWith(name, ".pcap") || (prefix.empty() && EndsWith(name, ".pcapng"))))
+      {
+        found.push_back(dir + "/" + name);
+      }
+    }
+    closedir(d);
+    NS_ABORT_MSG_IF(found.empty(), "No capture files for " << items[i]);
+    std::sort(found.begin(), found.end());
+    files.insert(files.end(), found.begin(), found.end());
+  }
+  return files;
+}
+
+static inline uint16_t Be16(const uint8_t *p)
+{
+  return (uint16_t(p[0]) << 8) | p[1];
+}
+
+static inline uint32_t Be32(const uint8_t *p)
+{
+  return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+}
+
+// File fields, in the byte order the file was written in.
+static inline uint16_t Get16(const uint8_t *p, bool swapped)
+{
+  uint16_t value;
+  std::memcpy(&value, p, 2);
+  return swapped ? __builtin_bswap16(value) : value;
+}
+
+static inline uint32_t Get32(const uint8_t *p, bool swapped)
+{
+  uint32_t value;
+  std::memcpy(&value, p, 4);
+  return swapped ? __builtin_bswap32(value) : value;
+}
+
+// Frame parsing.  Each function gets the bytes that were captured, which
+// may be fewer than were sent (snap length); sizes come from the headers.
+static void ParseIpv4(const uint8_t *p, uint32_t len, uint64_t time, std::vector<Capture> &out)
+{
+  if (len < 20 || (p[0] >> 4) != 4)
+  {
+    return;
+  }
+  uint32_t ihl = (p[0] & 0x0F) * 4;
+  if (ihl < 20 || len < ihl || (Be16(p + 6) & 0x1FFF) != 0)
+  {
+    return; // bad header, or not the first fragment
+  }
+  Capture capture;
+  capture.time = time;
+  capture.src = Be32(p + 12);
+  capture.dst = Be32(p + 16);
+  capture.id = Be16(p + 4);
+  capture.proto = p[9];
+  capture.sport = 0;
+  capture.dport = 0;
+  uint32_t total = Be16(p + 2);
+  capture.bytes = total > ihl ? total - ihl : 0;
+  const uint8_t *l4 = p + ihl;
+  uint32_t available = len - ihl;
+  if ((capture.proto == 17 || capture.proto == 6) && available >= 4)
+  {
+    capture.sport = Be16(l4);
+    capture.dport = Be16(l4 + 2);
+  }
+  if (capture.proto == 17 && available >= 6)
+  {
+    uint32_t udp = Be16(l4 + 4);
+    capture.bytes = udp > 8 ? udp - 8 : 0;
+  }
+  else if (capture.proto == 6 && available >= 13)
+  {
+    uint32_t header = (l4[12] >> 4) * 4;
+    capture.bytes = capture.bytes > header ? capture.bytes - header : 0;
+  }
+  out.push_back(capture);
+}
+
+static void ParseLlc(const uint8_t *p, uint32_t len, uint64_t time, std::vector<Capture> &out)
+{
+  if (len >= 8 && p[0] == 0xAA && p[1] == 0xAA && p[2] == 0x03 && Be16(p + 6) == 0x0800)
+  {
+    ParseIpv4(p + 8, len - 8, time, out);
+  }
+}
+
+static void ParseEthernet(const uint8_t *p, uint32_t len, uint64_t time, std::vector<Capture> &out)
+{
+  if (len < 14)
+  {
+    return;
+  }
+  uint32_t offset = 14;
+  uint16_t type = Be16(p + 12);
+  while (type == 0x8100 && len >= offset + 4)
+  {
+    type = Be16(p + offset + 2);
+    offset += 4;
+  }
+  if (type == 0x0800)
+  {
+    ParseIpv4(p + offset, len - offset, time, out);
+  }
+  else if (type <= 1500)
+  {
+    ParseLlc(p + offset, len - offset, time, out); // CSMA with LLC encapsulation
+  }
+}
+
+static void Parse80211(const uint8_t *p, uint32_t len, uint64_t time, std::vector<Capture> &out)
+{
+  // ns-3 captures each MPDU of an A-MPDU with its delimiter in front: EOF
+  // bit and 14-bit length (little endian), CRC, signature 0x4E.  A data
+  // frame's duration is never that long, so its fourth byte is not 0x4E.
+  if (len >= 4 && p[3] == 0x4E)
+  {
+    uint32_t length = (p[0] | (uint32_t(p[1]) << 8)) & 0x3FFF;
+    if (length > len - 4)
+    {
+      return;
+    }
+    p += 4;
+    len = length; // without the padding
+  }
+  if (len < 24 || ((p[0] >> 2) & 3) != 2)
+  {
+    return; // not a data frame
+  }
+  uint8_t subtype = p[0] >> 4;
+  uint8_t flags = p[1];
+  if ((subtype & 0x4) != 0 || (flags & 0x40) != 0)
+  {
+    return; // no payload, or encrypted
+  }
+  uint32_t offset = (flags & 3) == 3 ? 30 : 24;
+  bool amsdu = false;
+  if ((subtype & 0x8) != 0)
+  {
+    if (len < offset + 2)
+    {
+      return;
+    }
+    amsdu = (p[offset] & 0x80) != 0;
+    offset += (flags & 0x80) != 0 ? 6 : 2; // QoS control, HT control
+  }
+  if (len < offset)
+  {
+    return;
+  }
+  if (!amsdu)
+  {
+    ParseLlc(p + offset, len - offset, time, out);
+    return;
+  }
+  // A-MSDU subframes: DA, SA, length, LLC payload, padded to 4 bytes.
+  while (offset + 14 <= len)
+  {
+    uint32_t size = Be16(p + offset + 12);
+    ParseLlc(p + offset + 14, std::min(size, len - offset - 14), time, out);
+    offset += (14 + size + 3) & ~3u;
+  }
+}
+
+static void ParseFrame(uint32_t linkType, const uint8_t *p, uint32_t len, uint64_t time,
+                       std::vector<Capture> &out)
+{
+  switch (linkType)
+  {
+  case LINKTYPE_ETHERNET:
+    ParseEthernet(p, len, time, out);
+    break;
+  case LINKTYPE_PPP:
+    // ns-3 writes only the protocol field, others address and control too
+    if (len >= 4 && p[0] == 0xFF && p[1] == 0x03)
+    {
+      p += 2;
+      len -= 2;
+    }
+    if (len >= 2 && Be16(p) == 0x0021)
+    {
+      ParseIpv4(p + 2, len - 2, time, out);
+    }
+    break;
+  case LINKTYPE_IEEE802_11:
+    Parse80211(p, len, time, out);
+    break;
+  case LINKTYPE_RADIOTAP:
+    if (len >= 4 && (p[2] | (uint32_t(p[3]) << 8)) <= len)
+    {
+      uint32_t header = p[2] | (uint32_t(p[3]) << 8); // little endian
+      Parse80211(p + header, len - header, time, out);
+    }
+    break;
+  case LINKTYPE_RAW:
+  case LINKTYPE_IPV4:
+    ParseIpv4(p, len, time, out);
+    break;
+  default:
+    break;
+  }
+}
+
+// A capture file mapped read-only for the lifetime of the object.
+class MappedFile
+{
+public:
+  MappedFile(const std::string &path)
+    : m_data(0),
+      m_size(0)
+  {
+    int fd = open(path.c_str(), O_RDONLY);
+    NS_ABORT_MSG_IF(fd < 0, "Cannot open " << path << ": " << std::strerror(errno));
+    struct stat st;
+    NS_ABORT_MSG_IF(fstat(fd, &st) != 0, "Cannot stat " << path);
+    m_size = st.st_size;
+    if (m_size > 0)
+    {
+      void *data = mmap(0, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      NS_ABORT_MSG_IF(data == MAP_FAILED, "Cannot map " << path << ": " << std::strerror(errno));
+      madvise(data, m_size, MADV_SEQUENTIAL | MADV_WILLNEED);
+      m_data = static_cast<const uint8_t *>(data);
+    }
+    close(fd);
+  }
+
+  ~MappedFile()
+  {
+    if (m_data != 0)
+    {
+      munmap(const_cast<uint8_t *>(m_data), m_size);
+    }
+  }
+
+  const uint8_t *Data() const
+  {
+    return m_data;
+  }
+
+  size_t Size() const
+  {
+    return m_size;
+  }
+
+private:
+  MappedFile(const MappedFile &);
+  MappedFile &operator=(const MappedFile &);
+
+  const uint8_t *m_data;
+  size_t m_size;
+};
+
+// Classic pcap: one device per file.
+static void ParsePcap(const std::string &path, const uint8_t *data, size_t size, std::vector<Device> &devices)
+{
+  uint32_t magic = Get32(data, false);
+  bool swapped = magic == 0xD4C3B2A1 || magic == 0x4D3CB2A1;
+  bool nanoseconds = magic == 0xA1B23C4D || magic == 0x4D3CB2A1;
+  NS_ABORT_MSG_IF(size < 24, path << " is truncated");
+  uint32_t linkType = Get32(data + 20, swapped) & 0x0FFFFFFF;
+  devices.push_back(Device());
+  Device &device = devices.back();
+  device.name = path;
+  device.captures.reserve(size / 128);
+  for (size_t pos = 24; pos + 16 <= size;)
+  {
+    uint64_t seconds = Get32(data + pos, swapped);
+    uint64_t fraction = Get32(data + pos + 4, swapped);
+    uint32_t captured = Get32(data + pos + 8, swapped);
+    if (pos + 16 + captured > size)
+    {
+      break; // cut short, e.g. the run was killed
+    }
+    uint64_t time = seconds * 1000000000 + (nanoseconds ? fraction : fraction * 1000);
+    ParseFrame(linkType, data + pos + 16, captured, time, device.captures);
+    pos += 16 + captured;
+  }
+}
+
+// PCAP-NG: one device per interface description block.
+static void ParsePcapNg(const std::string &path, const uint8_t *data, size_t size, std::vector<Device> &devices)
+{
+  struct Interface
+  {
+    uint32_t linkType;
+    size_t device;
+    uint64_t multiplier; // ticks to ns, or
+    uint64_t divisor;    // ns per tick below 1
+    double binary;       // ns per tick for a power-of-two resolution
+  };
+  std::vector<Interface> interfaces;
+  bool swapped = false;
+  for (size_t pos = 0; pos + 12 <= size;)
+  {
+    uint32_t type = Get32(data + pos, false);
+    if (type == 0x0A0D0D0A)
+    {
+      swapped = Get32(data + pos + 8, false) == 0x4D3C2B1A;
+      interfaces.clear(); // interface numbers start over in every section
+    }
+    uint32_t length = Get32(data + pos + 4, swapped);
+    if (length < 12 || pos + length > size)
+    {
+      break;
+    }
+    const uint8_t *block = data + pos;
+    if (type == 1 && length >= 20)
+    {
+      Interface interface;
+      interface.linkType = Get16(block + 8, swapped);
+      interface.device = devices.size();
+      interface.multiplier = 1000; // default resolution: microseconds
+      interface.divisor = 1;
+      interface.binary = 0;
+      std::ostringstream name;
+      name << path << "#" << interfaces.size();
+      for (uint32_t opt = 16; opt + 4 <= length - 4;)
+      {
+        uint16_t code = Get16(block + opt, swapped);
+        uint16_t size = Get16(block + opt + 2, swapped);
+        if (code == 0 || opt + 4 + size > length - 4)
+        {
+          break;
+        }
+        if (code == 2)
+        {
+          name.str("");
+          name << path << "#" << std::string(reinterpret_cast<const char *>(block + opt + 4), size).c_str();
+        }
+        else if (code == 9 && size >= 1)
+        {
+          uint8_t resolution = block[opt + 4];
+          if (resolution & 0x80)
+          {
+            interface.binary = 1e9 / std::pow(2.0, resolution & 0x7F);
+          }
+          else
+          {
+            interface.multiplier = 1;
+            for (int r = resolution; r < 9; r++)
+            {
+              interface.multiplier *= 10;
+            }
+            for (int r = 9; r < resolution; r++)
+            {
+              interface.divisor *= 10;
+            }
+          }
+        }
+        opt += 4 + ((size + 3) & ~3u);
+      }
+      interfaces.push_back(interface);
+      devices.push_back(Device());
+      devices.back().name = name.str();
+    }
+    else if (type == 6 && length >= 32)
+    {
+      uint32_t index = Get32(block + 8, swapped);
+      NS_ABORT_MSG_IF(index >= interfaces.size(), path << " has a packet of an undeclared interface");
+      const Interface &interface = interfaces[index];
+      uint64_t ticks = (uint64_t(Get32(block + 12, swapped)) << 32) | Get32(block + 16, swapped);
+      uint32_t captured = std::min(Get32(block + 20, swapped), length - 32);
+      uint64_t time = interface.binary > 0 ? uint64_t(ticks * interface.binary)
+                                           : ticks * interface.multiplier / interface.divisor;
+      ParseFrame(interface.linkType, block + 28, captured, time, devices[interface.device].captures);
+    }
+    pos += length;
+  }
+}
+
+static void ParseFile(const std::string &path, std::vector<Device> &devices)
+{
+  NS_ABORT_MSG_IF(EndsWith(path, ".gz") || EndsWith(path, ".zst"),
+                  path << " is compressed; decompress it first, captures are read in place");
+  MappedFile file(path);
+  NS_ABORT_MSG_IF(file.Size() < 4, path << " is not a capture file");
+  uint32_t magic = Get32(file.Data(), false);
+  if (magic == 0x0A0D0D0A)
+  {
+    ParsePcapNg(path, file.Data(), file.Size(), devices);
+  }
+  else if (magic == 0xA1B2C3D4 || magic == 0xA1B23C4D || magic == 0xD4C3B2A1 || magic == 0x4D3CB2A1)
+  {
+    ParsePcap(path, file.Data(), file.Size(), devices);
+  }
+  else
+  {
+    NS_FATAL_ERROR(path << " is neither pcap nor PCAP-NG");
+  }
+  // Devices write in simulation order, but PCAP-NG from several writers
+  // need not be.
+  for (size_t i = 0; i < devices.size(); i++)
+  {
+    std::vector<Capture> &captures = devices[i].captures;
+    for (size_t j = 1; j < captures.size(); j++)
+    {
+      if (captures[j].time < captures[j - 1].time)
+      {
+        std::stable_sort(captures.begin(), captures.end(),
+                         [](const Capture &a, const Capture &b) { return a.time < b.time; });
+        break;
+      }
+    }
+  }
+}
+
+static inline uint64_t Mix(uint64_t x)
+{
+  x ^= x >> 33;
+  x *= 0xFF51AFD7ED558CCDull;
+  x ^= x >> 33;
+  x *= 0xC4CEB9FE1A85EC53ull;
+  return x ^ (x >> 33);
+}
+
+// Walks the sightings of one shard, which are in time order, and calls
+// fn(packet index, sighting, new packet?) for each.
+template <typename F>
+static void ForEachSighting(const std::vector<Sighting> &sightings, uint64_t maxDelay, F fn)
+{
+  std::unordered_map<uint64_t, std::pair<uint32_t, uint64_t> > current; // packet index, last seen
+  current.reserve(sightings.size() / 4 + 16);
+  uint32_t packets = 0;
+  for (size_t i = 0; i < sightings.size(); i++)
+  {
+    const Sighting &s = sightings[i];
+    uint64_t key = (uint64_t(s.flow) << 16) | s.id;
+    std::unordered_map<uint64_t, std::pair<uint32_t, uint64_t> >::iterator it = current.find(key);
+    if (it == current.end() || s.time - it->second.second > maxDelay)
+    {
+      current[key] = std::make_pair(packets, s.time);
+      fn(packets++, s, true);
+    }
+    else
+    {
+      it->second.second = s.time;
+      fn(it->second.first, s, false);
+    }
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  std::string input = "";
+  std::string output = "flows.csv";
+  double maxDelay = 1.0;
+  uint32_t jobs = 0;
+
+  CommandLine cmd(__FILE__);
+  cmd.AddValue("input", "Capture files, directories or pcap prefixes (e.g. IITGoa_Network), comma separated", input);
+  cmd.AddValue("output", "Per-flow summary CSV", output);
+  cmd.AddValue("maxDelay", "Longest time a packet spends in the network, in seconds", maxDelay);
+  cmd.AddValue("jobs", "Threads (0: one per available core)", jobs);
+  cmd.Parse(argc, argv);
+
+  NS_ABORT_MSG_IF(input.empty(), "--input is required");
+  NS_ABORT_MSG_UNLESS(maxDelay > 0, "--maxDelay must be positive");
+  if (jobs == 0)
+  {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+    jobs = std::max(1, CPU_COUNT(&allowed));
+  }
+  uint64_t window = uint64_t(maxDelay * 1e9);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  // Parse every file on its own thread.
+  std::vector<std::string> files = FindInputs(input);
+  std::vector<std::vector<Device> > parsed(files.size());
+  std::vector<uint64_t> fileBytes(files.size(), 0);
+  ParallelFor(files.size(), jobs, [&](size_t i) {
+    struct stat st;
+    if (stat(files[i].c_str(), &st) == 0)
+    {
+      fileBytes[i] = st.st_size;
+    }
+    ParseFile(files[i], parsed[i]);
+  });
+  std::vector<Device> devices;
+  uint64_t totalBytes = 0;
+  uint64_t totalCaptures = 0;
+  for (size_t i = 0; i < files.size(); i++)
+  {
+    totalBytes += fileBytes[i];
+    for (size_t d = 0; d < parsed[i].size(); d++)
+    {
+      totalCaptures += parsed[i][d].captures.size();
+      devices.push_back(Device());
+      devices.back().name = parsed[i][d].name;
+      devices.back().captures.swap(parsed[i][d].captures);
+    }
+  }
+  parsed.clear();
+
+  // k-way merge by time (ties by device, so the result is reproducible),
+  // numbering flows in order of appearance and dealing sightings to shards.
+  std::vector<FlowKey> flows;
+  std::unordered_map<FlowKey, uint32_t, FlowKeyHash> flowIndex;
+  std::vector<std::vector<Sighting> > shards(jobs);
+  for (uint32_t s = 0; s < jobs; s++)
+  {
+    shards[s].reserve(totalCaptures / jobs + 16);
+  }
+  typedef std::pair<uint64_t, uint32_t> HeapItem; // time, device
+  std::vector<HeapItem> heap;
+  std::vector<size_t> cursor(devices.size(), 0);
+  for (uint32_t d = 0; d < devices.size(); d++)
+  {
+    if (!devices[d].captures.empty())
+    {
+      heap.push_back(HeapItem(devices[d].captures[0].time, d));
+    }
+  }
+  std::greater<HeapItem> later;
+  std::make_heap(heap.begin(), heap.end(), later);
+  uint64_t end = 0;
+  while (!heap.empty())
+  {
+    std::pop_heap(heap.begin(), heap.end(), later);
+    uint32_t d = heap.back().second;
+    const Capture &c = devices[d].captures[cursor[d]++];
+    FlowKey key = {c.src, c.dst, c.sport, c.dport, c.proto};
+    std::pair<std::unordered_map<FlowKey, uint32_t, FlowKeyHash>::iterator, bool> inserted =
+        flowIndex.insert(std::make_pair(key, uint32_t(flows.size())));
+    if (inserted.second)
+    {
+      flows.push_back(key);
+    }
+    Sighting s = {c.time, inserted.first->second, d, c.bytes, c.id};
+    shards[Mix((uint64_t(s.flow) << 16) | s.id) % jobs].push_back(s);
+    end = c.time;
+    if (cursor[d] < devices[d].captures.size())
+    {
+      heap.back().first = devices[d].captures[cursor[d]].time;
+      std::push_heap(heap.begin(), heap.end(), later);
+    }
+    else
+    {
+      heap.pop_back();
+      std::vector<Capture>().swap(devices[d].captures);
+    }
+  }
+
+  // Which device owns which address: the one that sends most of the
+  // packets from it first.
+  std::vector<std::map<std::pair<uint32_t, uint32_t>, uint64_t> > votes(jobs);
+  ParallelFor(jobs, jobs, [&](size_t shard) {
+    ForEachSighting(shards[shard], window, [&](uint32_t, const Sighting &s, bool first) {
+      if (first)
+      {
+        votes[shard][std::make_pair(flows[s.flow].src, s.device)]++;
+      }
+    });
+  });
+  std::map<uint32_t, std::pair<uint64_t, uint32_t> > best;
+  std::map<std::pair<uint32_t, uint32_t>, uint64_t> total;
+  for (uint32_t s = 0; s < jobs; s++)
+  {
+    for (std::map<std::pair<uint32_t, uint32_t>, uint64_t>::const_iterator it = votes[s].begin();
+         it != votes[s].end(); it++)
+    {
+      total[it->first] += it->second;
+    }
+  }
+  for (std::map<std::pair<uint32_t, uint32_t>, uint64_t>::const_iterator it = total.begin(); it != total.end(); it++)
+  {
+    std::pair<uint64_t, uint32_t> &b = best[it->first.first];
+    if (it->second > b.first)
+    {
+      b = std::make_pair(it->second, it->first.second);
+    }
+  }
+  std::unordered_map<uint32_t, uint32_t> owner;
+  for (std::map<uint32_t, std::pair<uint64_t, uint32_t> >::const_iterator it = best.begin(); it != best.end(); it++)
+  {
+    owner[it->first] = it->second.second;
+  }
+
+  // Follow every packet from its first sighting to its destination.
+  std::vector<std::vector<TracedPacket> > packets(jobs);
+  ParallelFor(jobs, jobs, [&](size_t shard) {
+    std::vector<TracedPacket> &out = packets[shard];
+    ForEachSighting(shards[shard], window, [&](uint32_t index, const Sighting &s, bool first) {
+      if (first)
+      {
+        TracedPacket p = {s.flow, s.device, s.bytes, false, false, s.time, s.time, 0, 0};
+        out.push_back(p);
+      }
+      TracedPacket &p = out[index];
+      p.last = s.time;
+      std::unordered_map<uint32_t, uint32_t>::const_iterator o = owner.find(flows[s.flow].dst);
+      if (o != owner.end() && o->second == s.device)
+      {
+        p.atOwner = true;
+        p.arrival = s.time;
+      }
+      if (s.device != p.firstDevice)
+      {
+        p.elsewhere = true;
+        p.lastElsewhere = s.time;
+      }
+    });
+    std::vector<Sighting>().swap(shards[shard]);
+    for (size_t i = 0; i < out.size(); i++)
+    {
+      if (!out[i].atOwner && owner.find(flows[out[i].flow].dst) == owner.end() && out[i].elsewhere)
+      {
+        out[i].atOwner = true; // destination never sent: any other device counts
+        out[i].arrival = out[i].lastElsewhere;
+      }
+    }
+  });
+
+  // Group the packets by flow, in order of sending.
+  std::vector<size_t> offsets(flows.size() + 1, 0);
+  for (uint32_t s = 0; s < jobs; s++)
+  {
+    for (size_t i = 0; i < packets[s].size(); i++)
+    {
+      offsets[packets[s][i].flow + 1]++;
+    }
+  }
+  for (size_t f = 0; f < flows.size(); f++)
+  {
+    offsets[f + 1] += offsets[f];
+  }
+  std::vector<TracedPacket> byFlow(offsets.back());
+  std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+  for (uint32_t s = 0; s < jobs; s++)
+  {
+    for (size_t i = 0; i < packets[s].size(); i++)
+    {
+      byFlow[fill[packets[s][i].flow]++] = packets[s][i];
+    }
+    std::vector<TracedPacket>().swap(packets[s]);
+  }
+
+  std::vector<FlowStats> stats(flows.size());
+  ParallelFor(flows.size(), jobs, [&](size_t f) {
+    std::sort(byFlow.begin() + offsets[f], byFlow.begin() + offsets[f + 1],
+              [](const TracedPacket &a, const TracedPacket &b) { return a.sent < b.sent; });
+    FlowStats &st = stats[f];
+    for (size_t i = offsets[f]; i < offsets[f + 1]; i++)
+    {
+      const TracedPacket &p = byFlow[i];
+      st.firstSent = std::min(st.firstSent, p.sent);
+      if (!p.atOwner && p.sent + window > end)
+      {
+        st.inFlight++;
+        continue;
+      }
+      st.sent++;
+      if (p.atOwner)
+      {
+        uint64_t delay = p.arrival - p.sent;
+        st.delivered++;
+        st.bytes += p.bytes;
+        st.lastArrival = std::max(st.lastArrival, p.arrival);
+        st.delaySum += delay;
+        st.delayMin = std::min(st.delayMin, delay);
+        st.delayMax = std::max(st.delayMax, delay);
+      }
+    }
+  });
+
+  // Echo round trips, kept on the request flow.
+  ParallelFor(flows.size(), jobs, [&](size_t f) {
+    const FlowKey &key = flows[f];
+    FlowKey reverse = {key.dst, key.src, key.dport, key.sport, key.proto};
+    std::unordered_map<FlowKey, uint32_t, FlowKeyHash>::const_iterator r = flowIndex.find(reverse);
+    if (key.proto != 17 || r == flowIndex.end() || stats[f].firstSent > stats[r->second].firstSent ||
+        (stats[f].firstSent == stats[r->second].firstSent && f > r->second))
+    {
+      return;
+    }
+    std::vector<const TracedPacket *> requests;
+    for (size_t i = offsets[f]; i < offsets[f + 1]; i++)
+    {
+      if (byFlow[i].atOwner)
+      {
+        requests.push_back(&byFlow[i]);
+      }
+    }
+    std::stable_sort(requests.begin(), requests.end(),
+                     [](const TracedPacket *a, const TracedPacket *b) { return a->arrival < b->arrival; });
+    std::vector<const TracedPacket *> waiting;
+    size_t next = 0;
+    FlowStats &st = stats[f];
+    for (size_t i = offsets[r->second]; i < offsets[r->second + 1]; i++)
+    {
+      const TracedPacket &reply = byFlow[i];
+      while (next < requests.size() && requests[next]->arrival <= reply.sent)
+      {
+        waiting.push_back(requests[next++]);
+      }
+      if (waiting.empty())
+      {
+        continue;
+      }
+      const TracedPacket *request = waiting.back();
+      waiting.pop_back();
+      if (reply.atOwner)
+      {
+        uint64_t rtt = reply.arrival - request->sent;
+        st.rttSamples++;
+        st.rttSum += rtt;
+        st.rttMin = std::min(st.rttMin, rtt);
+        st.rttMax = std::max(st.rttMax, rtt);
+      }
+    }
+  });
+
+  std::ofstream out(output.c_str());
+  NS_ABORT_MSG_UNLESS(out.is_open(), "Cannot write " << output);
+  out << "src,sport,dst,dport,proto,sent,delivered,lost,loss,bytes,throughput_kbps,"
+      << "delay_mean_ms,delay_min_ms,delay_max_ms,rtt_samples,rtt_mean_ms,rtt_min_ms,rtt_max_ms\n";
+  out << std::setprecision(6);
+  uint64_t sent = 0;
+  uint64_t delivered = 0;
+  uint64_t rttSamples = 0;
+  double delaySum = 0;
+  double rttSum = 0;
+  for (size_t f = 0; f < flows.size(); f++)
+  {
+    const FlowStats &st = stats[f];
+    if (st.sent == 0)
+    {
+      continue;
+    }
+    sent += st.sent;
+    delivered += st.delivered;
+    delaySum += st.delaySum;
+    rttSamples += st.rttSamples;
+    rttSum += st.rttSum;
+    double duration = st.delivered ? (st.lastArrival - st.firstSent) / 1e9 : 0;
+    out << AddressString(flows[f].src) << "," << flows[f].sport << "," << AddressString(flows[f].dst) << ","
+        << flows[f].dport << "," << uint32_t(flows[f].proto) << "," << st.sent << "," << st.delivered << ","
+        << st.sent - st.delivered << "," << double(st.sent - st.delivered) / st.sent << "," << st.bytes << ","
+        << (duration > 0 ? st.bytes * 8 / duration / 1000 : 0.0) << ",";
+    if (st.delivered)
+    {
+      out << st.delaySum / st.delivered / 1e6 << "," << st.delayMin / 1e6 << "," << st.delayMax / 1e6 << ",";
+    }
+    else
+    {
+      out << ",,,";
+    }
+    out << st.rttSamples << ",";
+    if (st.rttSamples)
+    {
+      out << st.rttSum / st.rttSamples / 1e6 << "," << st.rttMin / 1e6 << "," << st.rttMax / 1e6 << "\n";
+    }
+    else
+    {
+      out << ",,\n";
+    }
+  }
+  out.close();
+
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << files.size() << " files, " << devices.size() << " devices, " << totalCaptures << " captures, "
+            << flows.size() << " flows in " << elapsed << " s (" << totalBytes / 1048576.0 / elapsed
+            << " MB/s, " << jobs << " threads)\n";
+  uint64_t inFlight = 0;
+  for (size_t f = 0; f < flows.size(); f++)
+  {
+    inFlight += stats[f].inFlight;
+  }
+  std::cout << "Delivered " << delivered << " of " << sent << " packets (" << inFlight << " in flight at the end)";
+  if (delivered)
+  {
+    std::cout << ", mean delay " << delaySum / delivered / 1e6 << " ms";
+  }
+  if (rttSamples)
+  {
+    std::cout << ", mean RTT " << rttSum / rttSamples / 1e6 << " ms over " << rttSamples << " echoes";
+  }
+  std::cout << "\nSummary written to " << output << std::endl;
+  return 0;
+}
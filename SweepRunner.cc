@@ -0,0 +1,304 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/core-module.h"
+#include "process-launcher.h"
+
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+// Parameter sweep driver for HomeNetwork and IITGoaNetwork.
+//
+// Expands a grid of command line values times a range of RNG runs and runs
+// every combination as its own process, one process pinned to each core.
+// Each run gets its own directory, so pcap and NetAnim files of parallel
+// runs do not collide, and writes summary.csv there (--results of the
+// scenario programs).  Runs that already have a summary are skipped, and
+// all summaries are merged into one CSV at the end.
+//
+// Run from "./waf shell" so the ns-3 libraries are found, e.g.
+//
+//   build/scratch/SweepRunner --program=build/scratch/IITGoaNetwork
+//       --grid="nWifi=2,8,32;nCsma=3,12" --runs=10 --out=sweep
+//       --args="--tracing=false --topology=$PWD/scratch/IITGoaNetwork.topo"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("SweepRunner");
+
+struct SweepJob
+{
+  std::vector<std::pair<std::string, std::string> > params;
+  uint32_t run;
+  std::string dir;
+};
+
+static bool Exists(const std::string &path)
+{
+  struct stat st;
+  return stat(path.c_str(), &st) == 0;
+}
+
+// Cartesian product of the grid, last parameter varying fastest.
+static std::vector<SweepJob> Expand(const std::string &grid, uint32_t firstRun, uint32_t runs, const std::string &out)
+{
+  std::vector<std::pair<std::string, std::vector<std::string> > > axes;
+  std::vector<std::string> terms = ProcessLauncher::Split(grid, ';');
+  for (size_t i = 0; i < terms.size(); i++)
+  {
+    size_t eq = terms[i].find('=');
+    NS_ABORT_MSG_IF(eq == std::string::npos, "Grid term " << terms[i] << " is not name=v1,v2,...");
+    axes.push_back(std::make_pair(terms[i].substr(0, eq), ProcessLauncher::Split(terms[i].substr(eq + 1), ',')));
+  }
+
+  std::vector<SweepJob> jobs;
+  std::vector<size_t> index(axes.size(), 0);
+  while (true)
+  {
+    SweepJob config;
+    std::string key;
+    for (size_t a = 0; a < axes.size(); a++)
+    {
+      config.params.push_back(std::make_pair(axes[a].first, axes[a].second[index[a]]));
+      key += (a ? "_" : "") + axes[a].first + "-" + axes[a].second[index[a]];
+    }
+    if (key.empty())
+    {
+      key = "default";
+    }
+    for (uint32_t r = firstRun; r < firstRun + runs; r++)
+    {
+      SweepJob job = config;
+      job.run = r;
+      job.dir = out + "/" + key + "/run-" + std::to_string(r);
+      jobs.push_back(job);
+    }
+
+    size_t a = axes.size();
+    while (a > 0 && ++index[a - 1] == axes[a - 1].second.size())
+    {
+      index[--a] = 0;
+    }
+    if (a == 0)
+    {
+      return jobs;
+    }
+  }
+}
+
+static pid_t Launch(const SweepJob &job, const std::string &program, uint32_t seed,
+                    const std::vector<std::string> &extra, int cpu)
+{
+  std::vector<std::string> args;
+  args.push_back(program);
+  for (size_t i = 0; i < job.params.size(); i++)
+  {
+    args.push_back("--" + job.params[i].first + "=" + job.params[i].second);
+  }
+  args.push_back("--RngSeed=" + std::to_string(seed));
+  args.push_back("--RngRun=" + std::to_string(job.run));
+  args.push_back("--results=summary.csv");
+  args.insert(args.end(), extra.begin(), extra.end());
+
+  return ProcessLauncher::Launch(program, args, job.dir, cpu);
+}
+
+// Merges every run's summary.csv into one table.  Grid parameters come
+// first; the remaining columns are the union of all summaries.
+static uint32_t Merge(const std::vector<SweepJob> &jobs, const std::string &path)
+{
+  std::vector<std::string> columns;
+  std::map<std::string, size_t> position;
+  std::vector<std::map<std::string, std::string> > rows;
+  std::vector<const SweepJob *> owners;
+
+  for (size_t i = 0; i < jobs.size(); i++)
+  {
+    std::ifstream in((jobs[i].dir + "/summary.csv").c_str());
+    std::string header;
+    std::string values;
+    if (!std::getline(in, header) || !std::getline(in, values))
+    {
+      continue;
+    }
+    std::vector<std::string> names = ProcessLauncher::Split(header, ',');
+    std::vector<std::string> cells = ProcessLauncher::Split(values, ',');
+    std::map<std::string, std::string> row;
+    for (size_t c = 0; c < names.size() && c < cells.size(); c++)
+    {
+      row[names[c]] = cells[c];
+      if (!position.count(names[c]))
+      {
+        position[names[c]] = columns.size();
+        columns.push_back(names[c]);
+      }
+    }
+    rows.push_back(row);
+    owners.push_back(&jobs[i]);
+  }
+
+  std::ofstream out(path.c_str());
+  NS_ABORT_MSG_UNLESS(out.is_open(), "Cannot write " << path);
+  const SweepJob *first = jobs.empty() ? 0 : &jobs[0];
+  std::map<std::string, bool> isParam;
+  for (size_t p = 0; first && p < first->params.size(); p++)
+  {
+    out << first->params[p].first << ",";
+    isParam[first->params[p].first] = true;
+  }
+  out << "dir";
+  for (size_t c = 0; c < columns.size(); c++)
+  {
+    if (!isParam.count(columns[c]))
+    {
+      out << "," << columns[c];
+    }
+  }
+  out << "\n";
+  for (size_t r = 0; r < rows.size(); r++)
+  {
+    for (size_t p = 0; p < owners[r]->params.size(); p++)
+    {
+      out << owners[r]->params[p].second << ",";
+    }
+    out << owners[r]->dir;
+    for (size_t c = 0; c < columns.size(); c++)
+    {
+      if (!isParam.count(columns[c]))
+      {
+        out << "," << rows[r][columns[c]];
+      }
+    }
+    out << "\n";
+  }
+  return rows.size();
+}
+
+int main(int argc, char *argv[])
+{
+  std::string program = "";
+  std::string grid = "";
+  std::string args = "";
+  std::string out = "sweep";
+  std::string results = "";
+  uint32_t runs = 1;
+  uint32_t firstRun = 1;
+  uint32_t seed = 1;
+  uint32_t jobs = 0;
+
+  CommandLine cmd(__FILE__);
+  cmd.AddValue("program", "Scenario binary to run (e.g. build/scratch/IITGoaNetwork)", program);
+  cmd.AddValue("grid", "Parameter grid, e.g. \"nWifi=2,4,8;nCsma=3,6\"", grid);
+  cmd.AddValue("runs", "Number of RNG runs per grid point", runs);
+  cmd.AddValue("firstRun", "First RngRun value", firstRun);
+  cmd.AddValue("seed", "RngSeed passed to every run", seed);
+  cmd.AddValue("jobs", "Concurrent runs (0: one per available core)", jobs);
+  cmd.AddValue("out", "Directory holding one sub-directory per run", out);
+  cmd.AddValue("args", "Extra arguments passed to every run", args);
+  cmd.AddValue("results", "Merged results file (default <out>/results.csv)", results);
+  cmd.Parse(argc, argv);
+
+  NS_ABORT_MSG_IF(program.empty(), "--program is required");
+  char resolved[PATH_MAX];
+  NS_ABORT_MSG_UNLESS(realpath(program.c_str(), resolved), "Cannot find " << program);
+  program = resolved;
+  ProcessLauncher::MakeDirs(out);
+  NS_ABORT_MSG_UNLESS(realpath(out.c_str(), resolved), "Cannot resolve " << out);
+  out = resolved;
+  if (results.empty())
+  {
+    results = out + "/results.csv";
+  }
+
+  // One slot per core this process may use.
+  std::vector<int> cpus = ProcessLauncher::GetCpus();
+  if (jobs == 0 || jobs > cpus.size())
+  {
+    jobs = cpus.size();
+  }
+
+  std::vector<SweepJob> all = Expand(grid, firstRun, runs, out);
+  std::vector<const SweepJob *> todo;
+  for (size_t i = 0; i < all.size(); i++)
+  {
+    if (!Exists(all[i].dir + "/summary.csv"))
+    {
+      ProcessLauncher::MakeDirs(all[i].dir);
+      todo.push_back(&all[i]);
+    }
+  }
+  std::cout << all.size() << " runs, " << all.size() - todo.size() << " already done, "
+            << jobs << " in parallel" << std::endl;
+
+  std::vector<std::string> extra = ProcessLauncher::Split(args, ' ');
+  std::vector<pid_t> slots(jobs, 0);
+  std::map<pid_t, const SweepJob *> running;
+  size_t next = 0;
+  uint32_t failed = 0;
+  while (next < todo.size() || !running.empty())
+  {
+    for (size_t s = 0; s < slots.size() && next < todo.size(); s++)
+    {
+      if (slots[s] == 0)
+      {
+        slots[s] = Launch(*todo[next], program, seed, extra, cpus[s]);
+        running[slots[s]] = todo[next++];
+      }
+    }
+
+    int status = 0;
+    pid_t pid = waitpid(-1, &status, 0);
+    if (pid < 0)
+    {
+      NS_ABORT_MSG_UNLESS(errno == EINTR, "waitpid failed: " << std::strerror(errno));
+      continue;
+    }
+    const SweepJob *job = running[pid];
+    running.erase(pid);
+    for (size_t s = 0; s < slots.size(); s++)
+    {
+      if (slots[s] == pid)
+      {
+        slots[s] = 0;
+      }
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+      failed++;
+      std::cerr << "Run failed (see " << job->dir << "/output.log)" << std::endl;
+    }
+  }
+
+  uint32_t merged = Merge(all, results);
+  std::cout << merged << " runs merged into " << results;
+  if (failed)
+  {
+    std::cout << ", " << failed << " failed";
+  }
+  std::cout << std::endl;
+  return failed ? 1 : 0;
+}
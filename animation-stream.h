@@ -0,0 +1,484 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef ANIMATION_STREAM_H
+#define ANIMATION_STREAM_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/point-to-point-net-device.h"
+#include "ns3/point-to-point-channel.h"
+#include "ns3/csma-net-device.h"
+#include "ns3/wifi-net-device.h"
+#include "ns3/wifi-phy.h"
+#include "compressed-stream.h"
+
+#include <cmath>
+#include <deque>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace ns3 {
+
+// NetAnim trace writer for long runs.  Unlike AnimationInterface it keeps
+// no per-packet history: each element is written as soon as it is known,
+// through a CompressedOutputStream (name the file *.xml.gz or *.xml.zst
+// and decompress it before opening it in NetAnim).
+//
+// Controls:
+//  - SetMobilityPollInterval: how often moved nodes are written;
+//  - SetWindow: only record between two simulation times;
+//  - SetPacketSampling: keep one packet in N, or, per flow, every packet
+//    of one IPv4 flow in N (other frames, e.g. ARP and beacons, are not
+//    recorded in that mode);
+//  - EnablePacketMetadata: add Packet::Print output to each packet.
+//
+// Packets are matched from transmit to receive by uid; a transmission
+// nobody receives within one second is forgotten.
+class AnimationStream
+{
+public:
+  AnimationStream()
+    : m_open(false),
+      m_poll(Seconds(0.25)),
+      m_start(Seconds(0)),
+      m_stop(Seconds(0)),
+      m_sample(1),
+      m_perFlow(false),
+      m_metadata(false),
+      m_counter(0),
+      m_resources(0),
+      m_packets(0)
+  {
+  }
+
+  ~AnimationStream()
+  {
+    Close();
+  }
+
+  void SetMobilityPollInterval(Time interval)
+  {
+    m_poll = interval;
+  }
+
+  // A stop time that is not after the start records until the end.
+  void SetWindow(Time start, Time stop)
+  {
+    m_start = start;
+    m_stop = stop;
+  }
+
+  void SetPacketSampling(uint32_t oneIn, bool perFlow)
+  {
+    m_sample = std::max(oneIn, 1u);
+    m_perFlow = perFlow;
+  }
+
+  void EnablePacketMetadata(bool enable)
+  {
+    m_metadata = enable;
+    if (enable)
+    {
+      Packet::EnablePrinting();
+    }
+  }
+
+  // Writes every node and point-to-point link, hooks every device and
+  // starts polling positions.  Call after the topology is built.
+  void Open(const std::string &path)
+  {
+    NS_ABORT_MSG_IF(m_open, "AnimationStream is already open");
+    m_stream.Open(path);
+    m_open = true;
+    Write("<anim ver=\"netanim-3.108\" filetype=\"animation\" >\n");
+    for (NodeList::Iterator it = NodeList::Begin(); it != NodeList::End(); it++)
+    {
+      Ptr<Node> node = *it;
+      Vector position = GetPosition(node);
+      m_positions.push_back(position);
+      std::ostringstream line;
+      line << "<node id=\"" << node->GetId() << "\" sysId=\"" << node->GetSystemId() << "\" locX=\""
+           << position.x << "\" locY=\"" << position.y << "\" />\n";
+      Write(line.str());
+    }
+    for (NodeList::Iterator it = NodeList::Begin(); it != NodeList::End(); it++)
+    {
+      for (uint32_t d = 0; d < (*it)->GetNDevices(); d++)
+      {
+        Hook((*it)->GetDevice(d));
+      }
+    }
+    Simulator::Schedule(m_start > Simulator::Now() ? m_start - Simulator::Now() : Seconds(0),
+                        &AnimationStream::Poll, this);
+  }
+
+  void Close()
+  {
+    if (m_open)
+    {
+      Write("</anim>\n");
+      m_stream.Close();
+      m_open = false;
+    }
+  }
+
+  // Same calls as AnimationInterface, written at the current time.
+  uint32_t AddResource(const std::string &path)
+  {
+    std::ostringstream line;
+    line << "<res rid=\"" << m_resources << "\" p=\"" << path << "\" />\n";
+    Write(line.str());
+    return m_resources++;
+  }
+
+  void UpdateNodeDescription(uint32_t nodeId, const std::string &description)
+  {
+    std::ostringstream line;
+    line << "<nu p=\"d\" t=\"" << Now() << "\" id=\"" << nodeId << "\" descr=\"" << Escape(description) << "\" />\n";
+    Write(line.str());
+  }
+
+  void UpdateNodeImage(uint32_t nodeId, uint32_t resourceId)
+  {
+    std::ostringstream line;
+    line << "<nu p=\"i\" t=\"" << Now() << "\" id=\"" << nodeId << "\" rid=\"" << resourceId << "\" />\n";
+    Write(line.str());
+  }
+
+  void UpdateNodeSize(uint32_t nodeId, double width, double height)
+  {
+    std::ostringstream line;
+    line << "<nu p=\"s\" t=\"" << Now() << "\" id=\"" << nodeId << "\" w=\"" << width << "\" h=\"" << height
+         << "\" />\n";
+    Write(line.str());
+  }
+
+  // Gives a node without mobility a fixed position.
+  void SetConstantPosition(Ptr<Node> node, double x, double y)
+  {
+    Ptr<MobilityModel> mobility = node->GetObject<MobilityModel>();
+    if (mobility == 0)
+    {
+      mobility = CreateObject<ConstantPositionMobilityModel>();
+      node->AggregateObject(mobility);
+    }
+    mobility->SetPosition(Vector(x, y, 0));
+    if (m_open)
+    {
+      WritePosition(node->GetId(), mobility->GetPosition());
+    }
+  }
+
+  uint64_t GetPacketsWritten() const
+  {
+    return m_packets;
+  }
+
+private:
+  struct PendingTx
+  {
+    uint32_t from;
+    double fbTx;
+    double lbTx;
+  };
+
+  static Vector GetPosition(Ptr<Node> node)
+  {
+    Ptr<MobilityModel> mobility = node->GetObject<MobilityModel>();
+    return mobility ? mobility->GetPosition() : Vector(0, 0, 0);
+  }
+
+  static double Now()
+  {
+    return Simulator::Now().GetSeconds();
+  }
+
+  static std::string Escape(const std::string &text)
+  {
+    std::string out;
+    for (size_t i = 0; i < text.size(); i++)
+    {
+      switch (text[i])
+      {
+      case '"':
+        out += "&quot;";
+        break;
+      case '&':
+        out += "&amp;";
+        break;
+      case '<':
+        out += "&lt;";
+        break;
+      case '>':
+        out += "&gt;";
+        break;
+      default:
+        out += text[i];
+      }
+    }
+    return out;
+  }
+
+  void Write(const std::string &text)
+  {
+    if (m_open)
+    {
+      m_stream.Write(text.data(), text.size());
+    }
+  }
+
+  bool InWindow() const
+  {
+    Time now = Simulator::Now();
+    return now >= m_start && (m_stop <= m_start || now <= m_stop);
+  }
+
+  void Hook(Ptr<NetDevice> device)
+  {
+    uint32_t node = device->GetNode()->GetId();
+    Ptr<Object> source = device;
+    if (Ptr<PointToPointNetDevice> p2p = DynamicCast<PointToPointNetDevice>(device))
+    {
+      WriteLink(p2p);
+      source->TraceConnectWithoutContext("PhyTxBegin", MakeBoundCallback(&AnimationStream::TxBegin, this, node, 9));
+    }
+    else if (DynamicCast<CsmaNetDevice>(device))
+    {
+      source->TraceConnectWithoutContext("PhyTxBegin", MakeBoundCallback(&AnimationStream::TxBegin, this, node, 1));
+    }
+    else if (Ptr<WifiNetDevice> wifi = DynamicCast<WifiNetDevice>(device))
+    {
+      source = wifi->GetPhy();
+      source->TraceConnectWithoutContext("PhyTxBegin",
+                                         MakeBoundCallback(&AnimationStream::WifiTxBegin, this, node, 105));
+    }
+    else
+    {
+      return;
+    }
+    source->TraceConnectWithoutContext("PhyTxEnd", MakeBoundCallback(&AnimationStream::TxEnd, this));
+    source->TraceConnectWithoutContext("PhyRxEnd", MakeBoundCallback(&AnimationStream::RxEnd, this, node));
+  }
+
+  void WriteLink(Ptr<PointToPointNetDevice> device)
+  {
+    Ptr<Channel> channel = device->GetChannel();
+    for (std::size_t i = 0; channel && i < channel->GetNDevices(); i++)
+    {
+      uint32_t peer = channel->GetDevice(i)->GetNode()->GetId();
+      if (peer > device->GetNode()->GetId())
+      {
+        std::ostringstream line;
+        line << "<link fromId=\"" << device->GetNode()->GetId() << "\" toId=\"" << peer
+             << "\" fd=\"\" td=\"\" ld=\"\" />\n";
+        Write(line.str());
+      }
+    }
+  }
+
+  static void TxBegin(AnimationStream *anim, uint32_t node, int linkType, Ptr<const Packet> packet)
+  {
+    anim->StartTx(node, linkType, packet);
+  }
+
+  static void WifiTxBegin(AnimationStream *anim, uint32_t node, int linkType, Ptr<const Packet> packet,
+                          double txPowerW)
+  {
+    anim->StartTx(node, linkType, packet);
+  }
+
+  static void TxEnd(AnimationStream *anim, Ptr<const Packet> packet)
+  {
+    std::unordered_map<uint64_t, PendingTx>::iterator it = anim->m_pending.find(packet->GetUid());
+    if (it != anim->m_pending.end())
+    {
+      it->second.lbTx = Now();
+    }
+  }
+
+  static void RxEnd(AnimationStream *anim, uint32_t node, Ptr<const Packet> packet)
+  {
+    anim->EndRx(node, packet);
+  }
+
+  void StartTx(uint32_t node, int linkType, Ptr<const Packet> packet)
+  {
+    if (!m_open || !InWindow() || !Sampled(linkType, packet))
+    {
+      return;
+    }
+    double now = Now();
+    while (!m_expiry.empty() && m_expiry.front().first < now - 1.0)
+    {
+      // The uid may have been sent again (next hop) since.
+      std::unordered_map<uint64_t, PendingTx>::iterator it = m_pending.find(m_expiry.front().second);
+      if (it != m_pending.end() && it->second.fbTx == m_expiry.front().first)
+      {
+        m_pending.erase(it);
+      }
+      m_expiry.pop_front();
+    }
+    PendingTx tx = {node, now, now};
+    m_pending[packet->GetUid()] = tx;
+    m_expiry.push_back(std::make_pair(now, packet->GetUid()));
+  }
+
+  void EndRx(uint32_t node, Ptr<const Packet> packet)
+  {
+    std::unordered_map<uint64_t, PendingTx>::iterator it = m_pending.find(packet->GetUid());
+    if (!m_open || it == m_pending.end() || it->second.from == node)
+    {
+      return;
+    }
+    const PendingTx &tx = it->second;
+    double lbRx = Now();
+    std::ostringstream line;
+    line.precision(9);
+    line << "<p fId=\"" << tx.from << "\" fbTx=\"" << tx.fbTx << "\" lbTx=\"" << tx.lbTx << "\"";
+    if (m_metadata)
+    {
+      std::ostringstream meta;
+      packet->Print(meta);
+      line << " meta-info=\"" << Escape(meta.str()) << "\"";
+    }
+    line << " tId=\"" << node << "\" fbRx=\"" << lbRx - (tx.lbTx - tx.fbTx) << "\" lbRx=\"" << lbRx << "\" />\n";
+    Write(line.str());
+    m_packets++;
+  }
+
+  bool Sampled(int linkType, Ptr<const Packet> packet)
+  {
+    if (!m_perFlow)
+    {
+      return m_counter++ % m_sample == 0;
+    }
+    uint32_t hash;
+    return FlowHash(linkType, packet, hash) && hash % m_sample == 0;
+  }
+
+  // FNV-1a over protocol, addresses and ports of an IPv4 frame.
+  static bool FlowHash(int linkType, Ptr<const Packet> packet, uint32_t &hash)
+  {
+    uint8_t buffer[96];
+    uint32_t size = packet->CopyData(buffer, sizeof(buffer));
+    uint32_t offset;
+    if (linkType == 9)
+    {
+      if (size < 2 || buffer[0] != 0x00 || buffer[1] != 0x21)
+      {
+        return false;
+      }
+      offset = 2;
+    }
+    else if (linkType == 1)
+    {
+      if (size < 14 || buffer[12] != 0x08 || buffer[13] != 0x00)
+      {
+        return false;
+      }
+      offset = 14;
+    }
+    else
+    {
+      // Data frames only; QoS data has a 2 byte QoS control field, then
+      // comes the LLC/SNAP header with the ethertype.
+      if (size < 2 || (buffer[0] & 0x0c) != 0x08)
+      {
+        return false;
+      }
+      offset = (buffer[0] & 0x80) ? 26 : 24;
+      if (size < offset + 8 || buffer[offset + 6] != 0x08 || buffer[offset + 7] != 0x00)
+      {
+        return false;
+      }
+      offset += 8;
+    }
+    if (size < offset + 20)
+    {
+      return false;
+    }
+    const uint8_t *ip = buffer + offset;
+    uint32_t headerLength = (ip[0] & 0x0f) * 4;
+    uint32_t keyLength = 9;
+    uint8_t key[13];
+    key[0] = ip[9];
+    std::copy(ip + 12, ip + 20, key + 1);
+    if ((ip[9] == 6 || ip[9] == 17) && size >= offset + headerLength + 4)
+    {
+      std::copy(ip + headerLength, ip + headerLength + 4, key + 9);
+      keyLength = 13;
+    }
+    hash = 2166136261u;
+    for (uint32_t i = 0; i < keyLength; i++)
+    {
+      hash = (hash ^ key[i]) * 16777619u;
+    }
+    return true;
+  }
+
+  void WritePosition(uint32_t nodeId, const Vector &position)
+  {
+    std::ostringstream line;
+    line << "<nu p=\"p\" t=\"" << Now() << "\" id=\"" << nodeId << "\" x=\"" << position.x << "\" y=\""
+         << position.y << "\" />\n";
+    Write(line.str());
+  }
+
+  // Writes the nodes that moved since the last poll.
+  void Poll()
+  {
+    if (!m_open || !InWindow())
+    {
+      return;
+    }
+    for (uint32_t i = 0; i < NodeList::GetNNodes() && i < m_positions.size(); i++)
+    {
+      Vector position = GetPosition(NodeList::GetNode(i));
+      if (std::fabs(position.x - m_positions[i].x) > 1e-3 || std::fabs(position.y - m_positions[i].y) > 1e-3)
+      {
+        m_positions[i] = position;
+        WritePosition(i, position);
+      }
+    }
+    Simulator::Schedule(m_poll, &AnimationStream::Poll, this);
+  }
+
+  AnimationStream(const AnimationStream &);
+  AnimationStream &operator=(const AnimationStream &);
+
+  CompressedOutputStream m_stream;
+  bool m_open;
+  Time m_poll;
+  Time m_start;
+  Time m_stop;
+  uint32_t m_sample;
+  bool m_perFlow;
+  bool m_metadata;
+  uint64_t m_counter;
+  uint32_t m_resources;
+  uint64_t m_packets;
+  std::vector<Vector> m_positions;
+  std::unordered_map<uint64_t, PendingTx> m_pending;
+  std::deque<std::pair<double, uint64_t> > m_expiry;
+};
+
+} // namespace ns3
+
+#endif /* ANIMATION_STREAM_H */
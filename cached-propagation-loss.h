@@ -0,0 +1,260 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef CACHED_PROPAGATION_LOSS_H
+#define CACHED_PROPAGATION_LOSS_H
+
+#include "ns3/core-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/propagation-module.h"
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define RANGE_FILTER_AVX2 1
+#else
+#define RANGE_FILTER_AVX2 0
+#endif
+
+namespace ns3 {
+
+// Picks the receivers within range of a transmitter out of positions
+// kept as separate x, y and z arrays, four at a time with AVX2 when the
+// CPU has it.  The test is on squared distances, so it needs neither a
+// square root nor a logarithm; the exact loss is only computed for the
+// receivers it keeps.
+class RangeFilter
+{
+public:
+  // Appends to selected the i < n with |p[i] - origin| <= range, in order.
+  static void Select(const Vector &origin, double range, const double *x, const double *y,
+                     const double *z, uint32_t n, std::vector<uint32_t> &selected)
+  {
+#if RANGE_FILTER_AVX2
+    if (HasAvx2())
+    {
+      SelectAvx2(origin, range * range, x, y, z, n, selected);
+      return;
+    }
+#endif
+    SelectScalar(origin, range * range, x, y, z, 0, n, selected);
+  }
+
+  static bool HasAvx2(void)
+  {
+#if RANGE_FILTER_AVX2
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+#else
+    return false;
+#endif
+  }
+
+private:
+  static void SelectScalar(const Vector &origin, double range2, const double *x, const double *y,
+                           const double *z, uint32_t first, uint32_t n, std::vector<uint32_t> &selected)
+  {
+    for (uint32_t i = first; i < n; i++)
+    {
+      double dx = x[i] - origin.x;
+      double dy = y[i] - origin.y;
+      double dz = z[i] - origin.z;
+      if (dx * dx + dy * dy + dz * dz <= range2)
+      {
+        selected.push_back(i);
+      }
+    }
+  }
+
+#if RANGE_FILTER_AVX2
+  // Compiled for AVX2 whatever the build flags, and only called when
+  // HasAvx2().
+  __attribute__((target("avx2"))) static void SelectAvx2(const Vector &origin, double range2, const double *x,
+                                                         const double *y, const double *z, uint32_t n,
+                                                         std::vector<uint32_t> &selected)
+  {
+    __m256d ox = _mm256_set1_pd(origin.x);
+    __m256d oy = _mm256_set1_pd(origin.y);
+    __m256d oz = _mm256_set1_pd(origin.z);
+    __m256d limit = _mm256_set1_pd(range2);
+    uint32_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+      __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(x + i), ox);
+      __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(y + i), oy);
+      __m256d dz = _mm256_sub_pd(_mm256_loadu_pd(z + i), oz);
+      __m256d d2 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)),
+                                 _mm256_mul_pd(dz, dz));
+      int mask = _mm256_movemask_pd(_mm256_cmp_pd(d2, limit, _CMP_LE_OQ));
+      while (mask)
+      {
+        int lane = __builtin_ctz(mask);
+        selected.push_back(i + lane);
+        mask &= mask - 1;
+      }
+    }
+    SelectScalar(origin, range2, x, y, z, i, n, selected);
+  }
+#endif
+};
+
+// Received power and delay of links between stationary PHYs, which the
+// loss and delay models would otherwise compute again for every frame.
+//
+// PHYs are numbered by the channel.  A path is only reused while neither
+// end has been invalidated (moved) since it was computed, and only for the
+// transmit power it was computed with.  Models with a random part (fading,
+// random loss or delay) are never cached: the whole loss chain and the
+// delay model must be of the deterministic types listed in IsDeterministic.
+class PropagationPathCache
+{
+public:
+  PropagationPathCache()
+    : m_enabled(false),
+      m_hits(0),
+      m_misses(0)
+  {
+  }
+
+  void SetModels(Ptr<PropagationLossModel> loss, Ptr<PropagationDelayModel> delay)
+  {
+    m_loss = loss;
+    m_delay = delay;
+    m_enabled = loss != 0 && delay != 0 && IsDeterministic(delay->GetInstanceTypeId().GetName());
+    for (Ptr<PropagationLossModel> model = loss; m_enabled && model != 0; model = model->GetNext())
+    {
+      m_enabled = IsDeterministic(model->GetInstanceTypeId().GetName());
+    }
+    m_paths.clear();
+  }
+
+  bool IsEnabled(void) const
+  {
+    return m_enabled;
+  }
+
+  // Forgets every path of PHY index, e.g. after its node moved.
+  void Invalidate(uint32_t index)
+  {
+    if (index < m_versions.size())
+    {
+      m_versions[index]++;
+    }
+  }
+
+  // Received power from sender to receiver, both stationary, and in delay
+  // the propagation delay.
+  double GetRxPower(uint32_t sender, uint32_t receiver, double txPowerDbm, Ptr<MobilityModel> a,
+                    Ptr<MobilityModel> b, Time &delay)
+  {
+    uint32_t last = std::max(sender, receiver);
+    if (last >= m_versions.size())
+    {
+      m_versions.resize(last + 1, 0);
+    }
+    Path &path = m_paths[(uint64_t(sender) << 32) | receiver];
+    if (path.computed && path.senderVersion == m_versions[sender] &&
+        path.receiverVersion == m_versions[receiver] && path.txPowerDbm == txPowerDbm)
+    {
+      m_hits++;
+      delay = path.delay;
+      return path.rxPowerDbm;
+    }
+    m_misses++;
+    path.computed = true;
+    path.senderVersion = m_versions[sender];
+    path.receiverVersion = m_versions[receiver];
+    path.txPowerDbm = txPowerDbm;
+    path.rxPowerDbm = m_loss->CalcRxPower(txPowerDbm, a, b);
+    path.delay = m_delay->GetDelay(a, b);
+    delay = path.delay;
+    return path.rxPowerDbm;
+  }
+
+  uint64_t GetHits(void) const
+  {
+    return m_hits;
+  }
+
+  uint64_t GetMisses(void) const
+  {
+    return m_misses;
+  }
+
+  void Clear(void)
+  {
+    m_paths.clear();
+    m_versions.clear();
+    m_loss = 0;
+    m_delay = 0;
+    m_enabled = false;
+  }
+
+  static bool IsDeterministic(const std::string &type)
+  {
+    static const char *types[] = {"ns3::LogDistancePropagationLossModel",
+                                  "ns3::ThreeLogDistancePropagationLossModel",
+                                  "ns3::FriisPropagationLossModel",
+                                  "ns3::TwoRayGroundPropagationLossModel",
+                                  "ns3::RangePropagationLossModel",
+                                  "ns3::FixedRssLossModel",
+                                  "ns3::MatrixPropagationLossModel",
+                                  "ns3::ConstantSpeedPropagationDelayModel"};
+    for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++)
+    {
+      if (type == types[i])
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+private:
+  struct Path
+  {
+    Path()
+      : computed(false),
+        senderVersion(0),
+        receiverVersion(0),
+        txPowerDbm(0),
+        rxPowerDbm(0)
+    {
+    }
+
+    bool computed;
+    uint32_t senderVersion;
+    uint32_t receiverVersion;
+    double txPowerDbm;
+    double rxPowerDbm;
+    Time delay;
+  };
+
+  bool m_enabled;
+  Ptr<PropagationLossModel> m_loss;
+  Ptr<PropagationDelayModel> m_delay;
+  std::unordered_map<uint64_t, Path> m_paths;
+  std::vector<uint32_t> m_versions;
+  uint64_t m_hits;
+  uint64_t m_misses;
+};
+
+} // namespace ns3
+
+#endif /* CACHED_PROPAGATION_LOSS_H */
@@ -0,0 +1,224 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef COMPRESSED_STREAM_H
+#define COMPRESSED_STREAM_H
+
+#include "ns3/core-module.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+// Output file that compresses as it goes, picked from the file name:
+// "*.gz" is gzip, "*.zst" is zstd, anything else is written as is.
+//
+// The codecs are optional so the scenarios still build on a plain ns-3
+// tree.  Enable them when configuring, e.g.
+//
+//   CXXFLAGS="-DHAVE_ZLIB -DHAVE_ZSTD" LINKFLAGS="-lz -lzstd" ./waf configure
+
+namespace ns3 {
+
+class CompressedOutputStream
+{
+public:
+  enum Codec
+  {
+    NONE,
+    GZIP,
+    ZSTD
+  };
+
+  CompressedOutputStream()
+    : m_codec(NONE),
+      m_file(0)
+#ifdef HAVE_ZLIB
+      ,
+      m_gz(0)
+#endif
+#ifdef HAVE_ZSTD
+      ,
+      m_zstd(0)
+#endif
+  {
+  }
+
+  ~CompressedOutputStream()
+  {
+    Close();
+  }
+
+  static Codec CodecFor(const std::string &path)
+  {
+    if (EndsWith(path, ".gz"))
+    {
+      return GZIP;
+    }
+    if (EndsWith(path, ".zst"))
+    {
+      return ZSTD;
+    }
+    return NONE;
+  }
+
+  // Opens the file; the level only applies to compressed output.
+  void Open(const std::string &path, int level = 3)
+  {
+    m_path = path;
+    m_codec = CodecFor(path);
+    if (m_codec == GZIP)
+    {
+#ifdef HAVE_ZLIB
+      m_gz = gzopen(path.c_str(), ("wb" + std::to_string(level)).c_str());
+      NS_ABORT_MSG_IF(m_gz == 0, "Cannot open " << path);
+      gzbuffer(m_gz, 1 << 20);
+      return;
+#else
+      NS_FATAL_ERROR("Writing " << path << " needs zlib, configure with -DHAVE_ZLIB and -lz");
+#endif
+    }
+    m_file = std::fopen(path.c_str(), "wb");
+    NS_ABORT_MSG_IF(m_file == 0, "Cannot open " << path);
+    if (m_codec == ZSTD)
+    {
+#ifdef HAVE_ZSTD
+      m_zstd = ZSTD_createCStream();
+      NS_ABORT_MSG_IF(m_zstd == 0, "Cannot create a zstd stream for " << path);
+      size_t status = ZSTD_initCStream(m_zstd, level);
+      NS_ABORT_MSG_IF(ZSTD_isError(status), "Cannot compress " << path << ": " << ZSTD_getErrorName(status));
+      m_buffer.resize(ZSTD_CStreamOutSize());
+#else
+      NS_FATAL_ERROR("Writing " << path << " needs zstd, configure with -DHAVE_ZSTD and -lzstd");
+#endif
+    }
+  }
+
+  bool IsOpen() const
+  {
+#ifdef HAVE_ZLIB
+    if (m_gz)
+    {
+      return true;
+    }
+#endif
+    return m_file != 0;
+  }
+
+  // A failed write aborts: a truncated trace is worse than none.
+  void Write(const void *data, size_t size)
+  {
+#ifdef HAVE_ZLIB
+    if (m_gz)
+    {
+      if (size > 0 && gzwrite(m_gz, data, unsigned(size)) == 0)
+      {
+        int error;
+        const char *message = gzerror(m_gz, &error);
+        NS_FATAL_ERROR("Cannot write " << m_path << ": "
+                                       << (error == Z_ERRNO ? std::strerror(errno) : message));
+      }
+      return;
+    }
+#endif
+#ifdef HAVE_ZSTD
+    if (m_zstd)
+    {
+      ZSTD_inBuffer in = {data, size, 0};
+      while (in.pos < in.size)
+      {
+        ZSTD_outBuffer out = {&m_buffer[0], m_buffer.size(), 0};
+        size_t status = ZSTD_compressStream(m_zstd, &out, &in);
+        NS_ABORT_MSG_IF(ZSTD_isError(status), "Cannot compress " << m_path << ": " << ZSTD_getErrorName(status));
+        WriteFile(&m_buffer[0], out.pos);
+      }
+      return;
+    }
+#endif
+    WriteFile(data, size);
+  }
+
+  void Close()
+  {
+#ifdef HAVE_ZLIB
+    if (m_gz)
+    {
+      int status = gzclose(m_gz);
+      m_gz = 0;
+      NS_ABORT_MSG_IF(status != Z_OK, "Cannot write " << m_path << ": "
+                                                     << (status == Z_ERRNO ? std::strerror(errno) : zError(status)));
+    }
+#endif
+#ifdef HAVE_ZSTD
+    if (m_zstd)
+    {
+      size_t remaining;
+      do
+      {
+        ZSTD_outBuffer out = {&m_buffer[0], m_buffer.size(), 0};
+        remaining = ZSTD_endStream(m_zstd, &out);
+        NS_ABORT_MSG_IF(ZSTD_isError(remaining), "Cannot compress " << m_path << ": " << ZSTD_getErrorName(remaining));
+        WriteFile(&m_buffer[0], out.pos);
+      } while (remaining > 0);
+      ZSTD_freeCStream(m_zstd);
+      m_zstd = 0;
+    }
+#endif
+    if (m_file)
+    {
+      int status = std::fclose(m_file);
+      m_file = 0;
+      NS_ABORT_MSG_IF(status != 0, "Cannot write " << m_path << ": " << std::strerror(errno));
+    }
+  }
+
+private:
+  void WriteFile(const void *data, size_t size)
+  {
+    NS_ABORT_MSG_IF(std::fwrite(data, 1, size, m_file) != size, "Cannot write " << m_path << ": " << std::strerror(errno));
+  }
+
+  static bool EndsWith(const std::string &s, const std::string &suffix)
+  {
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+  }
+
+  CompressedOutputStream(const CompressedOutputStream &);
+  CompressedOutputStream &operator=(const CompressedOutputStream &);
+
+  std::string m_path;
+  Codec m_codec;
+  std::FILE *m_file;
+#ifdef HAVE_ZLIB
+  gzFile m_gz;
+#endif
+#ifdef HAVE_ZSTD
+  ZSTD_CStream *m_zstd;
+#endif
+  std::vector<char> m_buffer;
+};
+
+} // namespace ns3
+
+#endif /* COMPRESSED_STREAM_H */
@@ -0,0 +1,211 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/applications-module.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Events above this level are compiled out: their trace sinks are never
+// connected and Record<Level> is empty.  0 disables the event log.
+#ifndef EVENT_LOG_LEVEL
+#define EVENT_LOG_LEVEL 1
+#endif
+
+namespace ns3 {
+
+// Fixed-size binary record, written as is (host byte order).
+struct EventRecord
+{
+  enum Type
+  {
+    CLIENT_SENT,
+    CLIENT_RECEIVED,
+    SERVER_RECEIVED,
+    SERVER_SENT
+  };
+
+  int64_t time;    // ns
+  uint32_t node;
+  uint16_t app;    // index of the application on its node
+  uint8_t type;
+  uint8_t level;
+  uint32_t size;   // bytes
+  uint32_t peer;   // IPv4 address of the other end
+  uint16_t port;   // port of the other end
+  uint16_t reserved;
+  uint32_t reserved2;
+};
+
+struct EventLogHeader
+{
+  char magic[8];   // "NS3EVLOG"
+  uint32_t version;
+  uint32_t recordSize;
+};
+
+// Records the UdpEcho client and server events that the
+// UdpEcho*Application INFO log lines print, as binary records instead of
+// text.  Records are kept in a buffer and written in blocks; decode the
+// file with EventLogDecoder to get the old log lines back.
+class EventLog
+{
+public:
+  static const uint8_t LEVEL_INFO = 1;
+
+  EventLog()
+    : m_file(0),
+      m_capacity(0)
+  {
+  }
+
+  ~EventLog()
+  {
+    Close();
+  }
+
+  void Open(const std::string &path, size_t bufferRecords = 1 << 16)
+  {
+    m_file = std::fopen(path.c_str(), "wb");
+    NS_ABORT_MSG_IF(m_file == 0, "Cannot open " << path);
+    EventLogHeader header;
+    std::memcpy(header.magic, "NS3EVLOG", 8);
+    header.version = 1;
+    header.recordSize = sizeof(EventRecord);
+    std::fwrite(&header, sizeof(header), 1, m_file);
+    m_capacity = bufferRecords;
+    m_buffer.reserve(m_capacity);
+  }
+
+  void Close()
+  {
+    if (m_file)
+    {
+      Flush();
+      std::fclose(m_file);
+      m_file = 0;
+    }
+  }
+
+  void TrackEchoClients(const ApplicationContainer &clients)
+  {
+    for (uint32_t i = 0; EVENT_LOG_LEVEL >= LEVEL_INFO && i < clients.GetN(); i++)
+    {
+      Ptr<Application> app = clients.Get(i);
+      uint32_t id = Id(app);
+      app->TraceConnectWithoutContext("TxWithAddresses", MakeBoundCallback(&EventLog::ClientTx, this, id));
+      app->TraceConnectWithoutContext("RxWithAddresses", MakeBoundCallback(&EventLog::ClientRx, this, id));
+    }
+  }
+
+  void TrackEchoServers(const ApplicationContainer &servers)
+  {
+    for (uint32_t i = 0; EVENT_LOG_LEVEL >= LEVEL_INFO && i < servers.GetN(); i++)
+    {
+      Ptr<Application> app = servers.Get(i);
+      app->TraceConnectWithoutContext("RxWithAddresses", MakeBoundCallback(&EventLog::ServerRx, this, Id(app)));
+    }
+  }
+
+  template <uint8_t Level>
+  void Record(uint32_t id, uint8_t type, uint32_t size, const Address &peer)
+  {
+    if (Level > EVENT_LOG_LEVEL || m_file == 0)
+    {
+      return;
+    }
+    EventRecord record;
+    std::memset(&record, 0, sizeof(record));
+    record.time = Simulator::Now().GetNanoSeconds();
+    record.node = id >> 16;
+    record.app = id & 0xffff;
+    record.type = type;
+    record.level = Level;
+    record.size = size;
+    if (InetSocketAddress::IsMatchingType(peer))
+    {
+      InetSocketAddress inet = InetSocketAddress::ConvertFrom(peer);
+      record.peer = inet.GetIpv4().Get();
+      record.port = inet.GetPort();
+    }
+    m_buffer.push_back(record);
+    if (m_buffer.size() >= m_capacity)
+    {
+      Flush();
+    }
+  }
+
+private:
+  // Node id in the upper, application index in the lower 16 bits.
+  static uint32_t Id(Ptr<Application> app)
+  {
+    Ptr<Node> node = app->GetNode();
+    uint32_t index = 0;
+    while (index < node->GetNApplications() && node->GetApplication(index) != app)
+    {
+      index++;
+    }
+    return (node->GetId() << 16) | index;
+  }
+
+  static void ClientTx(EventLog *log, uint32_t id, Ptr<const Packet> packet, const Address &local,
+                       const Address &remote)
+  {
+    log->Record<LEVEL_INFO>(id, EventRecord::CLIENT_SENT, packet->GetSize(), remote);
+  }
+
+  static void ClientRx(EventLog *log, uint32_t id, Ptr<const Packet> packet, const Address &from,
+                       const Address &local)
+  {
+    log->Record<LEVEL_INFO>(id, EventRecord::CLIENT_RECEIVED, packet->GetSize(), from);
+  }
+
+  // The server echoes every packet back at once, so its send is recorded
+  // together with the receive.
+  static void ServerRx(EventLog *log, uint32_t id, Ptr<const Packet> packet, const Address &from,
+                       const Address &local)
+  {
+    log->Record<LEVEL_INFO>(id, EventRecord::SERVER_RECEIVED, packet->GetSize(), from);
+    log->Record<LEVEL_INFO>(id, EventRecord::SERVER_SENT, packet->GetSize(), from);
+  }
+
+  void Flush()
+  {
+    if (!m_buffer.empty())
+    {
+      std::fwrite(&m_buffer[0], sizeof(EventRecord), m_buffer.size(), m_file);
+      m_buffer.clear();
+    }
+  }
+
+  EventLog(const EventLog &);
+  EventLog &operator=(const EventLog &);
+
+  std::FILE *m_file;
+  size_t m_capacity;
+  std::vector<EventRecord> m_buffer;
+};
+
+} // namespace ns3
+
+#endif /* EVENT_LOG_H */
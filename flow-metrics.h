@@ -0,0 +1,288 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef FLOW_METRICS_H
+#define FLOW_METRICS_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/flow-monitor-module.h"
+#include "run-summary.h"
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+// Per-flow delay, jitter, throughput, loss and hop counts from FlowMonitor,
+// written as CSV instead of FlowMonitor's XML:
+//
+//   <prefix>-flows.csv       one row per flow at the end of the run
+//   <prefix>-histograms.csv  non-empty delay and jitter histogram bins
+//   <prefix>-snapshots.csv   per-interval counters (EnableSnapshots)
+//
+// Flow ends are given as node names (e.g. L0, R0) for nodes named with
+// NameNode, as addresses otherwise.
+class FlowMetrics
+{
+public:
+  FlowMetrics()
+    : m_delayBin(0.0005),
+      m_interval(Seconds(1))
+  {
+  }
+
+  // Histogram bin widths are in seconds.
+  void Install(const NodeContainer &nodes, double delayBin = 0.0005, double jitterBin = 0.0005)
+  {
+    m_delayBin = delayBin;
+    m_helper.SetMonitorAttribute("DelayBinWidth", DoubleValue(delayBin));
+    m_helper.SetMonitorAttribute("JitterBinWidth", DoubleValue(jitterBin));
+    m_monitor = m_helper.Install(nodes);
+    m_classifier = DynamicCast<Ipv4FlowClassifier>(m_helper.GetClassifier());
+  }
+
+  // Labels every IPv4 address of the node with the name.
+  void NameNode(Ptr<Node> node, const std::string &name)
+  {
+    Ptr<Ipv4> ipv4 = node->GetObject<Ipv4>();
+    for (uint32_t i = 1; ipv4 && i < ipv4->GetNInterfaces(); i++)
+    {
+      for (uint32_t j = 0; j < ipv4->GetNAddresses(i); j++)
+      {
+        m_names[ipv4->GetAddress(i, j).GetLocal()] = name;
+      }
+    }
+  }
+
+  void EnableSnapshots(const std::string &path, Time interval)
+  {
+    NS_ABORT_MSG_IF(m_monitor == 0, "FlowMetrics::Install must come first");
+    m_snapshots.open(path.c_str());
+    NS_ABORT_MSG_UNLESS(m_snapshots.is_open(), "Cannot write " << path);
+    m_snapshots << "time_s,flow,src,dst,tx_packets,rx_packets,lost_packets,rx_bytes,throughput_kbps,delay_mean_ms\n";
+    m_interval = interval;
+    Simulator::Schedule(interval, &FlowMetrics::Snapshot, this);
+  }
+
+  void Write(const std::string &prefix)
+  {
+    m_monitor->CheckForLostPackets();
+    const FlowMonitor::FlowStatsContainer &stats = m_monitor->GetFlowStats();
+    FlowMonitor::FlowStatsContainer::const_iterator it;
+
+    std::ofstream flows((prefix + "-flows.csv").c_str());
+    NS_ABORT_MSG_UNLESS(flows.is_open(), "Cannot write " << prefix << "-flows.csv");
+    flows.precision(9);
+    flows << "flow,src,dst,protocol,src_port,dst_port,tx_packets,rx_packets,lost_packets,tx_bytes,rx_bytes,"
+          << "loss,throughput_kbps,delay_mean_ms,delay_p50_ms,delay_p99_ms,jitter_mean_ms,hops_mean\n";
+    for (it = stats.begin(); it != stats.end(); it++)
+    {
+      const FlowMonitor::FlowStats &flow = it->second;
+      Ipv4FlowClassifier::FiveTuple t = m_classifier->FindFlow(it->first);
+      flows << it->first << "," << Name(t.sourceAddress) << "," << Name(t.destinationAddress) << ","
+            << uint32_t(t.protocol) << "," << t.sourcePort << "," << t.destinationPort << "," << flow.txPackets
+            << "," << flow.rxPackets << "," << flow.lostPackets << "," << flow.txBytes << "," << flow.rxBytes
+            << "," << Loss(flow) << "," << Throughput(flow) << "," << DelayMean(flow) << ","
+            << Percentile(flow.delayHistogram, 0.5) * 1000.0 << ","
+            << Percentile(flow.delayHistogram, 0.99) * 1000.0 << "," << JitterMean(flow) << ","
+            << HopsMean(flow) << "\n";
+    }
+
+    std::ofstream histograms((prefix + "-histograms.csv").c_str());
+    NS_ABORT_MSG_UNLESS(histograms.is_open(), "Cannot write " << prefix << "-histograms.csv");
+    histograms.precision(9);
+    histograms << "flow,kind,bin_start_ms,bin_width_ms,count\n";
+    for (it = stats.begin(); it != stats.end(); it++)
+    {
+      WriteHistogram(histograms, it->first, "delay", it->second.delayHistogram);
+      WriteHistogram(histograms, it->first, "jitter", it->second.jitterHistogram);
+    }
+  }
+
+  // Adds totals over all flows to the run summary.
+  void Summarize(RunSummary &summary)
+  {
+    m_monitor->CheckForLostPackets();
+    const FlowMonitor::FlowStatsContainer &stats = m_monitor->GetFlowStats();
+    uint64_t tx = 0;
+    uint64_t rx = 0;
+    uint64_t forwarded = 0;
+    double delay = 0;
+    double jitter = 0;
+    uint64_t jitterSamples = 0;
+    double throughput = 0;
+    std::vector<uint64_t> delays;
+    for (FlowMonitor::FlowStatsContainer::const_iterator it = stats.begin(); it != stats.end(); it++)
+    {
+      const FlowMonitor::FlowStats &flow = it->second;
+      tx += flow.txPackets;
+      rx += flow.rxPackets;
+      forwarded += flow.timesForwarded;
+      delay += flow.delaySum.GetSeconds();
+      jitter += flow.jitterSum.GetSeconds();
+      jitterSamples += flow.rxPackets > 1 ? flow.rxPackets - 1 : 0;
+      throughput += Throughput(flow);
+      // All flows share the bin width, so bins add up by index.
+      const Histogram &h = flow.delayHistogram;
+      delays.resize(std::max<size_t>(delays.size(), h.GetNBins()), 0);
+      for (uint32_t b = 0; b < h.GetNBins(); b++)
+      {
+        delays[b] += h.GetBinCount(b);
+      }
+    }
+    summary.Set("flows", stats.size());
+    summary.Set("flow_tx_packets", tx);
+    summary.Set("flow_rx_packets", rx);
+    summary.Set("flow_loss", tx ? 1.0 - double(rx) / tx : 0.0);
+    summary.Set("flow_delay_mean_ms", rx ? delay / rx * 1000.0 : 0.0);
+    summary.Set("flow_delay_p99_ms", Percentile(delays, m_delayBin, 0.99) * 1000.0);
+    summary.Set("flow_jitter_mean_ms", jitterSamples ? jitter / jitterSamples * 1000.0 : 0.0);
+    summary.Set("flow_throughput_kbps", stats.empty() ? 0.0 : throughput / stats.size());
+    summary.Set("flow_hops_mean", rx ? 1.0 + double(forwarded) / rx : 0.0);
+  }
+
+private:
+  struct Previous
+  {
+    uint64_t rxPackets;
+    uint64_t rxBytes;
+    double delaySum;
+  };
+
+  std::string Name(Ipv4Address address) const
+  {
+    std::map<Ipv4Address, std::string>::const_iterator it = m_names.find(address);
+    if (it != m_names.end())
+    {
+      return it->second;
+    }
+    std::ostringstream text;
+    text << address;
+    return text.str();
+  }
+
+  static double Loss(const FlowMonitor::FlowStats &flow)
+  {
+    return flow.txPackets ? double(flow.lostPackets) / flow.txPackets : 0.0;
+  }
+
+  static double Throughput(const FlowMonitor::FlowStats &flow)
+  {
+    double duration = (flow.timeLastRxPacket - flow.timeFirstTxPacket).GetSeconds();
+    return flow.rxPackets && duration > 0 ? flow.rxBytes * 8.0 / duration / 1000.0 : 0.0;
+  }
+
+  static double DelayMean(const FlowMonitor::FlowStats &flow)
+  {
+    return flow.rxPackets ? flow.delaySum.GetSeconds() / flow.rxPackets * 1000.0 : 0.0;
+  }
+
+  static double JitterMean(const FlowMonitor::FlowStats &flow)
+  {
+    return flow.rxPackets > 1 ? flow.jitterSum.GetSeconds() / (flow.rxPackets - 1) * 1000.0 : 0.0;
+  }
+
+  static double HopsMean(const FlowMonitor::FlowStats &flow)
+  {
+    return flow.rxPackets ? 1.0 + double(flow.timesForwarded) / flow.rxPackets : 0.0;
+  }
+
+  // Upper edge of the bin holding the given quantile.
+  static double Percentile(const std::vector<uint64_t> &counts, double width, double quantile)
+  {
+    uint64_t total = 0;
+    for (size_t b = 0; b < counts.size(); b++)
+    {
+      total += counts[b];
+    }
+    uint64_t seen = 0;
+    for (size_t b = 0; b < counts.size(); b++)
+    {
+      seen += counts[b];
+      if (seen > 0 && seen >= quantile * total)
+      {
+        return (b + 1) * width;
+      }
+    }
+    return 0.0;
+  }
+
+  double Percentile(const Histogram &histogram, double quantile) const
+  {
+    std::vector<uint64_t> counts(histogram.GetNBins());
+    for (uint32_t b = 0; b < histogram.GetNBins(); b++)
+    {
+      counts[b] = histogram.GetBinCount(b);
+    }
+    return Percentile(counts, m_delayBin, quantile);
+  }
+
+  static void WriteHistogram(std::ofstream &out, FlowId flow, const char *kind, const Histogram &histogram)
+  {
+    for (uint32_t b = 0; b < histogram.GetNBins(); b++)
+    {
+      if (histogram.GetBinCount(b))
+      {
+        out << flow << "," << kind << "," << histogram.GetBinStart(b) * 1000.0 << ","
+            << histogram.GetBinWidth(b) * 1000.0 << "," << histogram.GetBinCount(b) << "\n";
+      }
+    }
+  }
+
+  void Snapshot()
+  {
+    m_monitor->CheckForLostPackets();
+    const FlowMonitor::FlowStatsContainer &stats = m_monitor->GetFlowStats();
+    double now = Simulator::Now().GetSeconds();
+    for (FlowMonitor::FlowStatsContainer::const_iterator it = stats.begin(); it != stats.end(); it++)
+    {
+      const FlowMonitor::FlowStats &flow = it->second;
+      Previous &last = m_previous[it->first];
+      uint64_t packets = flow.rxPackets - last.rxPackets;
+      double delay = flow.delaySum.GetSeconds() - last.delaySum;
+      Ipv4FlowClassifier::FiveTuple t = m_classifier->FindFlow(it->first);
+      m_snapshots << now << "," << it->first << "," << Name(t.sourceAddress) << "," << Name(t.destinationAddress)
+                  << "," << flow.txPackets << "," << flow.rxPackets << "," << flow.lostPackets << ","
+                  << flow.rxBytes << "," << (flow.rxBytes - last.rxBytes) * 8.0 / m_interval.GetSeconds() / 1000.0
+                  << "," << (packets ? delay / packets * 1000.0 : 0.0) << "\n";
+      last.rxPackets = flow.rxPackets;
+      last.rxBytes = flow.rxBytes;
+      last.delaySum = flow.delaySum.GetSeconds();
+    }
+    Simulator::Schedule(m_interval, &FlowMetrics::Snapshot, this);
+  }
+
+  FlowMetrics(const FlowMetrics &);
+  FlowMetrics &operator=(const FlowMetrics &);
+
+  FlowMonitorHelper m_helper;
+  Ptr<FlowMonitor> m_monitor;
+  Ptr<Ipv4FlowClassifier> m_classifier;
+  std::map<Ipv4Address, std::string> m_names;
+  double m_delayBin;
+  std::ofstream m_snapshots;
+  Time m_interval;
+  std::map<FlowId, Previous> m_previous;
+};
+
+} // namespace ns3
+
+#endif /* FLOW_METRICS_H */
@@ -0,0 +1,592 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef FLUID_BACKGROUND_H
+#define FLUID_BACKGROUND_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/applications-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/traffic-control-module.h"
+#include "queue-telemetry.h"
+#include "run-summary.h"
+#include "traffic-generators.h"
+
+#include <algorithm>
+#include <deque>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+// FIFO root queue disc that carries a link's background load as a fluid.
+//
+// The background is the load a WorkloadApplication of Profile (cbr,
+// poisson or onoff) would send at Rate, counted on the wire (PacketSize
+// plus UDP, IPv4 and PPP headers).  Every Interval the fluid backlog is
+// advanced from the background that arrives, the capacity the foreground
+// of the last interval left over and the buffer (MaxSize, in background
+// packets when given in packets); what does not fit is lost.  No event
+// is scheduled per background packet.
+//
+// Foreground packets stay packets.  Each one
+//
+//   - is dropped with the interval's background loss rate,
+//   - waits for the backlog in front of it (interpolated within the
+//     interval) to drain at the link rate, plus the wait behind
+//     background packets the fluid smooths out: with probability rho
+//     (the background utilization) an exponential delay whose mean
+//     makes the average rho S / 2 (cbr, onoff: the residual of one
+//     packet of S seconds) or rho S / (2 (1 - rho)) (poisson: M/D/1),
+//   - and leaves no faster than the capacity the background leaves over,
+//     or its share of the link when both together overload it.
+//
+// The device then sends it at the link rate.  Held packets wake the queue
+// disc with one event each, as TbfQueueDisc does.
+class FluidBackgroundQueueDisc : public QueueDisc
+{
+public:
+  enum Profile
+  {
+    CBR,
+    POISSON,
+    ON_OFF
+  };
+
+  // UDP, IPv4 and PPP header bytes of a background packet.
+  static const uint32_t WIRE_OVERHEAD = 30;
+
+  static constexpr const char *FLUID_DROP = "Background overflow";
+
+  static TypeId GetTypeId(void)
+  {
+    static TypeId tid =
+        TypeId("ns3::FluidBackgroundQueueDisc")
+            .SetParent<QueueDisc>()
+            .SetGroupName("TrafficControl")
+            .AddConstructor<FluidBackgroundQueueDisc>()
+            .AddAttribute("MaxSize", "Buffer shared by the foreground packets and the background fluid.",
+                          QueueSizeValue(QueueSize("1000p")),
+                          MakeQueueSizeAccessor(&QueueDisc::SetMaxSize, &QueueDisc::GetMaxSize),
+                          MakeQueueSizeChecker())
+            .AddAttribute("Rate", "Background sending rate while active.", DataRateValue(DataRate("0bps")),
+                          MakeDataRateAccessor(&FluidBackgroundQueueDisc::m_rate), MakeDataRateChecker())
+            .AddAttribute("Profile", "Background traffic profile.", EnumValue(POISSON),
+                          MakeEnumAccessor(&FluidBackgroundQueueDisc::m_profile),
+                          MakeEnumChecker(CBR, "cbr", POISSON, "poisson", ON_OFF, "onoff"))
+            .AddAttribute("PacketSize", "Payload bytes per background packet.", UintegerValue(1000),
+                          MakeUintegerAccessor(&FluidBackgroundQueueDisc::m_size),
+                          MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("OnTime", "Length of onoff bursts (s).",
+                          StringValue("ns3::ExponentialRandomVariable[Mean=1.0]"),
+                          MakePointerAccessor(&FluidBackgroundQueueDisc::m_onTime),
+                          MakePointerChecker<RandomVariableStream>())
+            .AddAttribute("OffTime", "Length of onoff pauses (s).",
+                          StringValue("ns3::ExponentialRandomVariable[Mean=1.0]"),
+                          MakePointerAccessor(&FluidBackgroundQueueDisc::m_offTime),
+                          MakePointerChecker<RandomVariableStream>())
+            .AddAttribute("Interval", "Time between fluid updates.", TimeValue(MilliSeconds(10)),
+                          MakeTimeAccessor(&FluidBackgroundQueueDisc::m_interval), MakeTimeChecker());
+    return tid;
+  }
+
+  FluidBackgroundQueueDisc()
+    : QueueDisc(QueueDiscSizePolicy::SINGLE_INTERNAL_QUEUE),
+      m_profile(POISSON),
+      m_size(1000),
+      m_capacity(0),
+      m_on(true),
+      m_backlog(0),
+      m_backlogEnd(0),
+      m_bgRate(0),
+      m_fgRate(0),
+      m_fgBits(0),
+      m_lossRate(0),
+      m_offered(0),
+      m_lost(0),
+      m_backlogArea(0),
+      m_active(0),
+      m_updates(0)
+  {
+    m_uniform = CreateObject<UniformRandomVariable>();
+    m_wait = CreateObject<ExponentialRandomVariable>();
+  }
+
+  // The device's DataRate; call before Activate.
+  void SetLinkRate(DataRate rate)
+  {
+    m_capacity = rate.GetBitRate();
+  }
+
+  // Background flows from start until stop.
+  void Activate(Time start, Time stop)
+  {
+    NS_ABORT_MSG_IF(m_capacity == 0, "FluidBackgroundQueueDisc needs the link rate");
+    m_stop = stop;
+    m_update = Simulator::Schedule(start - Simulator::Now(), &FluidBackgroundQueueDisc::Start, this);
+  }
+
+  int64_t AssignStreams(int64_t stream)
+  {
+    m_uniform->SetStream(stream);
+    m_wait->SetStream(stream + 1);
+    m_onTime->SetStream(stream + 2);
+    m_offTime->SetStream(stream + 3);
+    return 4;
+  }
+
+  // Background bits offered and lost, and the time-averaged backlog.
+  double GetOfferedBits() const
+  {
+    return m_offered;
+  }
+
+  double GetLostBits() const
+  {
+    return m_lost;
+  }
+
+  double GetMeanBacklogBits() const
+  {
+    return m_active > 0 ? m_backlogArea / m_active : 0.0;
+  }
+
+  uint64_t GetUpdates() const
+  {
+    return m_updates;
+  }
+
+protected:
+  virtual void DoDispose(void)
+  {
+    Simulator::Cancel(m_update);
+    Simulator::Cancel(m_wake);
+    m_uniform = 0;
+    m_wait = 0;
+    m_onTime = 0;
+    m_offTime = 0;
+    QueueDisc::DoDispose();
+  }
+
+private:
+  virtual bool DoEnqueue(Ptr<QueueDiscItem> item)
+  {
+    if (GetCurrentSize() + item > GetMaxSize())
+    {
+      DropBeforeEnqueue(item, LIMIT_EXCEEDED_DROP);
+      return false;
+    }
+    if (m_lossRate > 0 && m_uniform->GetValue() < m_lossRate)
+    {
+      DropBeforeEnqueue(item, FLUID_DROP);
+      return false;
+    }
+
+    double bits = item->GetSize() * 8.0;
+    m_fgBits += bits;
+    Time now = Simulator::Now();
+    double fraction = m_interval.IsStrictlyPositive()
+                          ? std::min((now - m_updated).GetSeconds() / m_interval.GetSeconds(), 1.0)
+                          : 0.0;
+    double backlog = m_backlog + (m_backlogEnd - m_backlog) * fraction;
+    // Capacity left to the foreground, or its share of an overload.
+    double share = m_bgRate + m_fgRate > 0 ? m_capacity * m_fgRate / (m_bgRate + m_fgRate) : 0.0;
+    double left = std::max(std::max(m_capacity - m_bgRate, share), m_capacity * 0.01);
+
+    Time eligible = std::max(now + Seconds(backlog / m_capacity + Wait()),
+                             m_lastEligible + Seconds(bits / left));
+    if (!GetInternalQueue(0)->Enqueue(item))
+    {
+      return false;
+    }
+    m_lastEligible = eligible;
+    m_eligible.push_back(eligible);
+    return true;
+  }
+
+  virtual Ptr<QueueDiscItem> DoDequeue(void)
+  {
+    if (m_eligible.empty())
+    {
+      return 0;
+    }
+    Time now = Simulator::Now();
+    if (m_eligible.front() > now)
+    {
+      if (!m_wake.IsRunning())
+      {
+        m_wake = Simulator::Schedule(m_eligible.front() - now, &QueueDisc::Run, this);
+      }
+      return 0;
+    }
+    m_eligible.pop_front();
+    return GetInternalQueue(0)->Dequeue();
+  }
+
+  virtual bool CheckConfig(void)
+  {
+    if (GetNQueueDiscClasses() > 0 || GetNPacketFilters() > 0 || GetNInternalQueues() > 0)
+    {
+      return false;
+    }
+    AddInternalQueue(CreateObjectWithAttributes<DropTailQueue<QueueDiscItem> >("MaxSize",
+                                                                               QueueSizeValue(GetMaxSize())));
+    return true;
+  }
+
+  virtual void InitializeParams(void)
+  {
+  }
+
+  // Background wait the fluid does not show, drawn per foreground packet.
+  double Wait()
+  {
+    double rho = std::min(m_bgRate / m_capacity, 0.99);
+    if (rho <= 0 || m_uniform->GetValue() >= rho)
+    {
+      return 0.0;
+    }
+    double service = (m_size + WIRE_OVERHEAD) * 8.0 / m_capacity;
+    double mean = m_profile == POISSON ? service / (2 * (1 - rho)) : service / 2;
+    return m_wait->GetValue(mean, 0);
+  }
+
+  void Start()
+  {
+    m_on = true;
+    m_toggle = Simulator::Now() + Seconds(m_onTime->GetValue());
+    m_updated = Simulator::Now();
+    Update();
+  }
+
+  // Moves the fluid to the end of the next interval.
+  void Update()
+  {
+    Time now = Simulator::Now();
+    m_backlog = m_backlogEnd;
+    if (now >= m_stop)
+    {
+      m_bgRate = 0;
+      m_lossRate = 0;
+      m_backlog = 0;
+      m_backlogEnd = 0;
+      return;
+    }
+    Time end = std::min(now + m_interval, m_stop);
+    double dt = (end - now).GetSeconds();
+    double elapsed = (now - m_updated).GetSeconds();
+    m_fgRate = elapsed > 0 ? m_fgBits / elapsed : 0.0;
+    m_fgBits = 0;
+    m_updated = now;
+
+    double wire = m_rate.GetBitRate() * double(m_size + WIRE_OVERHEAD) / m_size;
+    double arrived = wire * OnTime(now, end);
+    double buffer = GetMaxSize().GetUnit() == QueueSizeUnit::PACKETS
+                        ? GetMaxSize().GetValue() * (m_size + WIRE_OVERHEAD) * 8.0
+                        : GetMaxSize().GetValue() * 8.0;
+    double backlog = m_backlog + arrived - std::max(m_capacity - m_fgRate, 0.0) * dt;
+    double lost = std::max(backlog - buffer, 0.0);
+    m_backlogEnd = std::min(std::max(backlog, 0.0), buffer);
+    m_bgRate = arrived / dt;
+    m_lossRate = arrived > 0 ? lost / arrived : 0.0;
+
+    m_offered += arrived;
+    m_lost += lost;
+    m_backlogArea += (m_backlog + m_backlogEnd) / 2 * dt;
+    m_active += dt;
+    m_updates++;
+    m_update = Simulator::Schedule(end - now, &FluidBackgroundQueueDisc::Update, this);
+  }
+
+  // Seconds the background sends within [from, to]; always all of it
+  // but with onoff.
+  double OnTime(Time from, Time to)
+  {
+    if (m_profile != ON_OFF)
+    {
+      return (to - from).GetSeconds();
+    }
+    double on = 0;
+    Time at = from;
+    while (m_toggle < to)
+    {
+      if (m_on)
+      {
+        on += (m_toggle - at).GetSeconds();
+      }
+      at = m_toggle;
+      m_on = !m_on;
+      m_toggle += Seconds((m_on ? m_onTime : m_offTime)->GetValue());
+    }
+    if (m_on)
+    {
+      on += (to - at).GetSeconds();
+    }
+    return on;
+  }
+
+  DataRate m_rate;
+  Profile m_profile;
+  uint32_t m_size;
+  Ptr<RandomVariableStream> m_onTime;
+  Ptr<RandomVariableStream> m_offTime;
+  Time m_interval;
+  Ptr<UniformRandomVariable> m_uniform;
+  Ptr<ExponentialRandomVariable> m_wait;
+  double m_capacity; // bit/s
+  Time m_stop;
+  bool m_on;
+  Time m_toggle;
+  Time m_updated;
+  EventId m_update;
+  EventId m_wake;
+
+  // Fluid state of the current interval, in bits and bit/s
+  double m_backlog;
+  double m_backlogEnd;
+  double m_bgRate;
+  double m_fgRate;
+  double m_fgBits;
+  double m_lossRate;
+  std::deque<Time> m_eligible;
+  Time m_lastEligible;
+
+  double m_offered;
+  double m_lost;
+  double m_backlogArea;
+  double m_active;
+  uint64_t m_updates;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(FluidBackgroundQueueDisc);
+
+// Background load between the two ends of point-to-point links, in one of
+// two modes:
+//
+//   fluid   a FluidBackgroundQueueDisc on each loaded device
+//   packet  a WorkloadApplication on each end sending to a sink on the
+//           peer, and a FifoQueueDisc of the same MaxSize on each loaded
+//           device, the same FIFO the fluid models
+//
+// Packet mode is the reference the fluid is checked against: both report
+// bg_offered_mbit and bg_loss, and PhaseTimer the events each executed.
+// Both need a traffic-control layer on the loaded nodes.
+class BackgroundLoad
+{
+public:
+  static const uint16_t PORT = 4000;
+
+  BackgroundLoad(const std::string &mode = "fluid")
+    : m_mode(mode),
+      m_maxSize("1000p")
+  {
+    NS_ABORT_MSG_UNLESS(IsMode(mode), "Unknown background mode " << mode << ", use fluid or packet");
+  }
+
+  static bool IsMode(const std::string &mode)
+  {
+    return mode == "fluid" || mode == "packet";
+  }
+
+  static bool IsProfile(const std::string &profile)
+  {
+    return profile == "cbr" || profile == "poisson" || profile == "onoff";
+  }
+
+  void SetMaxSize(const std::string &maxSize)
+  {
+    m_maxSize = maxSize;
+  }
+
+  // Loads the link of device in the direction device sends.
+  void Add(Ptr<NetDevice> device, const std::string &rate, const std::string &profile, uint32_t size)
+  {
+    NS_ABORT_MSG_UNLESS(IsProfile(profile), "Unknown background profile " << profile << ", use cbr, poisson or onoff");
+    Direction direction = {device, rate, profile, size};
+    m_directions.push_back(direction);
+  }
+
+  bool IsEmpty() const
+  {
+    return m_directions.empty();
+  }
+
+  // Call after the addresses and AQMs are installed.  Only the devices and
+  // sinks on nodes of the given (MPI) rank are set up.
+  void Install(Time start, Time stop, uint32_t rank = 0)
+  {
+    std::set<uint32_t> sinks;
+    for (size_t i = 0; i < m_directions.size(); i++)
+    {
+      Direction &d = m_directions[i];
+      Ptr<Channel> channel = d.device->GetChannel();
+      Ptr<NetDevice> peer = channel->GetDevice(0) == d.device ? channel->GetDevice(1) : channel->GetDevice(0);
+      bool local = d.device->GetNode()->GetSystemId() == rank;
+      if (m_mode == "packet" && peer->GetNode()->GetSystemId() == rank && sinks.insert(peer->GetNode()->GetId()).second)
+      {
+        ApplicationContainer sink = WorkloadHelper::InstallSink(d.profile, peer->GetNode(), PORT);
+        sink.Start(start);
+        m_sinks.Add(sink);
+      }
+      if (!local)
+      {
+        continue;
+      }
+
+      TrafficControlHelper tch;
+      if (m_mode == "fluid")
+      {
+        tch.SetRootQueueDisc("ns3::FluidBackgroundQueueDisc",
+                             "MaxSize", QueueSizeValue(QueueSize(m_maxSize)),
+                             "Rate", DataRateValue(DataRate(d.rate)),
+                             "Profile", StringValue(d.profile),
+                             "PacketSize", UintegerValue(d.size));
+      }
+      else
+      {
+        tch.SetRootQueueDisc("ns3::FifoQueueDisc", "MaxSize", QueueSizeValue(QueueSize(m_maxSize)));
+      }
+      Ptr<TrafficControlLayer> tc = d.device->GetNode()->GetObject<TrafficControlLayer>();
+      NS_ABORT_MSG_IF(tc == 0, "Background load needs a traffic-control layer, node "
+                                    << d.device->GetNode()->GetId() << " has none");
+      if (tc->GetRootQueueDiscOnDevice(d.device))
+      {
+        tch.Uninstall(d.device);
+      }
+      QueueDiscContainer discs = tch.Install(d.device);
+      Ptr<Queue<Packet> > queue = AqmHelper::GetDeviceQueue(d.device);
+      if (queue)
+      {
+        queue->SetMaxSize(QueueSize("1p"));
+      }
+
+      if (m_mode == "fluid")
+      {
+        Ptr<FluidBackgroundQueueDisc> fluid = DynamicCast<FluidBackgroundQueueDisc>(discs.Get(0));
+        DataRateValue linkRate;
+        d.device->GetAttribute("DataRate", linkRate);
+        fluid->SetLinkRate(linkRate.Get());
+        fluid->Activate(start, stop);
+        m_fluids.push_back(fluid);
+        d.fluid = fluid;
+      }
+      else
+      {
+        Ptr<Ipv4> ipv4 = peer->GetNode()->GetObject<Ipv4>();
+        Ipv4Address address = ipv4->GetAddress(ipv4->GetInterfaceForDevice(peer), 0).GetLocal();
+        WorkloadHelper load(d.profile, InetSocketAddress(address, PORT));
+        load.SetAttribute("PacketSize", UintegerValue(d.size));
+        load.SetAttribute("DataRate", DataRateValue(DataRate(d.rate)));
+        ApplicationContainer apps = load.Install(d.device->GetNode());
+        apps.Start(start);
+        apps.Stop(stop);
+        m_apps.Add(apps);
+        d.load = DynamicCast<WorkloadApplication>(apps.Get(0));
+        m_wireBits.push_back((d.size + FluidBackgroundQueueDisc::WIRE_OVERHEAD) * 8.0);
+        m_payloadBits.push_back(d.size * 8.0);
+      }
+    }
+  }
+
+  // Gives the fluid or generator of each direction fixed streams, counted
+  // from stream, by direction index, so they do not depend on the rank;
+  // directions set up on other ranks still take theirs.  Returns the
+  // number of streams used.
+  int64_t AssignStreams(int64_t stream)
+  {
+    int64_t current = stream;
+    for (size_t i = 0; i < m_directions.size(); i++)
+    {
+      if (m_directions[i].fluid)
+      {
+        m_directions[i].fluid->AssignStreams(current);
+      }
+      if (m_directions[i].load)
+      {
+        m_directions[i].load->AssignStreams(current);
+      }
+      current += WorkloadApplication::STREAMS; // the fluid uses fewer
+    }
+    return current - stream;
+  }
+
+  // bg_offered_mbit and bg_loss over this rank's loaded devices; fluid
+  // mode adds bg_backlog_mean_kbit and bg_fluid_updates.
+  void Summarize(RunSummary &summary) const
+  {
+    double offered = 0;
+    double lost = 0;
+    if (m_mode == "fluid")
+    {
+      double backlog = 0;
+      uint64_t updates = 0;
+      for (size_t i = 0; i < m_fluids.size(); i++)
+      {
+        offered += m_fluids[i]->GetOfferedBits();
+        lost += m_fluids[i]->GetLostBits();
+        backlog += m_fluids[i]->GetMeanBacklogBits();
+        updates += m_fluids[i]->GetUpdates();
+      }
+      summary.Set("bg_backlog_mean_kbit", m_fluids.empty() ? 0.0 : backlog / m_fluids.size() / 1000);
+      summary.Set("bg_fluid_updates", updates);
+    }
+    else
+    {
+      // Loss from payload bytes, the offered load in wire bits.
+      double payload = 0;
+      for (uint32_t i = 0; i < m_apps.GetN(); i++)
+      {
+        Ptr<WorkloadApplication> load = DynamicCast<WorkloadApplication>(m_apps.Get(i));
+        offered += load->GetSent() * m_wireBits[i];
+        payload += load->GetSent() * m_payloadBits[i];
+      }
+      double received = 0;
+      for (uint32_t i = 0; i < m_sinks.GetN(); i++)
+      {
+        received += DynamicCast<PacketSink>(m_sinks.Get(i))->GetTotalRx() * 8.0;
+      }
+      lost = payload > 0 ? offered * std::max(1 - received / payload, 0.0) : 0.0;
+    }
+    summary.Set("bg_offered_mbit", offered / 1e6);
+    summary.Set("bg_loss", offered > 0 ? lost / offered : 0.0);
+  }
+
+private:
+  struct Direction
+  {
+    Ptr<NetDevice> device;
+    std::string rate;
+    std::string profile;
+    uint32_t size;
+    Ptr<FluidBackgroundQueueDisc> fluid; // 0 where not set up on this rank
+    Ptr<WorkloadApplication> load;
+  };
+
+  std::string m_mode;
+  std::string m_maxSize;
+  std::vector<Direction> m_directions;
+  std::vector<Ptr<FluidBackgroundQueueDisc> > m_fluids;
+  ApplicationContainer m_apps;
+  std::vector<double> m_wireBits; // per app
+  std::vector<double> m_payloadBits;
+  ApplicationContainer m_sinks;
+};
+
+} // namespace ns3
+
+#endif /* FLUID_BACKGROUND_H */
@@ -0,0 +1,384 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef LADDER_SCHEDULER_H
+#define LADDER_SCHEDULER_H
+
+#include "ns3/core-module.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+// Ladder queue (Tang, Goh and Thng, 2005) event scheduler.
+//
+// Events are kept in three tiers:
+//
+//   top     unsorted events at or after m_topStart, the far future (the
+//           application starts and stops scheduled at setup)
+//   rungs   up to MAX_RUNGS levels of buckets.  A rung is spawned over
+//           the events of the top or of one bucket of the rung above that
+//           holds more than THRESHOLD events, with about one bucket per
+//           event, so that dense bursts are split further while sparse
+//           times cost one bucket.
+//   bottom  a short sorted run of the earliest events, taken from the
+//           first non-empty bucket of the lowest rung
+//
+// Inserting an event appends it to the top or to a bucket, or, when it
+// is earlier than every bucket, puts it in its sorted place in the bottom;
+// a bottom that grows past THRESHOLD becomes a new rung.  Every event is
+// thus moved a bounded number of times (once per rung), which makes insert
+// and remove amortized O(1).  Buckets are vectors that keep their capacity
+// when a rung is reused, so a run reaches a steady state without
+// allocations, and the bottom is a vector read from the front.
+class LadderScheduler : public Scheduler
+{
+public:
+  static const uint32_t THRESHOLD = 50;
+  static const uint32_t MAX_RUNGS = 8;
+  static const uint32_t MAX_BUCKETS = 1 << 16;
+
+  static TypeId GetTypeId(void)
+  {
+    static TypeId tid = TypeId("ns3::LadderScheduler")
+                            .SetParent<Scheduler>()
+                            .SetGroupName("Core")
+                            .AddConstructor<LadderScheduler>();
+    return tid;
+  }
+
+  LadderScheduler()
+    : m_topStart(0),
+      m_topMin(0),
+      m_topMax(0),
+      m_rungs(MAX_RUNGS),
+      m_nRungs(0),
+      m_bottomHead(0),
+      m_size(0)
+  {
+  }
+
+  virtual void Insert(const Event &ev)
+  {
+    m_size++;
+    Place(ev);
+    if (BottomEmpty())
+    {
+      Refill();
+    }
+  }
+
+  virtual bool IsEmpty(void) const
+  {
+    return m_size == 0;
+  }
+
+  // The bottom is only empty when the whole queue is.
+  virtual Event PeekNext(void) const
+  {
+    NS_ASSERT(!BottomEmpty());
+    return m_bottom[m_bottomHead];
+  }
+
+  virtual Event RemoveNext(void)
+  {
+    NS_ASSERT(!BottomEmpty());
+    Event ev = m_bottom[m_bottomHead++];
+    m_size--;
+    if (BottomEmpty())
+    {
+      Refill();
+    }
+    return ev;
+  }
+
+  virtual void Remove(const Event &ev)
+  {
+    uint64_t ts = ev.key.m_ts;
+    if (ts >= m_topStart)
+    {
+      Erase(m_top, ev);
+    }
+    else
+    {
+      uint32_t r = RungFor(ts);
+      if (r < m_nRungs)
+      {
+        Rung &rung = m_rungs[r];
+        Erase(rung.buckets[rung.BucketFor(ts)], ev);
+      }
+      else
+      {
+        std::vector<Event>::iterator it =
+            std::lower_bound(m_bottom.begin() + m_bottomHead, m_bottom.end(), ev);
+        NS_ASSERT(it != m_bottom.end() && it->key.m_uid == ev.key.m_uid);
+        m_bottom.erase(it);
+      }
+    }
+    m_size--;
+    if (BottomEmpty())
+    {
+      Refill();
+    }
+  }
+
+private:
+  // Buckets of equal width from start on; the last one also holds
+  // everything up to end, which is where the rung above (or the top)
+  // continues.
+  struct Rung
+  {
+    Rung()
+      : start(0),
+        width(1),
+        end(0),
+        nBuckets(0),
+        current(0)
+    {
+    }
+
+    // Start of the first bucket that has not been taken yet.
+    uint64_t Current() const
+    {
+      return current < nBuckets ? start + current * width : end;
+    }
+
+    uint32_t BucketFor(uint64_t ts) const
+    {
+      return uint32_t(std::min<uint64_t>((ts - start) / width, nBuckets - 1));
+    }
+
+    uint64_t BucketEnd(uint32_t b) const
+    {
+      return b + 1 == nBuckets ? end : start + (b + 1) * width;
+    }
+
+    uint64_t start;
+    uint64_t width;
+    uint64_t end;
+    uint32_t nBuckets;
+    uint32_t current;
+    std::vector<std::vector<Event> > buckets;
+  };
+
+  bool BottomEmpty() const
+  {
+    return m_bottomHead == m_bottom.size();
+  }
+
+  // Index of the highest rung whose untaken buckets cover ts, or m_nRungs
+  // when ts is earlier than all of them.
+  uint32_t RungFor(uint64_t ts) const
+  {
+    uint32_t r = 0;
+    while (r < m_nRungs && ts < m_rungs[r].Current())
+    {
+      r++;
+    }
+    return r;
+  }
+
+  void Place(const Event &ev)
+  {
+    uint64_t ts = ev.key.m_ts;
+    if (ts >= m_topStart)
+    {
+      m_topMin = m_top.empty() ? ts : std::min(m_topMin, ts);
+      m_topMax = m_top.empty() ? ts : std::max(m_topMax, ts);
+      m_top.push_back(ev);
+      return;
+    }
+    uint32_t r = RungFor(ts);
+    if (r < m_nRungs)
+    {
+      Rung &rung = m_rungs[r];
+      rung.buckets[rung.BucketFor(ts)].push_back(ev);
+      return;
+    }
+    m_bottom.insert(std::upper_bound(m_bottom.begin() + m_bottomHead, m_bottom.end(), ev), ev);
+    if (m_bottom.size() - m_bottomHead > THRESHOLD && m_nRungs < MAX_RUNGS &&
+        m_bottom[m_bottomHead].key.m_ts < m_bottom.back().key.m_ts)
+    {
+      // Too many events for a sorted insert: spread them over a rung that
+      // ends where the lowest rung (or the top) continues.
+      uint64_t end = m_nRungs ? m_rungs[m_nRungs - 1].Current() : m_topStart;
+      Rung &rung = Spawn(m_bottom[m_bottomHead].key.m_ts, m_bottom.back().key.m_ts, end,
+                         m_bottom.size() - m_bottomHead);
+      for (size_t i = m_bottomHead; i < m_bottom.size(); i++)
+      {
+        rung.buckets[rung.BucketFor(m_bottom[i].key.m_ts)].push_back(m_bottom[i]);
+      }
+      m_bottom.clear();
+      m_bottomHead = 0;
+      Refill();
+    }
+  }
+
+  // Activates the next rung over [min, end) with about one bucket per
+  // event between min and max.
+  Rung &Spawn(uint64_t min, uint64_t max, uint64_t end, uint64_t events)
+  {
+    uint64_t span = max - min + 1;
+    uint64_t buckets = std::max<uint64_t>(std::min<uint64_t>(events, MAX_BUCKETS), 1);
+    Rung &rung = m_rungs[m_nRungs++];
+    rung.start = min;
+    rung.width = (span + buckets - 1) / buckets;
+    rung.nBuckets = uint32_t((span + rung.width - 1) / rung.width);
+    rung.end = end;
+    rung.current = 0;
+    if (rung.buckets.size() < rung.nBuckets)
+    {
+      rung.buckets.resize(rung.nBuckets);
+    }
+    return rung;
+  }
+
+  // Moves the earliest events into the (empty) bottom.
+  void Refill()
+  {
+    m_bottom.clear();
+    m_bottomHead = 0;
+    while (m_size > 0)
+    {
+      if (m_nRungs == 0)
+      {
+        // Everything left is in the top: it becomes the first rung and
+        // the top starts again after its latest event.
+        NS_ASSERT(!m_top.empty());
+        m_topStart = m_topMax + 1;
+        Rung &rung = Spawn(m_topMin, m_topMax, m_topStart, m_top.size());
+        for (size_t i = 0; i < m_top.size(); i++)
+        {
+          rung.buckets[rung.BucketFor(m_top[i].key.m_ts)].push_back(m_top[i]);
+        }
+        m_top.clear();
+      }
+
+      Rung &rung = m_rungs[m_nRungs - 1];
+      while (rung.current < rung.nBuckets && rung.buckets[rung.current].empty())
+      {
+        rung.current++;
+      }
+      if (rung.current == rung.nBuckets)
+      {
+        m_nRungs--;
+        continue;
+      }
+
+      uint32_t b = rung.current++;
+      std::vector<Event> &bucket = rung.buckets[b];
+      uint64_t min = bucket[0].key.m_ts;
+      uint64_t max = min;
+      for (size_t i = 1; i < bucket.size(); i++)
+      {
+        min = std::min(min, bucket[i].key.m_ts);
+        max = std::max(max, bucket[i].key.m_ts);
+      }
+      if (bucket.size() > THRESHOLD && m_nRungs < MAX_RUNGS && min < max)
+      {
+        uint64_t end = rung.BucketEnd(b);
+        Rung &child = Spawn(min, max, end, bucket.size());
+        for (size_t i = 0; i < bucket.size(); i++)
+        {
+          child.buckets[child.BucketFor(bucket[i].key.m_ts)].push_back(bucket[i]);
+        }
+        bucket.clear();
+        continue;
+      }
+
+      // The bucket's storage and the bottom's are swapped, so both keep
+      // their capacity.
+      m_bottom.swap(bucket);
+      std::sort(m_bottom.begin(), m_bottom.end());
+      return;
+    }
+  }
+
+  static void Erase(std::vector<Event> &events, const Event &ev)
+  {
+    for (size_t i = 0; i < events.size(); i++)
+    {
+      if (events[i].key.m_uid == ev.key.m_uid)
+      {
+        events[i] = events.back();
+        events.pop_back();
+        return;
+      }
+    }
+    NS_ASSERT_MSG(false, "Event " << ev.key.m_uid << " is not scheduled");
+  }
+
+  std::vector<Event> m_top;
+  uint64_t m_topStart;
+  uint64_t m_topMin;
+  uint64_t m_topMax;
+  std::vector<Rung> m_rungs;
+  uint32_t m_nRungs;
+  std::vector<Event> m_bottom;
+  size_t m_bottomHead;
+  uint64_t m_size;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(LadderScheduler);
+
+// TypeId name of the scheduler UseScheduler chose last, for wrappers such
+// as MonitoredScheduler (live-monitor.h).
+inline std::string &CurrentSchedulerType()
+{
+  static std::string type = "ns3::MapScheduler";
+  return type;
+}
+
+// Makes the simulator use the named scheduler: map (the ns-3 default),
+// list, heap, calendar or ladder.  Call it before anything is scheduled,
+// and after choosing the simulator implementation.
+inline void UseScheduler(const std::string &name)
+{
+  std::string type;
+  if (name == "map")
+  {
+    type = "ns3::MapScheduler";
+  }
+  else if (name == "list")
+  {
+    type = "ns3::ListScheduler";
+  }
+  else if (name == "heap")
+  {
+    type = "ns3::HeapScheduler";
+  }
+  else if (name == "calendar")
+  {
+    type = "ns3::CalendarScheduler";
+  }
+  else if (name == "ladder")
+  {
+    type = "ns3::LadderScheduler";
+  }
+  else
+  {
+    NS_FATAL_ERROR("Unknown scheduler " << name << ", use map, list, heap, calendar or ladder");
+  }
+  CurrentSchedulerType() = type;
+  ObjectFactory factory;
+  factory.SetTypeId(type);
+  Simulator::SetScheduler(factory);
+}
+
+} // namespace ns3
+
+#endif /* LADDER_SCHEDULER_H */
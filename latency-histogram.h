@@ -0,0 +1,472 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/applications-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/csma-module.h"
+#include "ns3/wifi-module.h"
+#include "run-summary.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ns3 {
+
+// Latencies in nanoseconds, counted in log-linear buckets as in HdrHistogram:
+// values below 2^(bits+1) exactly, larger ones in 2^bits buckets per power
+// of two, so a bucket is at most 2^-bits of its values wide (0.8% for the
+// default 7 bits).  Memory is fixed by bits and the largest value; larger
+// values land in the last bucket.  Histograms with the same bits and
+// largest value merge by adding bucket counts.
+class LatencyHistogram
+{
+public:
+  LatencyHistogram(uint32_t bits = 7, uint64_t maxValue = 100000000000ull)
+    : m_bits(bits),
+      m_maxValue(maxValue),
+      m_counts(Index(maxValue, bits) + 1, 0),
+      m_count(0),
+      m_sum(0),
+      m_min(UINT64_MAX),
+      m_max(0)
+  {
+    NS_ABORT_MSG_UNLESS(bits >= 1 && bits <= 16, "LatencyHistogram needs 1 to 16 bits");
+  }
+
+  void Record(uint64_t value)
+  {
+    m_counts[std::min(Index(value, m_bits), uint32_t(m_counts.size() - 1))]++;
+    m_count++;
+    m_sum += value;
+    m_min = std::min(m_min, value);
+    m_max = std::max(m_max, value);
+  }
+
+  void Record(Time value)
+  {
+    Record(uint64_t(std::max<int64_t>(value.GetNanoSeconds(), 0)));
+  }
+
+  void Merge(const LatencyHistogram &other)
+  {
+    NS_ABORT_MSG_UNLESS(m_bits == other.m_bits && m_maxValue == other.m_maxValue,
+                        "Only histograms with the same bits and largest value merge");
+    for (size_t i = 0; i < m_counts.size(); i++)
+    {
+      m_counts[i] += other.m_counts[i];
+    }
+    m_count += other.m_count;
+    m_sum += other.m_sum;
+    m_min = std::min(m_min, other.m_min);
+    m_max = std::max(m_max, other.m_max);
+  }
+
+  // Adds count values of bucket (e.g. from a saved histogram), at the
+  // bucket's middle as far as the sum goes.
+  void AddBucket(uint32_t bucket, uint64_t count)
+  {
+    NS_ABORT_MSG_UNLESS(bucket < m_counts.size(), "Bucket " << bucket << " out of range");
+    m_counts[bucket] += count;
+    m_count += count;
+    m_sum += double(count) * GetMiddle(bucket);
+    m_min = std::min(m_min, GetLow(bucket));
+    m_max = std::max(m_max, GetLow(bucket) + GetWidth(bucket) - 1);
+  }
+
+  // Value at quantile q (0.5, 0.99, 0.999): the middle of its bucket,
+  // within the exact minimum and maximum.
+  uint64_t GetPercentile(double q) const
+  {
+    if (m_count == 0)
+    {
+      return 0;
+    }
+    uint64_t rank = std::max<uint64_t>(1, uint64_t(std::ceil(q * m_count)));
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < m_counts.size(); i++)
+    {
+      seen += m_counts[i];
+      if (seen >= rank)
+      {
+        return std::min(std::max(GetMiddle(i), m_min), m_max);
+      }
+    }
+    return m_max;
+  }
+
+  uint64_t GetCount() const
+  {
+    return m_count;
+  }
+
+  double GetMean() const
+  {
+    return m_count ? m_sum / m_count : 0.0;
+  }
+
+  uint64_t GetMin() const
+  {
+    return m_count ? m_min : 0;
+  }
+
+  uint64_t GetMax() const
+  {
+    return m_max;
+  }
+
+  uint32_t GetNBuckets() const
+  {
+    return m_counts.size();
+  }
+
+  uint64_t GetBucketCount(uint32_t bucket) const
+  {
+    return m_counts[bucket];
+  }
+
+  uint32_t GetBits() const
+  {
+    return m_bits;
+  }
+
+  uint64_t GetLow(uint32_t bucket) const
+  {
+    uint32_t half = 1u << m_bits;
+    if (bucket < 2 * half)
+    {
+      return bucket;
+    }
+    uint32_t shift = bucket / half - 1;
+    return uint64_t(bucket - shift * half) << shift;
+  }
+
+  uint64_t GetWidth(uint32_t bucket) const
+  {
+    uint32_t half = 1u << m_bits;
+    return bucket < 2 * half ? 1 : uint64_t(1) << (bucket / half - 1);
+  }
+
+  static uint32_t Index(uint64_t value, uint32_t bits)
+  {
+    if (value < (uint64_t(2) << bits))
+    {
+      return value;
+    }
+    uint32_t shift = 63 - __builtin_clzll(value) - bits;
+    return (shift << bits) + uint32_t(value >> shift);
+  }
+
+private:
+  uint64_t GetMiddle(uint32_t bucket) const
+  {
+    return GetLow(bucket) + (GetWidth(bucket) - 1) / 2;
+  }
+
+  uint32_t m_bits;
+  uint64_t m_maxValue;
+  std::vector<uint64_t> m_counts;
+  uint64_t m_count;
+  double m_sum;
+  uint64_t m_min;
+  uint64_t m_max;
+};
+
+// Latency histograms fed straight from trace sources:
+//
+//   rtt    per echo client, request sent (Tx) to reply received (Rx),
+//          replies matched to requests by packet uid as in RunSummary
+//   queue  per device, time in the device queue: Enqueue to Dequeue of
+//          the point-to-point and CSMA queues (both FIFO), and from the
+//          queue item's timestamp to Dequeue of the Wi-Fi MAC queues
+//
+// Recording costs a bucket increment.  Write gives percentiles per
+// histogram in <prefix>-latency.csv and the non-empty buckets in
+// <prefix>-latency-buckets.csv, which Load adds back, so runs can be
+// merged.
+class LatencyMonitor
+{
+public:
+  LatencyMonitor(uint32_t bits = 7)
+    : m_bits(bits)
+  {
+  }
+
+  // Names used for the node's histograms instead of n<id>.
+  void NameNode(Ptr<Node> node, const std::string &name)
+  {
+    m_names[node->GetId()] = name;
+  }
+
+  void TrackEchoClients(const ApplicationContainer &clients)
+  {
+    for (uint32_t i = 0; i < clients.GetN(); i++)
+    {
+      Ptr<Application> app = clients.Get(i);
+      AddressValue remote;
+      app->GetAttribute("RemoteAddress", remote);
+      std::ostringstream name;
+      name << NodeName(app->GetNode()) << "->";
+      if (Ipv4Address::IsMatchingType(remote.Get()))
+      {
+        name << Ipv4Address::ConvertFrom(remote.Get());
+      }
+      else if (InetSocketAddress::IsMatchingType(remote.Get()))
+      {
+        name << InetSocketAddress::ConvertFrom(remote.Get()).GetIpv4();
+      }
+      else
+      {
+        name << "app" << i;
+      }
+      m_echoes.push_back(Echoes(&Get("rtt", name.str())));
+      app->TraceConnectWithoutContext("Tx", MakeBoundCallback(&LatencyMonitor::EchoSent, &m_echoes.back()));
+      app->TraceConnectWithoutContext("Rx", MakeBoundCallback(&LatencyMonitor::EchoReceived, &m_echoes.back()));
+    }
+  }
+
+  void TrackDevices(const NetDeviceContainer &devices)
+  {
+    for (uint32_t i = 0; i < devices.GetN(); i++)
+    {
+      TrackDevice(devices.Get(i));
+    }
+  }
+
+  // Every device of the nodes.
+  void TrackNodes(const NodeContainer &nodes)
+  {
+    for (uint32_t i = 0; i < nodes.GetN(); i++)
+    {
+      for (uint32_t d = 0; d < nodes.Get(i)->GetNDevices(); d++)
+      {
+        TrackDevice(nodes.Get(i)->GetDevice(d));
+      }
+    }
+  }
+
+  void TrackDevice(Ptr<NetDevice> device)
+  {
+    std::ostringstream name;
+    name << NodeName(device->GetNode()) << "/" << device->GetIfIndex();
+    Ptr<PointToPointNetDevice> p2p = DynamicCast<PointToPointNetDevice>(device);
+    Ptr<CsmaNetDevice> csma = DynamicCast<CsmaNetDevice>(device);
+    Ptr<Queue<Packet> > queue;
+    if (p2p)
+    {
+      queue = p2p->GetQueue();
+    }
+    else if (csma)
+    {
+      queue = csma->GetQueue();
+    }
+    if (queue)
+    {
+      m_queues.push_back(Pending(&Get("queue", name.str())));
+      queue->TraceConnectWithoutContext("Enqueue", MakeBoundCallback(&LatencyMonitor::Start, &m_queues.back()));
+      queue->TraceConnectWithoutContext("Dequeue", MakeBoundCallback(&LatencyMonitor::Finish, &m_queues.back()));
+      return;
+    }
+    Ptr<WifiNetDevice> wifi = DynamicCast<WifiNetDevice>(device);
+    if (!wifi)
+    {
+      return;
+    }
+    // The DCF queue, and the four EDCA queues of a QoS MAC.
+    static const char *txops[] = {"Txop", "BE_Txop", "BK_Txop", "VI_Txop", "VO_Txop"};
+    LatencyHistogram *histogram = &Get("queue", name.str());
+    for (uint32_t i = 0; i < sizeof(txops) / sizeof(txops[0]); i++)
+    {
+      PointerValue txop;
+      if (wifi->GetMac()->GetAttributeFailSafe(txops[i], txop) && txop.Get<Txop>())
+      {
+        txop.Get<Txop>()->GetWifiMacQueue()->TraceConnectWithoutContext(
+            "Dequeue", MakeBoundCallback(&LatencyMonitor::WifiDequeue, histogram));
+      }
+    }
+  }
+
+  // The histogram of kind and name, created empty if need be.
+  LatencyHistogram &Get(const std::string &kind, const std::string &name)
+  {
+    std::pair<std::string, std::string> key(kind, name);
+    std::map<std::pair<std::string, std::string>, LatencyHistogram>::iterator it = m_histograms.find(key);
+    if (it == m_histograms.end())
+    {
+      it = m_histograms.insert(std::make_pair(key, LatencyHistogram(m_bits))).first;
+    }
+    return it->second;
+  }
+
+  void Write(const std::string &prefix) const
+  {
+    std::ofstream out((prefix + "-latency.csv").c_str());
+    NS_ABORT_MSG_UNLESS(out.is_open(), "Cannot write " << prefix << "-latency.csv");
+    out.precision(9);
+    out << "kind,name,count,min_ms,mean_ms,p50_ms,p99_ms,p999_ms,max_ms\n";
+    std::map<std::pair<std::string, std::string>, LatencyHistogram>::const_iterator it;
+    for (it = m_histograms.begin(); it != m_histograms.end(); it++)
+    {
+      const LatencyHistogram &h = it->second;
+      out << it->first.first << "," << it->first.second << "," << h.GetCount() << "," << h.GetMin() / 1e6 << ","
+          << h.GetMean() / 1e6 << "," << h.GetPercentile(0.5) / 1e6 << "," << h.GetPercentile(0.99) / 1e6 << ","
+          << h.GetPercentile(0.999) / 1e6 << "," << h.GetMax() / 1e6 << "\n";
+    }
+
+    std::ofstream buckets((prefix + "-latency-buckets.csv").c_str());
+    NS_ABORT_MSG_UNLESS(buckets.is_open(), "Cannot write " << prefix << "-latency-buckets.csv");
+    buckets << "kind,name,bits,bucket,low_ns,count\n";
+    for (it = m_histograms.begin(); it != m_histograms.end(); it++)
+    {
+      const LatencyHistogram &h = it->second;
+      for (uint32_t b = 0; b < h.GetNBuckets(); b++)
+      {
+        if (h.GetBucketCount(b))
+        {
+          buckets << it->first.first << "," << it->first.second << "," << h.GetBits() << "," << b << ","
+                  << h.GetLow(b) << "," << h.GetBucketCount(b) << "\n";
+        }
+      }
+    }
+  }
+
+  // Adds the buckets of a -latency-buckets.csv written by Write.
+  void Load(const std::string &path)
+  {
+    std::ifstream in(path.c_str());
+    NS_ABORT_MSG_UNLESS(in.is_open(), "Cannot read " << path);
+    std::string line;
+    std::getline(in, line);
+    while (std::getline(in, line))
+    {
+      std::vector<std::string> fields;
+      std::stringstream ss(line);
+      std::string field;
+      while (std::getline(ss, field, ','))
+      {
+        fields.push_back(field);
+      }
+      NS_ABORT_MSG_UNLESS(fields.size() == 6, path << ": bad line " << line);
+      NS_ABORT_MSG_UNLESS(std::stoul(fields[2]) == m_bits, path << " has histograms of " << fields[2] << " bits");
+      Get(fields[0], fields[1]).AddBucket(std::stoul(fields[3]), std::stoull(fields[5]));
+    }
+  }
+
+  // Adds rtt_p50_ms, rtt_p99_ms, rtt_p999_ms and queue_p99_ms,
+  // queue_p999_ms over all histograms of each kind.
+  void Summarize(RunSummary &summary) const
+  {
+    LatencyHistogram rtt(m_bits);
+    LatencyHistogram queue(m_bits);
+    std::map<std::pair<std::string, std::string>, LatencyHistogram>::const_iterator it;
+    for (it = m_histograms.begin(); it != m_histograms.end(); it++)
+    {
+      (it->first.first == "rtt" ? rtt : queue).Merge(it->second);
+    }
+    summary.Set("rtt_p50_ms", rtt.GetPercentile(0.5) / 1e6);
+    summary.Set("rtt_p99_ms", rtt.GetPercentile(0.99) / 1e6);
+    summary.Set("rtt_p999_ms", rtt.GetPercentile(0.999) / 1e6);
+    summary.Set("queue_p99_ms", queue.GetPercentile(0.99) / 1e6);
+    summary.Set("queue_p999_ms", queue.GetPercentile(0.999) / 1e6);
+  }
+
+private:
+  // Start times of what is still outstanding, oldest first.
+  struct Pending
+  {
+    Pending(LatencyHistogram *h)
+      : histogram(h)
+    {
+    }
+
+    LatencyHistogram *histogram;
+    std::deque<Time> times;
+  };
+
+  // Send times of the echo requests not answered yet, by packet uid (the
+  // server sends the request packet back).
+  struct Echoes
+  {
+    Echoes(LatencyHistogram *h)
+      : histogram(h)
+    {
+    }
+
+    LatencyHistogram *histogram;
+    std::map<uint64_t, Time> times;
+  };
+
+  std::string NodeName(Ptr<Node> node) const
+  {
+    std::map<uint32_t, std::string>::const_iterator it = m_names.find(node->GetId());
+    return it != m_names.end() ? it->second : "n" + std::to_string(node->GetId());
+  }
+
+  static void Start(Pending *pending, Ptr<const Packet> packet)
+  {
+    pending->times.push_back(Simulator::Now());
+  }
+
+  static void Finish(Pending *pending, Ptr<const Packet> packet)
+  {
+    if (!pending->times.empty())
+    {
+      pending->histogram->Record(Simulator::Now() - pending->times.front());
+      pending->times.pop_front();
+    }
+  }
+
+  static void EchoSent(Echoes *echoes, Ptr<const Packet> packet)
+  {
+    echoes->times[packet->GetUid()] = Simulator::Now();
+  }
+
+  static void EchoReceived(Echoes *echoes, Ptr<const Packet> packet)
+  {
+    std::map<uint64_t, Time>::iterator it = echoes->times.find(packet->GetUid());
+    if (it != echoes->times.end())
+    {
+      echoes->histogram->Record(Simulator::Now() - it->second);
+      echoes->times.erase(it);
+    }
+  }
+
+  static void WifiDequeue(LatencyHistogram *histogram, Ptr<const WifiMacQueueItem> item)
+  {
+    histogram->Record(Simulator::Now() - item->GetTimeStamp());
+  }
+
+  uint32_t m_bits;
+  std::map<uint32_t, std::string> m_names;
+  std::map<std::pair<std::string, std::string>, LatencyHistogram> m_histograms;
+  std::deque<Echoes> m_echoes; // deques keep the elements' addresses
+  std::deque<Pending> m_queues;
+};
+
+} // namespace ns3
+
+#endif /* LATENCY_HISTOGRAM_H */
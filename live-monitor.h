@@ -0,0 +1,537 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef LIVE_MONITOR_H
+#define LIVE_MONITOR_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/applications-module.h"
+#include "ladder-scheduler.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <poll.h>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+namespace ns3 {
+
+// Progress of the simulator thread, published every few thousand events
+// and read by the monitor thread without a lock: a sequence lock whose
+// writer never waits, and whose reader retries while a write is under way.
+class LiveBoard
+{
+public:
+  struct Snapshot
+  {
+    uint64_t simTime; // in Time resolution units
+    uint64_t events;
+    uint64_t queued;
+    uint64_t wall; // steady clock, ns
+  };
+
+  LiveBoard()
+    : m_seq(0),
+      m_simTime(0),
+      m_events(0),
+      m_queued(0),
+      m_wall(0)
+  {
+  }
+
+  // The board MonitoredScheduler publishes to, or null.
+  static std::atomic<LiveBoard *> &Current()
+  {
+    static std::atomic<LiveBoard *> current(0);
+    return current;
+  }
+
+  static uint64_t Now()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  // Simulator thread only.
+  void Publish(uint64_t simTime, uint64_t events, uint64_t queued)
+  {
+    uint32_t seq = m_seq.load(std::memory_order_relaxed);
+    m_seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_simTime.store(simTime, std::memory_order_relaxed);
+    m_events.store(events, std::memory_order_relaxed);
+    m_queued.store(queued, std::memory_order_relaxed);
+    m_wall.store(Now(), std::memory_order_relaxed);
+    m_seq.store(seq + 2, std::memory_order_release);
+  }
+
+  Snapshot Read() const
+  {
+    Snapshot snapshot;
+    while (true)
+    {
+      uint32_t seq = m_seq.load(std::memory_order_acquire);
+      if (seq & 1)
+      {
+        std::this_thread::yield();
+        continue;
+      }
+      snapshot.simTime = m_simTime.load(std::memory_order_relaxed);
+      snapshot.events = m_events.load(std::memory_order_relaxed);
+      snapshot.queued = m_queued.load(std::memory_order_relaxed);
+      snapshot.wall = m_wall.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (m_seq.load(std::memory_order_relaxed) == seq)
+      {
+        return snapshot;
+      }
+    }
+  }
+
+private:
+  std::atomic<uint32_t> m_seq;
+  std::atomic<uint64_t> m_simTime;
+  std::atomic<uint64_t> m_events;
+  std::atomic<uint64_t> m_queued;
+  std::atomic<uint64_t> m_wall;
+};
+
+// Scheduler that hands every call to the one named by Inner and counts
+// the queued events.  Every PublishEvery events it removes, it publishes
+// the time of the next event, the executed events and the queue length
+// to the current LiveBoard: a counter test per event, a few stores every
+// PublishEvery events.
+class MonitoredScheduler : public Scheduler
+{
+public:
+  static TypeId GetTypeId(void)
+  {
+    static TypeId tid =
+        TypeId("ns3::MonitoredScheduler")
+            .SetParent<Scheduler>()
+            .SetGroupName("Core")
+            .AddConstructor<MonitoredScheduler>()
+            .AddAttribute("Inner", "TypeId name of the scheduler doing the work.",
+                          TypeId::ATTR_SET | TypeId::ATTR_CONSTRUCT, StringValue("ns3::MapScheduler"),
+                          MakeStringAccessor(&MonitoredScheduler::SetInner), MakeStringChecker())
+            .AddAttribute("PublishEvery", "Events between two publications.", UintegerValue(4096),
+                          MakeUintegerAccessor(&MonitoredScheduler::m_publishEvery),
+                          MakeUintegerChecker<uint32_t>(1));
+    return tid;
+  }
+
+  MonitoredScheduler()
+    : m_publishEvery(4096),
+      m_countdown(1),
+      m_size(0)
+  {
+  }
+
+  virtual void Insert(const Event &ev)
+  {
+    m_size++;
+    m_inner->Insert(ev);
+  }
+
+  virtual bool IsEmpty(void) const
+  {
+    return m_inner->IsEmpty();
+  }
+
+  virtual Event PeekNext(void) const
+  {
+    return m_inner->PeekNext();
+  }
+
+  virtual Event RemoveNext(void)
+  {
+    Event ev = m_inner->RemoveNext();
+    m_size--;
+    if (--m_countdown == 0)
+    {
+      m_countdown = m_publishEvery;
+      LiveBoard *board = LiveBoard::Current().load(std::memory_order_acquire);
+      if (board)
+      {
+        board->Publish(ev.key.m_ts, Simulator::GetEventCount(), m_size);
+      }
+    }
+    return ev;
+  }
+
+  virtual void Remove(const Event &ev)
+  {
+    m_size--;
+    m_inner->Remove(ev);
+  }
+
+private:
+  void SetInner(std::string type)
+  {
+    ObjectFactory factory;
+    factory.SetTypeId(type);
+    m_inner = factory.Create<Scheduler>();
+  }
+
+  Ptr<Scheduler> m_inner;
+  uint32_t m_publishEvery;
+  uint32_t m_countdown;
+  uint64_t m_size;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(MonitoredScheduler);
+
+// Answers queries about a running simulation on a Unix domain socket.
+//
+// Open() wraps the scheduler UseScheduler chose in a MonitoredScheduler
+// and starts a thread that serves one query per connection: the client
+// writes a command line and reads the answer until the socket closes.
+//
+//   status  sim_time_s, events, queue, events_per_s (over the last
+//           second), events_per_s_mean, sim_per_wall, wall_s, stale_s
+//           (wall seconds since the simulator last published), rss_mb,
+//           peak_rss_mb and flows, one "name value" per line
+//   flows   one "flow <kind> <label> <tx> <rx>" line per tracked flow
+//   all     both (also what an empty command gets)
+//
+// The simulator thread only bumps the per-flow counters, with relaxed
+// stores it alone makes, and publishes through the LiveBoard; it never
+// waits for the monitor.  Track flows before Open(), which fixes the
+// list the thread reads.  MonitorClient prints the answers.
+class LiveMonitor
+{
+public:
+  LiveMonitor()
+    : m_listen(-1),
+      m_publishEvery(4096),
+      m_stop(false)
+  {
+  }
+
+  ~LiveMonitor()
+  {
+    Close();
+  }
+
+  // Names used in flow labels instead of n<id>.
+  void NameNode(Ptr<Node> node, const std::string &name)
+  {
+    m_names[node->GetId()] = name;
+  }
+
+  void SetPublishEvery(uint32_t events)
+  {
+    m_publishEvery = events;
+  }
+
+  // Echo requests sent and replies received per client.
+  void TrackEchoClients(const ApplicationContainer &clients)
+  {
+    NS_ABORT_MSG_IF(m_thread.joinable(), "Track flows before opening the live monitor");
+    for (uint32_t i = 0; i < clients.GetN(); i++)
+    {
+      Ptr<Application> app = clients.Get(i);
+      AddressValue remote;
+      UintegerValue port;
+      app->GetAttribute("RemoteAddress", remote);
+      app->GetAttribute("RemotePort", port);
+      std::ostringstream label;
+      label << NodeName(app->GetNode()) << "->";
+      if (Ipv4Address::IsMatchingType(remote.Get()))
+      {
+        label << Ipv4Address::ConvertFrom(remote.Get());
+      }
+      label << ":" << port.Get();
+      Flow *flow = AddFlow("echo", label.str());
+      app->TraceConnectWithoutContext("Tx", MakeBoundCallback(&LiveMonitor::Sent, flow));
+      app->TraceConnectWithoutContext("Rx", MakeBoundCallback(&LiveMonitor::Received, flow));
+    }
+  }
+
+  // Packets sent by load generators (WorkloadApplication, BulkSend).
+  void TrackLoads(const ApplicationContainer &loads)
+  {
+    NS_ABORT_MSG_IF(m_thread.joinable(), "Track flows before opening the live monitor");
+    for (uint32_t i = 0; i < loads.GetN(); i++)
+    {
+      Ptr<Application> app = loads.Get(i);
+      AddressValue remote;
+      app->GetAttribute("Remote", remote);
+      std::ostringstream label;
+      label << NodeName(app->GetNode()) << "->";
+      if (InetSocketAddress::IsMatchingType(remote.Get()))
+      {
+        InetSocketAddress inet = InetSocketAddress::ConvertFrom(remote.Get());
+        label << inet.GetIpv4() << ":" << inet.GetPort();
+      }
+      Flow *flow = AddFlow("load", label.str());
+      app->TraceConnectWithoutContext("Tx", MakeBoundCallback(&LiveMonitor::Sent, flow));
+    }
+  }
+
+  // Packets received by packet sinks.
+  void TrackSinks(const ApplicationContainer &sinks)
+  {
+    NS_ABORT_MSG_IF(m_thread.joinable(), "Track flows before opening the live monitor");
+    for (uint32_t i = 0; i < sinks.GetN(); i++)
+    {
+      Ptr<Application> app = sinks.Get(i);
+      AddressValue local;
+      app->GetAttribute("Local", local);
+      std::ostringstream label;
+      label << NodeName(app->GetNode());
+      if (InetSocketAddress::IsMatchingType(local.Get()))
+      {
+        label << ":" << InetSocketAddress::ConvertFrom(local.Get()).GetPort();
+      }
+      Flow *flow = AddFlow("sink", label.str());
+      app->TraceConnectWithoutContext("Rx", MakeBoundCallback(&LiveMonitor::SinkReceived, flow));
+    }
+  }
+
+  // Listens on path, replacing a stale socket file left there.
+  void Open(const std::string &path)
+  {
+    NS_ABORT_MSG_IF(m_thread.joinable(), "Live monitor already open");
+    sockaddr_un address;
+    NS_ABORT_MSG_IF(path.size() >= sizeof(address.sun_path), "Socket path too long: " << path);
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    m_listen = socket(AF_UNIX, SOCK_STREAM, 0);
+    NS_ABORT_MSG_IF(m_listen < 0, "socket failed: " << std::strerror(errno));
+    unlink(path.c_str());
+    NS_ABORT_MSG_IF(bind(m_listen, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0,
+                    "Cannot bind " << path << ": " << std::strerror(errno));
+    NS_ABORT_MSG_IF(listen(m_listen, 8) != 0, "listen failed: " << std::strerror(errno));
+    m_path = path;
+
+    ObjectFactory factory;
+    factory.SetTypeId("ns3::MonitoredScheduler");
+    factory.Set("Inner", StringValue(CurrentSchedulerType()));
+    factory.Set("PublishEvery", UintegerValue(m_publishEvery));
+    Simulator::SetScheduler(factory);
+
+    m_start = LiveBoard::Now();
+    m_board.Publish(Simulator::Now().GetTimeStep(), Simulator::GetEventCount(), 0);
+    LiveBoard::Current().store(&m_board, std::memory_order_release);
+    m_stop = false;
+    m_thread = std::thread(&LiveMonitor::Serve, this);
+  }
+
+  void Close()
+  {
+    if (!m_thread.joinable())
+    {
+      return;
+    }
+    m_stop = true;
+    m_thread.join();
+    LiveBoard::Current().store(0, std::memory_order_release);
+    close(m_listen);
+    m_listen = -1;
+    unlink(m_path.c_str());
+  }
+
+private:
+  struct Flow
+  {
+    std::string kind;
+    std::string label;
+    std::atomic<uint64_t> tx;
+    std::atomic<uint64_t> rx;
+  };
+
+  std::string NodeName(Ptr<Node> node) const
+  {
+    std::map<uint32_t, std::string>::const_iterator it = m_names.find(node->GetId());
+    return it != m_names.end() ? it->second : "n" + std::to_string(node->GetId());
+  }
+
+  Flow *AddFlow(const std::string &kind, const std::string &label)
+  {
+    m_flows.emplace_back();
+    Flow &flow = m_flows.back();
+    flow.kind = kind;
+    flow.label = label;
+    flow.tx.store(0, std::memory_order_relaxed);
+    flow.rx.store(0, std::memory_order_relaxed);
+    return &flow;
+  }
+
+  // Only the simulator thread writes the counters: no read-modify-write.
+  static void Bump(std::atomic<uint64_t> &counter)
+  {
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+  static void Sent(Flow *flow, Ptr<const Packet> packet)
+  {
+    Bump(flow->tx);
+  }
+
+  static void Received(Flow *flow, Ptr<const Packet> packet)
+  {
+    Bump(flow->rx);
+  }
+
+  static void SinkReceived(Flow *flow, Ptr<const Packet> packet, const Address &from)
+  {
+    Bump(flow->rx);
+  }
+
+  static double GetRss()
+  {
+    long pages = 0;
+    FILE *statm = std::fopen("/proc/self/statm", "r");
+    if (statm)
+    {
+      long size = 0;
+      if (std::fscanf(statm, "%ld %ld", &size, &pages) != 2)
+      {
+        pages = 0;
+      }
+      std::fclose(statm);
+    }
+    return double(pages) * sysconf(_SC_PAGESIZE);
+  }
+
+  // Monitor thread: samples the event rate once a second and answers
+  // one connection at a time.
+  void Serve()
+  {
+    LiveBoard::Snapshot last = m_board.Read();
+    uint64_t lastSample = LiveBoard::Now();
+    double rate = 0;
+    while (!m_stop)
+    {
+      pollfd pfd;
+      pfd.fd = m_listen;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+      int ready = poll(&pfd, 1, 200);
+
+      uint64_t now = LiveBoard::Now();
+      if (now - lastSample >= 1000000000ULL)
+      {
+        LiveBoard::Snapshot snapshot = m_board.Read();
+        rate = (snapshot.events - last.events) / ((now - lastSample) / 1e9);
+        last = snapshot;
+        lastSample = now;
+      }
+      if (ready <= 0 || !(pfd.revents & POLLIN))
+      {
+        continue;
+      }
+      int fd = accept(m_listen, 0, 0);
+      if (fd < 0)
+      {
+        continue;
+      }
+      timeval timeout = {1, 0};
+      setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+      setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+      std::string command = ReadCommand(fd);
+      std::string answer = Answer(command, rate);
+      for (size_t done = 0; done < answer.size();)
+      {
+        ssize_t n = send(fd, answer.data() + done, answer.size() - done, MSG_NOSIGNAL);
+        if (n <= 0)
+        {
+          break;
+        }
+        done += n;
+      }
+      close(fd);
+    }
+  }
+
+  static std::string ReadCommand(int fd)
+  {
+    std::string command;
+    char c;
+    while (command.size() < 64 && recv(fd, &c, 1, 0) == 1 && c != '\n')
+    {
+      command += c;
+    }
+    return command.empty() ? "all" : command;
+  }
+
+  std::string Answer(const std::string &command, double rate) const
+  {
+    std::ostringstream out;
+    out.precision(9);
+    if (command != "status" && command != "flows" && command != "all")
+    {
+      out << "error unknown command " << command << ", use status, flows or all\n";
+      return out.str();
+    }
+    if (command != "flows")
+    {
+      LiveBoard::Snapshot snapshot = m_board.Read();
+      uint64_t now = LiveBoard::Now();
+      double wall = (now - m_start) / 1e9;
+      double sim = TimeStep(snapshot.simTime).GetSeconds();
+      struct rusage usage;
+      getrusage(RUSAGE_SELF, &usage);
+      out << "sim_time_s " << sim << "\n"
+          << "events " << snapshot.events << "\n"
+          << "queue " << snapshot.queued << "\n"
+          << "events_per_s " << rate << "\n"
+          << "events_per_s_mean " << (wall > 0 ? snapshot.events / wall : 0.0) << "\n"
+          << "sim_per_wall " << (wall > 0 ? sim / wall : 0.0) << "\n"
+          << "wall_s " << wall << "\n"
+          << "stale_s " << (now > snapshot.wall ? (now - snapshot.wall) / 1e9 : 0.0) << "\n"
+          << "rss_mb " << GetRss() / 1048576.0 << "\n"
+          << "peak_rss_mb " << usage.ru_maxrss / 1024.0 << "\n"
+          << "flows " << m_flows.size() << "\n";
+    }
+    if (command != "status")
+    {
+      for (std::deque<Flow>::const_iterator it = m_flows.begin(); it != m_flows.end(); it++)
+      {
+        out << "flow " << it->kind << " " << it->label << " " << it->tx.load(std::memory_order_relaxed) << " "
+            << it->rx.load(std::memory_order_relaxed) << "\n";
+      }
+    }
+    return out.str();
+  }
+
+  std::map<uint32_t, std::string> m_names;
+  std::deque<Flow> m_flows; // a deque, so flows never move
+  LiveBoard m_board;
+  std::string m_path;
+  int m_listen;
+  uint32_t m_publishEvery;
+  uint64_t m_start;
+  std::atomic<bool> m_stop;
+  std::thread m_thread;
+};
+
+} // namespace ns3
+
+#endif /* LIVE_MONITOR_H */
@@ -0,0 +1,403 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef PCAPNG_WRITER_H
+#define PCAPNG_WRITER_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/point-to-point-net-device.h"
+#include "ns3/csma-net-device.h"
+#include "ns3/wifi-net-device.h"
+#include "ns3/wifi-phy.h"
+#include "compressed-stream.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace ns3 {
+
+// Writes the packets of many devices into one PCAP-NG file, one interface
+// block per device, instead of one pcap file per device.
+//
+// The simulator thread only copies each packet (up to the snap length)
+// into a single-producer/single-consumer ring.  A background thread turns
+// the records into PCAP-NG blocks and writes them, compressed when the
+// file name ends in .gz or .zst (see compressed-stream.h).  When the
+// ring is full the simulator waits for the writer, so no packet is lost.
+//
+// Devices are hooked the way EnablePcap(..., promiscuous=true) would:
+// point-to-point and CSMA through PromiscSniffer, Wi-Fi through the PHY's
+// PhyTxBegin/PhyRxEnd.  Timestamps have nanosecond resolution.
+class PcapNgWriter
+{
+public:
+  static const uint16_t LINKTYPE_ETHERNET = 1;
+  static const uint16_t LINKTYPE_PPP = 9;
+  static const uint16_t LINKTYPE_IEEE802_11 = 105;
+
+  PcapNgWriter()
+    : m_snaplen(65535),
+      m_head(0),
+      m_tail(0),
+      m_stop(false),
+      m_open(false),
+      m_records(0),
+      m_stalls(0),
+      m_written(0)
+  {
+  }
+
+  ~PcapNgWriter()
+  {
+    Close();
+  }
+
+  // A snap length of 0 keeps whole packets.  The ring must hold at least
+  // two maximum-size records.
+  void Open(const std::string &path, uint32_t snaplen = 0, uint32_t ringBytes = 32 << 20)
+  {
+    NS_ABORT_MSG_IF(m_open, "PcapNgWriter is already open");
+    m_snaplen = snaplen ? snaplen : 65535;
+    uint64_t words = (uint64_t(ringBytes) + 7) / 8;
+    NS_ABORT_MSG_IF(words * 8 < 2 * Align(sizeof(Record) + m_snaplen),
+                    "PCAP-NG ring of " << ringBytes << " bytes is too small for snaplen " << m_snaplen);
+    m_ring.assign(words, 0);
+    m_head.store(0);
+    m_tail.store(0);
+    m_stop.store(false);
+    m_stream.Open(path);
+    WriteSectionHeader();
+    m_open = true;
+    m_thread = std::thread(&PcapNgWriter::Drain, this);
+  }
+
+  // Waits for the writer thread to empty the ring and closes the file.
+  void Close()
+  {
+    if (!m_open)
+    {
+      return;
+    }
+    m_open = false;
+    m_stop.store(true, std::memory_order_release);
+    m_thread.join();
+    m_stream.Close();
+  }
+
+  bool IsOpen() const
+  {
+    return m_open;
+  }
+
+  // Registers an interface; the returned id goes into Capture.
+  uint32_t AddInterface(const std::string &name, uint16_t linkType)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_interfaces.push_back(std::make_pair(name, linkType));
+    return m_interfaces.size() - 1;
+  }
+
+  // Hooks a device; devices of other types (e.g. loopback) are skipped.
+  void AddDevice(Ptr<NetDevice> device)
+  {
+    std::ostringstream name;
+    name << "node" << device->GetNode()->GetId() << "-dev" << device->GetIfIndex();
+    if (DynamicCast<PointToPointNetDevice>(device))
+    {
+      uint32_t id = AddInterface(name.str(), LINKTYPE_PPP);
+      device->TraceConnectWithoutContext("PromiscSniffer", MakeBoundCallback(&PcapNgWriter::Sniff, this, id));
+    }
+    else if (DynamicCast<CsmaNetDevice>(device))
+    {
+      uint32_t id = AddInterface(name.str(), LINKTYPE_ETHERNET);
+      device->TraceConnectWithoutContext("PromiscSniffer", MakeBoundCallback(&PcapNgWriter::Sniff, this, id));
+    }
+    else if (Ptr<WifiNetDevice> wifi = DynamicCast<WifiNetDevice>(device))
+    {
+      uint32_t id = AddInterface(name.str(), LINKTYPE_IEEE802_11);
+      Ptr<WifiPhy> phy = wifi->GetPhy();
+      phy->TraceConnectWithoutContext("PhyTxBegin", MakeBoundCallback(&PcapNgWriter::SniffTx, this, id));
+      phy->TraceConnectWithoutContext("PhyRxEnd", MakeBoundCallback(&PcapNgWriter::Sniff, this, id));
+    }
+  }
+
+  void AddDevices(const NetDeviceContainer &devices)
+  {
+    for (uint32_t i = 0; i < devices.GetN(); i++)
+    {
+      AddDevice(devices.Get(i));
+    }
+  }
+
+  void AddNodes(const NodeContainer &nodes)
+  {
+    for (uint32_t i = 0; i < nodes.GetN(); i++)
+    {
+      for (uint32_t d = 0; d < nodes.Get(i)->GetNDevices(); d++)
+      {
+        AddDevice(nodes.Get(i)->GetDevice(d));
+      }
+    }
+  }
+
+  // Copies one packet into the ring; runs on the simulator thread.
+  void Capture(uint32_t interface, Ptr<const Packet> packet)
+  {
+    if (!m_open)
+    {
+      return;
+    }
+    uint32_t size = packet->GetSize();
+    uint32_t captured = std::min(size, m_snaplen);
+    uint64_t need = Align(sizeof(Record) + captured);
+    uint64_t capacity = m_ring.size() * 8;
+    uint64_t head = m_head.load(std::memory_order_relaxed);
+    uint64_t pos = head % capacity;
+    uint64_t skip = capacity - pos < need ? capacity - pos : 0;
+    WaitForSpace(head, skip + need);
+
+    uint8_t *base = reinterpret_cast<uint8_t *>(&m_ring[0]);
+    if (skip)
+    {
+      // Records never wrap; a zero length tells the reader to go back
+      // to the start of the ring.
+      reinterpret_cast<Record *>(base + pos)->length = 0;
+      head += skip;
+      pos = 0;
+    }
+    Record *record = reinterpret_cast<Record *>(base + pos);
+    record->length = need;
+    record->interface = interface;
+    record->time = Simulator::Now().GetNanoSeconds();
+    record->captured = captured;
+    record->original = size;
+    packet->CopyData(base + pos + sizeof(Record), captured);
+    m_head.store(head + need, std::memory_order_release);
+    m_records++;
+  }
+
+  uint64_t GetRecords() const
+  {
+    return m_records;
+  }
+
+  // Number of packets that had to wait for the writer thread.
+  uint64_t GetStalls() const
+  {
+    return m_stalls;
+  }
+
+private:
+  struct Record
+  {
+    uint32_t length; // bytes taken in the ring, header included
+    uint32_t interface;
+    int64_t time;
+    uint32_t captured;
+    uint32_t original;
+  };
+
+  static void Sniff(PcapNgWriter *writer, uint32_t interface, Ptr<const Packet> packet)
+  {
+    writer->Capture(interface, packet);
+  }
+
+  static void SniffTx(PcapNgWriter *writer, uint32_t interface, Ptr<const Packet> packet, double txPowerW)
+  {
+    writer->Capture(interface, packet);
+  }
+
+  static uint64_t Align(uint64_t bytes)
+  {
+    return (bytes + 7) & ~uint64_t(7);
+  }
+
+  void WaitForSpace(uint64_t head, uint64_t bytes)
+  {
+    uint64_t capacity = m_ring.size() * 8;
+    if (head + bytes - m_tail.load(std::memory_order_acquire) <= capacity)
+    {
+      return;
+    }
+    m_stalls++;
+    while (head + bytes - m_tail.load(std::memory_order_acquire) > capacity)
+    {
+      std::this_thread::yield();
+    }
+  }
+
+  // Writer thread: turns ring records into blocks until Close.
+  void Drain()
+  {
+    uint64_t capacity = m_ring.size() * 8;
+    const uint8_t *base = reinterpret_cast<const uint8_t *>(&m_ring[0]);
+    uint64_t tail = m_tail.load(std::memory_order_relaxed);
+    while (true)
+    {
+      uint64_t head = m_head.load(std::memory_order_acquire);
+      if (head == tail)
+      {
+        if (m_stop.load(std::memory_order_acquire))
+        {
+          if (m_head.load(std::memory_order_acquire) == tail)
+          {
+            break;
+          }
+          continue;
+        }
+        Flush();
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        continue;
+      }
+
+      // Interfaces are registered before their first packet is pushed.
+      WriteInterfaceBlocks();
+      while (tail != head)
+      {
+        uint64_t pos = tail % capacity;
+        const Record *record = reinterpret_cast<const Record *>(base + pos);
+        if (capacity - pos < sizeof(Record) || record->length == 0)
+        {
+          tail += capacity - pos;
+          continue;
+        }
+        WritePacketBlock(*record, base + pos + sizeof(Record));
+        tail += record->length;
+      }
+      m_tail.store(tail, std::memory_order_release);
+      if (m_out.size() >= (1 << 20))
+      {
+        Flush();
+      }
+    }
+    WriteInterfaceBlocks();
+    Flush();
+  }
+
+  void Put16(uint16_t value)
+  {
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(&value);
+    m_out.insert(m_out.end(), p, p + 2);
+  }
+
+  void Put32(uint32_t value)
+  {
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(&value);
+    m_out.insert(m_out.end(), p, p + 4);
+  }
+
+  void PutPadded(const void *data, uint32_t size)
+  {
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    m_out.insert(m_out.end(), p, p + size);
+    m_out.insert(m_out.end(), (4 - size % 4) % 4, 0);
+  }
+
+  // Blocks use host byte order; the section header's magic tells readers.
+  void WriteSectionHeader()
+  {
+    Put32(0x0A0D0D0A);
+    Put32(28);
+    Put32(0x1A2B3C4D);
+    Put16(1);
+    Put16(0);
+    Put32(0xFFFFFFFF); // section length unknown
+    Put32(0xFFFFFFFF);
+    Put32(28);
+    Flush();
+  }
+
+  void WriteInterfaceBlocks()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (; m_written < m_interfaces.size(); m_written++)
+    {
+      const std::string &name = m_interfaces[m_written].first;
+      uint32_t nameBytes = (name.size() + 3) & ~3u;
+      uint32_t total = 16 + (4 + nameBytes) + 8 + 4 + 4;
+      Put32(1);
+      Put32(total);
+      Put16(m_interfaces[m_written].second);
+      Put16(0);
+      Put32(m_snaplen);
+      Put16(2); // if_name
+      Put16(name.size());
+      PutPadded(name.data(), name.size());
+      Put16(9); // if_tsresol: 10^-9 s
+      Put16(1);
+      uint8_t resolution = 9;
+      PutPadded(&resolution, 1);
+      Put32(0); // opt_endofopt
+      Put32(total);
+    }
+  }
+
+  void WritePacketBlock(const Record &record, const uint8_t *data)
+  {
+    uint32_t total = 32 + ((record.captured + 3) & ~3u);
+    Put32(6);
+    Put32(total);
+    Put32(record.interface);
+    Put32(uint64_t(record.time) >> 32);
+    Put32(uint64_t(record.time) & 0xFFFFFFFF);
+    Put32(record.captured);
+    Put32(record.original);
+    PutPadded(data, record.captured);
+    Put32(total);
+  }
+
+  void Flush()
+  {
+    if (!m_out.empty())
+    {
+      m_stream.Write(&m_out[0], m_out.size());
+      m_out.clear();
+    }
+  }
+
+  PcapNgWriter(const PcapNgWriter &);
+  PcapNgWriter &operator=(const PcapNgWriter &);
+
+  uint32_t m_snaplen;
+  std::vector<uint64_t> m_ring;
+  std::atomic<uint64_t> m_head; // written by the simulator thread
+  std::atomic<uint64_t> m_tail; // written by the writer thread
+  std::atomic<bool> m_stop;
+  bool m_open;
+  uint64_t m_records;
+  uint64_t m_stalls;
+  std::thread m_thread;
+
+  std::mutex m_mutex;
+  std::vector<std::pair<std::string, uint16_t> > m_interfaces;
+  size_t m_written;
+
+  // Writer thread only
+  std::vector<uint8_t> m_out;
+  CompressedOutputStream m_stream;
+};
+
+} // namespace ns3
+
+#endif /* PCAPNG_WRITER_H */
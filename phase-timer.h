@@ -0,0 +1,249 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef PHASE_TIMER_H
+#define PHASE_TIMER_H
+
+#include "ns3/core-module.h"
+#include "run-summary.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <sys/resource.h>
+#include <vector>
+
+// Counting allocations replaces the global operator new and delete of the
+// whole program, so it is off unless the build that Benchmark runs is
+// configured for it:
+//
+//   CXXFLAGS="-DPHASE_TIMER_ALLOCATIONS=1" ./waf configure ...
+//
+// The replacement may only happen once per program; with it on, include
+// this header from a single translation unit.
+#ifndef PHASE_TIMER_ALLOCATIONS
+#define PHASE_TIMER_ALLOCATIONS 0
+#endif
+
+namespace ns3 {
+
+// Number and total size of operator new calls so far (zero when
+// allocations are not counted).
+inline std::atomic<uint64_t> &AllocationCount()
+{
+  static std::atomic<uint64_t> count(0);
+  return count;
+}
+
+inline std::atomic<uint64_t> &AllocatedBytes()
+{
+  static std::atomic<uint64_t> bytes(0);
+  return bytes;
+}
+
+// Splits the wall time of a program into named phases.  Start() ends the
+// running phase and starts the next one; a name may be started more than
+// once and its times add up.  Each phase also counts the simulator events
+// it executed and the allocations it made.
+class PhaseTimer
+{
+public:
+  PhaseTimer()
+    : m_current(-1)
+  {
+  }
+
+  void Start(const std::string &name)
+  {
+    Stop();
+    for (m_current = 0; m_current < int(m_phases.size()); m_current++)
+    {
+      if (m_phases[m_current].name == name)
+      {
+        break;
+      }
+    }
+    if (m_current == int(m_phases.size()))
+    {
+      m_phases.push_back(Phase(name));
+    }
+    m_start = std::chrono::steady_clock::now();
+    m_startEvents = Simulator::GetEventCount();
+    m_startAllocations = AllocationCount().load(std::memory_order_relaxed);
+  }
+
+  void Stop()
+  {
+    if (m_current < 0)
+    {
+      return;
+    }
+    Phase &phase = m_phases[m_current];
+    phase.wall += std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+    phase.events += Simulator::GetEventCount() - m_startEvents;
+    phase.allocations += AllocationCount().load(std::memory_order_relaxed) - m_startAllocations;
+    m_current = -1;
+  }
+
+  // Wall seconds and executed events of a stopped phase, zero for a phase
+  // that never ran.
+  double GetWall(const std::string &name) const
+  {
+    for (size_t i = 0; i < m_phases.size(); i++)
+    {
+      if (m_phases[i].name == name)
+      {
+        return m_phases[i].wall;
+      }
+    }
+    return 0;
+  }
+
+  uint64_t GetEvents(const std::string &name) const
+  {
+    for (size_t i = 0; i < m_phases.size(); i++)
+    {
+      if (m_phases[i].name == name)
+      {
+        return m_phases[i].events;
+      }
+    }
+    return 0;
+  }
+
+  // Adds phase_<name>_s and phase_<name>_allocs for every phase, and for
+  // the whole program: executed events, events per wall second and
+  // simulated seconds per wall second (both over the phases that ran
+  // events), peak RSS and allocations.  The allocation columns are left
+  // out when allocations are not counted.
+  void Summarize(RunSummary &summary)
+  {
+    Stop();
+    double eventWall = 0;
+    uint64_t events = 0;
+    for (size_t i = 0; i < m_phases.size(); i++)
+    {
+      summary.Set("phase_" + m_phases[i].name + "_s", m_phases[i].wall);
+      if (PHASE_TIMER_ALLOCATIONS)
+      {
+        summary.Set("phase_" + m_phases[i].name + "_allocs", m_phases[i].allocations);
+      }
+      if (m_phases[i].events)
+      {
+        eventWall += m_phases[i].wall;
+        events += m_phases[i].events;
+      }
+    }
+    summary.Set("events", events);
+    summary.Set("events_per_s", eventWall > 0 ? events / eventWall : 0.0);
+    summary.Set("sim_wall_ratio", eventWall > 0 ? Simulator::Now().GetSeconds() / eventWall : 0.0);
+    summary.Set("peak_rss_mb", GetPeakRss() / 1048576.0);
+    if (PHASE_TIMER_ALLOCATIONS)
+    {
+      summary.Set("allocations", AllocationCount().load(std::memory_order_relaxed));
+      summary.Set("allocated_mb", AllocatedBytes().load(std::memory_order_relaxed) / 1048576.0);
+    }
+  }
+
+  // Bytes; ru_maxrss is in kilobytes on Linux.
+  static uint64_t GetPeakRss()
+  {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return uint64_t(usage.ru_maxrss) * 1024;
+  }
+
+private:
+  struct Phase
+  {
+    Phase(const std::string &n)
+      : name(n),
+        wall(0),
+        events(0),
+        allocations(0)
+    {
+    }
+
+    std::string name;
+    double wall;
+    uint64_t events;
+    uint64_t allocations;
+  };
+
+  std::vector<Phase> m_phases;
+  int m_current;
+  std::chrono::steady_clock::time_point m_start;
+  uint64_t m_startEvents;
+  uint64_t m_startAllocations;
+};
+
+} // namespace ns3
+
+#if PHASE_TIMER_ALLOCATIONS
+void *operator new(std::size_t size)
+{
+  ns3::AllocationCount().fetch_add(1, std::memory_order_relaxed);
+  ns3::AllocatedBytes().fetch_add(size, std::memory_order_relaxed);
+  void *p = std::malloc(size ? size : 1);
+  if (p == 0)
+  {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void *operator new[](std::size_t size)
+{
+  return operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+  ns3::AllocationCount().fetch_add(1, std::memory_order_relaxed);
+  ns3::AllocatedBytes().fetch_add(size, std::memory_order_relaxed);
+  return std::malloc(size ? size : 1);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &tag) noexcept
+{
+  return operator new(size, tag);
+}
+
+// Deletes stay out of line: GCC warns about free() on memory from an
+// inlined operator new (-Wmismatched-new-delete).
+__attribute__((noinline)) void operator delete(void *p) noexcept
+{
+  std::free(p);
+}
+
+__attribute__((noinline)) void operator delete[](void *p) noexcept
+{
+  std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
+__attribute__((noinline)) void operator delete[](void *p, std::size_t) noexcept
+{
+  std::free(p);
+}
+#endif
+
+#endif /* PHASE_TIMER_H */
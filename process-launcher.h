@@ -0,0 +1,138 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef PROCESS_LAUNCHER_H
+#define PROCESS_LAUNCHER_H
+
+#include "ns3/core-module.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sched.h>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <vector>
+
+namespace ns3 {
+
+// What SweepRunner, AdaptiveReplicator, Benchmark and WarmStart share to
+// run simulations as child processes: one run per directory, each child
+// pinned to its own core, with its output in <dir>/output.log.
+class ProcessLauncher
+{
+public:
+  // Items of text between the separators; empty items are dropped.
+  static std::vector<std::string> Split(const std::string &text, char sep)
+  {
+    std::vector<std::string> items;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, sep))
+    {
+      if (!item.empty())
+      {
+        items.push_back(item);
+      }
+    }
+    return items;
+  }
+
+  // mkdir -p
+  static void MakeDirs(const std::string &path)
+  {
+    for (size_t pos = path.find('/', 1); ; pos = path.find('/', pos + 1))
+    {
+      std::string prefix = path.substr(0, pos);
+      if (mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST)
+      {
+        NS_FATAL_ERROR("Cannot create " << prefix << ": " << std::strerror(errno));
+      }
+      if (pos == std::string::npos)
+      {
+        return;
+      }
+    }
+  }
+
+  // The cores this process may run on.
+  static std::vector<int> GetCpus()
+  {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+    std::vector<int> cpus;
+    for (int c = 0; c < CPU_SETSIZE; c++)
+    {
+      if (CPU_ISSET(c, &allowed))
+      {
+        cpus.push_back(c);
+      }
+    }
+    return cpus;
+  }
+
+  // In a child just forked: pins it to cpu, moves it into dir and sends
+  // its stdout and stderr to output.log there.  A child that cannot enter
+  // dir exits with 127.
+  static void EnterDirectory(const std::string &dir, int cpu)
+  {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    sched_setaffinity(0, sizeof(set), &set);
+    if (chdir(dir.c_str()) != 0)
+    {
+      _exit(127);
+    }
+    int log = open("output.log", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (log >= 0)
+    {
+      dup2(log, STDOUT_FILENO);
+      dup2(log, STDERR_FILENO);
+      close(log);
+    }
+  }
+
+  // Starts program with args (args[0] included) in dir, which must
+  // exist, and returns the child's pid.  A program that cannot be
+  // executed exits with 127.
+  static pid_t Launch(const std::string &program, const std::vector<std::string> &args, const std::string &dir,
+                      int cpu)
+  {
+    pid_t pid = fork();
+    NS_ABORT_MSG_IF(pid < 0, "fork failed: " << std::strerror(errno));
+    if (pid > 0)
+    {
+      return pid;
+    }
+    EnterDirectory(dir, cpu);
+    std::vector<char *> argv;
+    for (size_t i = 0; i < args.size(); i++)
+    {
+      argv.push_back(const_cast<char *>(args[i].c_str()));
+    }
+    argv.push_back(0);
+    execv(program.c_str(), &argv[0]);
+    _exit(127);
+  }
+};
+
+} // namespace ns3
+
+#endif /* PROCESS_LAUNCHER_H */
@@ -0,0 +1,338 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef QUEUE_TELEMETRY_H
+#define QUEUE_TELEMETRY_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/traffic-control-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/csma-module.h"
+#include "latency-histogram.h"
+#include "run-summary.h"
+
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <string>
+
+namespace ns3 {
+
+// Root queue discs for bottleneck links:
+//
+//   none     whatever the stack installed (the default queue disc of the
+//            full stack, nothing under the lean one)
+//   fqcodel  FqCoDelQueueDisc
+//   pie      PieQueueDisc
+//   red      RedQueueDisc
+//
+// With an AQM the device queue is cut down to deviceQueue (1 packet by
+// default), so the backlog builds up in the queue disc, where the AQM
+// sees it, rather than in the device.
+class AqmHelper
+{
+public:
+  AqmHelper(const std::string &aqm = "none", const std::string &deviceQueue = "1p")
+    : m_aqm(aqm),
+      m_deviceQueue(deviceQueue)
+  {
+    NS_ABORT_MSG_UNLESS(IsAqm(aqm), "Unknown AQM " << aqm << ", use none, fqcodel, pie or red");
+  }
+
+  static bool IsAqm(const std::string &aqm)
+  {
+    return aqm == "none" || aqm == "fqcodel" || aqm == "pie" || aqm == "red";
+  }
+
+  // Call after the addresses are assigned, which installs the default
+  // queue disc this replaces.
+  void Install(const NetDeviceContainer &devices) const
+  {
+    if (m_aqm == "none")
+    {
+      return;
+    }
+    TrafficControlHelper tch;
+    tch.SetRootQueueDisc(m_aqm == "fqcodel" ? "ns3::FqCoDelQueueDisc"
+                         : m_aqm == "pie"   ? "ns3::PieQueueDisc"
+                                            : "ns3::RedQueueDisc");
+    for (uint32_t i = 0; i < devices.GetN(); i++)
+    {
+      Ptr<NetDevice> device = devices.Get(i);
+      Ptr<TrafficControlLayer> tc = device->GetNode()->GetObject<TrafficControlLayer>();
+      NS_ABORT_MSG_IF(tc == 0, "Node " << device->GetNode()->GetId() << " has no traffic control layer");
+      if (tc->GetRootQueueDiscOnDevice(device))
+      {
+        tch.Uninstall(device);
+      }
+      tch.Install(device);
+      Ptr<Queue<Packet> > queue = GetDeviceQueue(device);
+      if (queue)
+      {
+        queue->SetMaxSize(QueueSize(m_deviceQueue));
+      }
+    }
+  }
+
+  static Ptr<Queue<Packet> > GetDeviceQueue(Ptr<NetDevice> device)
+  {
+    Ptr<PointToPointNetDevice> p2p = DynamicCast<PointToPointNetDevice>(device);
+    Ptr<CsmaNetDevice> csma = DynamicCast<CsmaNetDevice>(device);
+    return p2p ? p2p->GetQueue() : csma ? csma->GetQueue() : Ptr<Queue<Packet> >();
+  }
+
+private:
+  std::string m_aqm;
+  std::string m_deviceQueue;
+};
+
+// Queue length and sojourn time of the outgoing queues of chosen devices.
+//
+// Lengths are followed through the PacketsInQueue traced values of the
+// root queue disc and the device queue, and averaged over time exactly
+// (no sampling error) at the cost of one multiply-add per change, from
+// the time Track is called.
+// Sojourn times come from the queue disc's SojournTime trace or, on a
+// device without queue disc, from its FIFO Enqueue/Dequeue, into a
+// LatencyHistogram.  EnableSampling adds the instantaneous lengths every
+// interval to a CSV, for plots over time.
+//
+//   Write      <path>: queue,aqm,enqueued,dropped,drop_rate,mean_packets,
+//              max_packets,device_mean_packets,sojourn_mean_ms,
+//              sojourn_p50_ms,sojourn_p99_ms,sojourn_p999_ms
+//   Summarize  aqm_drop_rate, aqm_queue_mean_packets, aqm_sojourn_mean_ms,
+//              aqm_sojourn_p50_ms, aqm_sojourn_p99_ms over all queues
+class QueueTelemetry
+{
+public:
+  // Names used for the node's queues instead of n<id>.
+  void NameNode(Ptr<Node> node, const std::string &name)
+  {
+    m_names[node->GetId()] = name;
+  }
+
+  // aqm only labels the rows.
+  void Track(const NetDeviceContainer &devices, const std::string &aqm)
+  {
+    for (uint32_t i = 0; i < devices.GetN(); i++)
+    {
+      Track(devices.Get(i), aqm);
+    }
+  }
+
+  void Track(Ptr<NetDevice> device, const std::string &aqm)
+  {
+    m_queues.push_back(Entry());
+    Entry &entry = m_queues.back();
+    std::map<uint32_t, std::string>::const_iterator it = m_names.find(device->GetNode()->GetId());
+    entry.name = (it != m_names.end() ? it->second : "n" + std::to_string(device->GetNode()->GetId())) + "/" +
+                 std::to_string(device->GetIfIndex());
+    entry.aqm = aqm;
+    Ptr<TrafficControlLayer> tc = device->GetNode()->GetObject<TrafficControlLayer>();
+    entry.disc = tc ? tc->GetRootQueueDiscOnDevice(device) : 0;
+    entry.device = AqmHelper::GetDeviceQueue(device);
+    if (entry.disc)
+    {
+      entry.packets.Start(entry.disc->GetNPackets());
+      entry.disc->TraceConnectWithoutContext("PacketsInQueue",
+                                             MakeBoundCallback(&QueueTelemetry::Changed, &entry.packets));
+      entry.disc->TraceConnectWithoutContext("SojournTime", MakeBoundCallback(&QueueTelemetry::Sojourn, &entry));
+    }
+    if (entry.device)
+    {
+      entry.devicePackets.Start(entry.device->GetNPackets());
+      entry.device->TraceConnectWithoutContext("PacketsInQueue",
+                                               MakeBoundCallback(&QueueTelemetry::Changed, &entry.devicePackets));
+      if (!entry.disc)
+      {
+        entry.device->TraceConnectWithoutContext("Enqueue", MakeBoundCallback(&QueueTelemetry::Enqueue, &entry));
+        entry.device->TraceConnectWithoutContext("Dequeue", MakeBoundCallback(&QueueTelemetry::Dequeue, &entry));
+      }
+    }
+  }
+
+  void EnableSampling(const std::string &path, Time interval)
+  {
+    m_samples.open(path.c_str());
+    NS_ABORT_MSG_UNLESS(m_samples.is_open(), "Cannot write " << path);
+    m_samples << "time_s,queue,packets,bytes,device_packets\n";
+    m_interval = interval;
+    Simulator::Schedule(interval, &QueueTelemetry::Sample, this);
+  }
+
+  void Write(const std::string &path)
+  {
+    std::ofstream out(path.c_str());
+    NS_ABORT_MSG_UNLESS(out.is_open(), "Cannot write " << path);
+    out.precision(9);
+    out << "queue,aqm,enqueued,dropped,drop_rate,mean_packets,max_packets,device_mean_packets,"
+        << "sojourn_mean_ms,sojourn_p50_ms,sojourn_p99_ms,sojourn_p999_ms\n";
+    for (size_t i = 0; i < m_queues.size(); i++)
+    {
+      const Entry &e = m_queues[i];
+      uint64_t enqueued = Enqueued(e);
+      uint64_t dropped = Dropped(e);
+      out << e.name << "," << e.aqm << "," << enqueued << "," << dropped << ","
+          << (enqueued + dropped ? double(dropped) / (enqueued + dropped) : 0.0) << "," << e.packets.Mean()
+          << "," << e.packets.max << "," << e.devicePackets.Mean() << "," << e.sojourn.GetMean() / 1e6 << ","
+          << e.sojourn.GetPercentile(0.5) / 1e6 << "," << e.sojourn.GetPercentile(0.99) / 1e6 << ","
+          << e.sojourn.GetPercentile(0.999) / 1e6 << "\n";
+    }
+  }
+
+  void Summarize(RunSummary &summary) const
+  {
+    LatencyHistogram sojourn;
+    uint64_t enqueued = 0;
+    uint64_t dropped = 0;
+    double packets = 0;
+    for (size_t i = 0; i < m_queues.size(); i++)
+    {
+      sojourn.Merge(m_queues[i].sojourn);
+      enqueued += Enqueued(m_queues[i]);
+      dropped += Dropped(m_queues[i]);
+      packets += m_queues[i].packets.Mean() + m_queues[i].devicePackets.Mean();
+    }
+    summary.Set("aqm_drop_rate", enqueued + dropped ? double(dropped) / (enqueued + dropped) : 0.0);
+    summary.Set("aqm_queue_mean_packets", m_queues.empty() ? 0.0 : packets / m_queues.size());
+    summary.Set("aqm_sojourn_mean_ms", sojourn.GetMean() / 1e6);
+    summary.Set("aqm_sojourn_p50_ms", sojourn.GetPercentile(0.5) / 1e6);
+    summary.Set("aqm_sojourn_p99_ms", sojourn.GetPercentile(0.99) / 1e6);
+  }
+
+private:
+  // Time-weighted mean of a traced length, from the time tracking
+  // started.
+  struct Occupancy
+  {
+    Occupancy()
+      : current(0),
+        max(0),
+        area(0)
+    {
+    }
+
+    // The length when tracking starts.
+    void Start(uint32_t value)
+    {
+      start = Simulator::Now();
+      last = start;
+      current = value;
+      max = value;
+      area = 0;
+    }
+
+    void Set(uint32_t value)
+    {
+      Time now = Simulator::Now();
+      area += current * (now - last).GetSeconds();
+      last = now;
+      current = value;
+      max = std::max(max, value);
+    }
+
+    double Mean() const
+    {
+      double elapsed = (Simulator::Now() - start).GetSeconds();
+      double total = area + current * (Simulator::Now() - last).GetSeconds();
+      return elapsed > 0 ? total / elapsed : 0.0;
+    }
+
+    uint32_t current;
+    uint32_t max;
+    double area;
+    Time start;
+    Time last;
+  };
+
+  struct Entry
+  {
+    std::string name;
+    std::string aqm;
+    Ptr<QueueDisc> disc;
+    Ptr<Queue<Packet> > device;
+    Occupancy packets;
+    Occupancy devicePackets;
+    LatencyHistogram sojourn;
+    std::deque<Time> enqueued; // device FIFO, without queue disc
+  };
+
+  static uint64_t Enqueued(const Entry &e)
+  {
+    if (e.disc)
+    {
+      QueueDisc::Stats stats = e.disc->GetStats();
+      return stats.nTotalEnqueuedPackets;
+    }
+    return e.device ? e.device->GetTotalReceivedPackets() - e.device->GetTotalDroppedPacketsBeforeEnqueue() : 0;
+  }
+
+  static uint64_t Dropped(const Entry &e)
+  {
+    if (e.disc)
+    {
+      return e.disc->GetStats().nTotalDroppedPackets;
+    }
+    return e.device ? e.device->GetTotalDroppedPackets() : 0;
+  }
+
+  static void Changed(Occupancy *occupancy, uint32_t oldValue, uint32_t newValue)
+  {
+    occupancy->Set(newValue);
+  }
+
+  static void Sojourn(Entry *entry, Time sojourn)
+  {
+    entry->sojourn.Record(sojourn);
+  }
+
+  static void Enqueue(Entry *entry, Ptr<const Packet> packet)
+  {
+    entry->enqueued.push_back(Simulator::Now());
+  }
+
+  static void Dequeue(Entry *entry, Ptr<const Packet> packet)
+  {
+    if (!entry->enqueued.empty())
+    {
+      entry->sojourn.Record(Simulator::Now() - entry->enqueued.front());
+      entry->enqueued.pop_front();
+    }
+  }
+
+  void Sample()
+  {
+    double now = Simulator::Now().GetSeconds();
+    for (size_t i = 0; i < m_queues.size(); i++)
+    {
+      const Entry &e = m_queues[i];
+      m_samples << now << "," << e.name << "," << e.packets.current << ","
+                << (e.disc ? e.disc->GetNBytes() : 0) << "," << e.devicePackets.current << "\n";
+    }
+    Simulator::Schedule(m_interval, &QueueTelemetry::Sample, this);
+  }
+
+  std::map<uint32_t, std::string> m_names;
+  std::deque<Entry> m_queues; // deques keep the elements' addresses
+  std::ofstream m_samples;
+  Time m_interval;
+};
+
+} // namespace ns3
+
+#endif /* QUEUE_TELEMETRY_H */
@@ -0,0 +1,525 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef ROUTING_CACHE_H
+#define ROUTING_CACHE_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <queue>
+#include <string>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace ns3 {
+
+// Replacement for Ipv4GlobalRoutingHelper::PopulateRoutingTables that
+// keeps the routes in a file between runs.
+//
+// The topology is read back from the nodes as a graph of subnets: every
+// IPv4 subnet is a vertex joining the interfaces that have an address in
+// it, and leaving a node through an interface costs the interface metric.
+// One column is computed per destination subnet (a Dijkstra search out of
+// the subnet) holding, for every node, the distance and the next hop;
+// among equally short next hops the lowest node id wins, so a column only
+// depends on the graph and not on the search order.
+//
+// The file is keyed by a hash of the graph.  When the hash matches, the
+// routes are loaded without any computation.  Otherwise, in incremental
+// mode with the same nodes, only the columns that a removed, added or
+// changed subnet can affect are recomputed:
+//  - a column whose next hops use a removed or changed subnet;
+//  - a column in which an added or changed subnet gives some node a path
+//    no longer than its current one.
+//
+// Routes are installed in the global routing protocol of every node, as
+// network routes, longest prefix first: Ipv4GlobalRouting returns the
+// first matching network route.  Directly connected subnets are left to
+// static routing, as with PopulateRoutingTables.
+class RoutingCache
+{
+public:
+  enum Result
+  {
+    LOADED,
+    UPDATED,
+    COMPUTED
+  };
+
+  RoutingCache()
+    : m_nodes(0),
+      m_hash(0),
+      m_computed(0)
+  {
+  }
+
+  Result Populate(const std::string &path, bool incremental)
+  {
+    ReadGraph();
+    RoutingCache old;
+    Result result = COMPUTED;
+    if (old.Load(path) && old.m_nodes == m_nodes)
+    {
+      if (old.m_hash == m_hash)
+      {
+        m_columns.swap(old.m_columns);
+        result = LOADED;
+      }
+      else if (incremental)
+      {
+        Update(old);
+        result = UPDATED;
+      }
+    }
+    if (result == COMPUTED)
+    {
+      m_columns.assign(m_subnets.size(), std::vector<Hop>());
+      for (uint32_t d = 0; d < m_subnets.size(); d++)
+      {
+        Compute(d);
+      }
+    }
+    Install();
+    if (result != LOADED)
+    {
+      Save(path);
+    }
+    return result;
+  }
+
+  // Destination columns computed by the last Populate.
+  uint32_t GetComputedColumns() const
+  {
+    return m_computed;
+  }
+
+  uint32_t GetColumns() const
+  {
+    return m_subnets.size();
+  }
+
+private:
+  static const uint32_t INF = 0xffffffff;
+
+  struct Member
+  {
+    uint32_t node;
+    uint32_t iface;
+    uint32_t address;
+    uint32_t metric;
+  };
+
+  struct Subnet
+  {
+    uint32_t network;
+    uint32_t mask;
+    std::vector<Member> members;
+  };
+
+  // Per node and destination; iface 0 means no route (attached or
+  // unreachable).
+  struct Hop
+  {
+    uint32_t dist;
+    uint32_t subnet;
+    uint32_t iface;
+    uint32_t gateway;
+  };
+
+  static bool MemberLess(const Member &a, const Member &b)
+  {
+    return a.node < b.node || (a.node == b.node && a.iface < b.iface);
+  }
+
+  void ReadGraph()
+  {
+    std::map<std::pair<uint32_t, uint32_t>, Subnet> subnets;
+    m_nodes = NodeList::GetNNodes();
+    for (uint32_t n = 0; n < m_nodes; n++)
+    {
+      Ptr<Ipv4> ipv4 = NodeList::GetNode(n)->GetObject<Ipv4>();
+      for (uint32_t i = 1; ipv4 && i < ipv4->GetNInterfaces(); i++)
+      {
+        for (uint32_t j = 0; j < ipv4->GetNAddresses(i); j++)
+        {
+          Ipv4InterfaceAddress address = ipv4->GetAddress(i, j);
+          uint32_t mask = address.GetMask().Get();
+          Subnet &subnet = subnets[std::make_pair(address.GetLocal().Get() & mask, mask)];
+          subnet.network = address.GetLocal().Get() & mask;
+          subnet.mask = mask;
+          Member member = {n, i, address.GetLocal().Get(), std::max<uint32_t>(ipv4->GetMetric(i), 1)};
+          subnet.members.push_back(member);
+        }
+      }
+    }
+
+    m_subnets.clear();
+    m_nodeSubnets.assign(m_nodes, std::vector<std::pair<uint32_t, uint32_t> >());
+    uint64_t hash = 14695981039346656037ull;
+    Mix(hash, m_nodes);
+    for (std::map<std::pair<uint32_t, uint32_t>, Subnet>::iterator it = subnets.begin(); it != subnets.end(); it++)
+    {
+      Subnet &subnet = it->second;
+      std::sort(subnet.members.begin(), subnet.members.end(), MemberLess);
+      uint32_t index = m_subnets.size();
+      Mix(hash, subnet.network);
+      Mix(hash, subnet.mask);
+      Mix(hash, subnet.members.size());
+      for (uint32_t m = 0; m < subnet.members.size(); m++)
+      {
+        const Member &member = subnet.members[m];
+        Mix(hash, member.node);
+        Mix(hash, member.iface);
+        Mix(hash, member.address);
+        Mix(hash, member.metric);
+        m_nodeSubnets[member.node].push_back(std::make_pair(index, m));
+      }
+      m_subnets.push_back(subnet);
+    }
+    m_hash = hash;
+  }
+
+  static void Mix(uint64_t &hash, uint32_t value)
+  {
+    for (int i = 0; i < 4; i++)
+    {
+      hash = (hash ^ ((value >> (8 * i)) & 0xff)) * 1099511628211ull;
+    }
+  }
+
+  void Compute(uint32_t d)
+  {
+    m_computed++;
+    std::vector<Hop> &column = m_columns[d];
+    Hop none = {INF, 0, 0, 0};
+    column.assign(m_nodes, none);
+
+    // Distances: subnets are reached at the distance of their first
+    // member, members are reached from the subnet for their metric.
+    typedef std::pair<uint32_t, uint32_t> Entry;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > queue;
+    std::vector<bool> reached(m_subnets.size(), false);
+    for (uint32_t m = 0; m < m_subnets[d].members.size(); m++)
+    {
+      column[m_subnets[d].members[m].node].dist = 0;
+      queue.push(Entry(0, m_subnets[d].members[m].node));
+    }
+    while (!queue.empty())
+    {
+      Entry top = queue.top();
+      queue.pop();
+      if (top.first != column[top.second].dist)
+      {
+        continue;
+      }
+      const std::vector<std::pair<uint32_t, uint32_t> > &links = m_nodeSubnets[top.second];
+      for (uint32_t l = 0; l < links.size(); l++)
+      {
+        if (reached[links[l].first])
+        {
+          continue;
+        }
+        reached[links[l].first] = true;
+        const std::vector<Member> &members = m_subnets[links[l].first].members;
+        for (uint32_t m = 0; m < members.size(); m++)
+        {
+          uint32_t dist = top.first + members[m].metric;
+          if (dist < column[members[m].node].dist)
+          {
+            column[members[m].node].dist = dist;
+            queue.push(Entry(dist, members[m].node));
+          }
+        }
+      }
+    }
+
+    // Next hops: the closest member of each subnet, lowest node id first.
+    std::vector<uint32_t> closest(m_subnets.size(), INF);
+    for (uint32_t s = 0; s < m_subnets.size(); s++)
+    {
+      const std::vector<Member> &members = m_subnets[s].members;
+      for (uint32_t m = 0; m < members.size(); m++)
+      {
+        if (closest[s] == INF || column[members[m].node].dist < column[members[closest[s]].node].dist)
+        {
+          closest[s] = m;
+        }
+      }
+    }
+    for (uint32_t n = 0; n < m_nodes; n++)
+    {
+      Hop &hop = column[n];
+      if (hop.dist == 0 || hop.dist == INF)
+      {
+        continue;
+      }
+      uint32_t best = INF;
+      const std::vector<std::pair<uint32_t, uint32_t> > &links = m_nodeSubnets[n];
+      for (uint32_t l = 0; l < links.size(); l++)
+      {
+        const Subnet &subnet = m_subnets[links[l].first];
+        const Member &gateway = subnet.members[closest[links[l].first]];
+        const Member &self = subnet.members[links[l].second];
+        if (gateway.node != n && column[gateway.node].dist + self.metric == hop.dist &&
+            (best == INF || gateway.node < best))
+        {
+          best = gateway.node;
+          hop.subnet = links[l].first;
+          hop.iface = self.iface;
+          hop.gateway = gateway.address;
+        }
+      }
+    }
+  }
+
+  void Update(const RoutingCache &old)
+  {
+    std::map<std::pair<uint32_t, uint32_t>, uint32_t> oldIndex;
+    for (uint32_t s = 0; s < old.m_subnets.size(); s++)
+    {
+      oldIndex[std::make_pair(old.m_subnets[s].network, old.m_subnets[s].mask)] = s;
+    }
+
+    // Subnets that are new or differ, and old subnets that are gone or differ.
+    std::vector<uint32_t> oldToNew(old.m_subnets.size(), INF);
+    std::vector<uint32_t> newToOld(m_subnets.size(), INF);
+    std::vector<uint32_t> added;
+    std::vector<bool> removed(old.m_subnets.size(), true);
+    for (uint32_t s = 0; s < m_subnets.size(); s++)
+    {
+      std::map<std::pair<uint32_t, uint32_t>, uint32_t>::iterator it =
+          oldIndex.find(std::make_pair(m_subnets[s].network, m_subnets[s].mask));
+      if (it != oldIndex.end())
+      {
+        newToOld[s] = it->second;
+        oldToNew[it->second] = s;
+        if (SameMembers(m_subnets[s], old.m_subnets[it->second]))
+        {
+          removed[it->second] = false;
+          continue;
+        }
+      }
+      added.push_back(s);
+    }
+
+    m_columns.assign(m_subnets.size(), std::vector<Hop>());
+    for (uint32_t d = 0; d < m_subnets.size(); d++)
+    {
+      uint32_t o = newToOld[d];
+      if (o == INF || removed[o] || Affected(old, old.m_columns[o], removed, added))
+      {
+        Compute(d);
+        continue;
+      }
+      m_columns[d] = old.m_columns[o];
+      for (uint32_t n = 0; n < m_nodes; n++)
+      {
+        if (m_columns[d][n].iface)
+        {
+          m_columns[d][n].subnet = oldToNew[m_columns[d][n].subnet];
+        }
+      }
+    }
+  }
+
+  static bool SameMembers(const Subnet &a, const Subnet &b)
+  {
+    if (a.members.size() != b.members.size())
+    {
+      return false;
+    }
+    for (uint32_t m = 0; m < a.members.size(); m++)
+    {
+      const Member &x = a.members[m];
+      const Member &y = b.members[m];
+      if (x.node != y.node || x.iface != y.iface || x.address != y.address || x.metric != y.metric)
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool Affected(const RoutingCache &old, const std::vector<Hop> &column, const std::vector<bool> &removed,
+                const std::vector<uint32_t> &added) const
+  {
+    for (uint32_t n = 0; n < m_nodes; n++)
+    {
+      if (column[n].iface && removed[column[n].subnet])
+      {
+        return true;
+      }
+    }
+    for (uint32_t a = 0; a < added.size(); a++)
+    {
+      // The two closest members are enough to find a shortcut.
+      const std::vector<Member> &members = m_subnets[added[a]].members;
+      uint32_t first = INF;
+      uint32_t second = INF;
+      for (uint32_t m = 0; m < members.size(); m++)
+      {
+        uint32_t dist = column[members[m].node].dist;
+        if (first == INF || dist < column[members[first].node].dist)
+        {
+          second = first;
+          first = m;
+        }
+        else if (second == INF || dist < column[members[second].node].dist)
+        {
+          second = m;
+        }
+      }
+      for (uint32_t m = 0; m < members.size(); m++)
+      {
+        uint32_t other = m == first ? second : first;
+        if (other == INF || members[other].node == members[m].node)
+        {
+          continue;
+        }
+        uint32_t via = column[members[other].node].dist;
+        if (via != INF && via + members[m].metric <= column[members[m].node].dist)
+        {
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  void Install()
+  {
+    // Longest prefix first, since the first matching route is used.
+    std::vector<std::pair<uint32_t, uint32_t> > order;
+    for (uint32_t d = 0; d < m_subnets.size(); d++)
+    {
+      order.push_back(std::make_pair(~m_subnets[d].mask, d));
+    }
+    std::sort(order.begin(), order.end());
+
+    std::vector<Ptr<Ipv4GlobalRouting> > routing(m_nodes);
+    for (uint32_t n = 0; n < m_nodes; n++)
+    {
+      Ptr<GlobalRouter> router = NodeList::GetNode(n)->GetObject<GlobalRouter>();
+      if (router)
+      {
+        routing[n] = router->GetRoutingProtocol();
+      }
+    }
+    for (uint32_t o = 0; o < order.size(); o++)
+    {
+      uint32_t d = order[o].second;
+      Ipv4Address network(m_subnets[d].network);
+      Ipv4Mask mask(m_subnets[d].mask);
+      for (uint32_t n = 0; n < m_nodes; n++)
+      {
+        const Hop &hop = m_columns[d][n];
+        if (hop.iface && routing[n])
+        {
+          routing[n]->AddNetworkRouteTo(network, mask, Ipv4Address(hop.gateway), hop.iface);
+        }
+      }
+    }
+  }
+
+  // File layout (host byte order): "NS3ROUTE", version, node count, hash,
+  // subnet count, the subnets with their members, then one column of
+  // node-count hops per subnet.
+  bool Load(const std::string &path)
+  {
+    std::FILE *file = std::fopen(path.c_str(), "rb");
+    if (file == 0)
+    {
+      return false;
+    }
+    char magic[8];
+    uint32_t version = 0;
+    uint32_t count = 0;
+    bool ok = std::fread(magic, 8, 1, file) == 1 && std::memcmp(magic, "NS3ROUTE", 8) == 0 &&
+              std::fread(&version, 4, 1, file) == 1 && version == 1 && std::fread(&m_nodes, 4, 1, file) == 1 &&
+              std::fread(&m_hash, 8, 1, file) == 1 && std::fread(&count, 4, 1, file) == 1;
+    m_subnets.resize(ok ? count : 0);
+    for (uint32_t s = 0; ok && s < count; s++)
+    {
+      uint32_t header[3];
+      ok = std::fread(header, 4, 3, file) == 3;
+      m_subnets[s].network = header[0];
+      m_subnets[s].mask = header[1];
+      m_subnets[s].members.resize(ok ? header[2] : 0);
+      ok = ok && (header[2] == 0 ||
+                  std::fread(&m_subnets[s].members[0], sizeof(Member), header[2], file) == header[2]);
+    }
+    m_columns.assign(ok ? count : 0, std::vector<Hop>(m_nodes));
+    for (uint32_t s = 0; ok && s < count; s++)
+    {
+      ok = m_nodes == 0 || std::fread(&m_columns[s][0], sizeof(Hop), m_nodes, file) == m_nodes;
+    }
+    std::fclose(file);
+    return ok;
+  }
+
+  // Written to a temporary file first, so runs sharing the cache never
+  // read a partial file.
+  void Save(const std::string &path) const
+  {
+    std::string temporary = path + ".tmp" + std::to_string(getpid());
+    std::FILE *file = std::fopen(temporary.c_str(), "wb");
+    NS_ABORT_MSG_IF(file == 0, "Cannot write routing cache " << temporary);
+    uint32_t version = 1;
+    uint32_t count = m_subnets.size();
+    std::fwrite("NS3ROUTE", 8, 1, file);
+    std::fwrite(&version, 4, 1, file);
+    std::fwrite(&m_nodes, 4, 1, file);
+    std::fwrite(&m_hash, 8, 1, file);
+    std::fwrite(&count, 4, 1, file);
+    for (uint32_t s = 0; s < count; s++)
+    {
+      uint32_t header[3] = {m_subnets[s].network, m_subnets[s].mask, uint32_t(m_subnets[s].members.size())};
+      std::fwrite(header, 4, 3, file);
+      if (!m_subnets[s].members.empty())
+      {
+        std::fwrite(&m_subnets[s].members[0], sizeof(Member), m_subnets[s].members.size(), file);
+      }
+    }
+    for (uint32_t s = 0; s < count && m_nodes; s++)
+    {
+      std::fwrite(&m_columns[s][0], sizeof(Hop), m_nodes, file);
+    }
+    bool ok = std::fclose(file) == 0;
+    NS_ABORT_MSG_UNLESS(ok && std::rename(temporary.c_str(), path.c_str()) == 0,
+                        "Cannot write routing cache " << path);
+  }
+
+  RoutingCache(const RoutingCache &);
+  RoutingCache &operator=(const RoutingCache &);
+
+  uint32_t m_nodes;
+  uint64_t m_hash;
+  uint32_t m_computed;
+  std::vector<Subnet> m_subnets;
+  std::vector<std::vector<std::pair<uint32_t, uint32_t> > > m_nodeSubnets;
+  std::vector<std::vector<Hop> > m_columns;
+};
+
+} // namespace ns3
+
+#endif /* ROUTING_CACHE_H */
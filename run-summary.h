@@ -0,0 +1,134 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef RUN_SUMMARY_H
+#define RUN_SUMMARY_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/applications-module.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+// One row of scalar metrics per run, written as a two-line CSV (header and
+// values) that SweepRunner merges across runs.
+class RunSummary
+{
+public:
+  RunSummary()
+    : m_wallStart(std::chrono::steady_clock::now()),
+      m_sent(0)
+  {
+  }
+
+  // Adds a column, or overwrites it if it already exists.
+  void Set(const std::string &name, double value)
+  {
+    for (size_t i = 0; i < m_names.size(); i++)
+    {
+      if (m_names[i] == name)
+      {
+        m_values[i] = value;
+        return;
+      }
+    }
+    m_names.push_back(name);
+    m_values.push_back(value);
+  }
+
+  // Counts echo requests and replies and measures round trip times.  Echo
+  // packets carry no sequence number, but UdpEchoServer sends the request
+  // packet back, so a reply has the uid of its request; a lost request or
+  // reply then only loses its own sample.
+  void TrackEchoClients(const ApplicationContainer &clients)
+  {
+    for (uint32_t i = 0; i < clients.GetN(); i++)
+    {
+      clients.Get(i)->TraceConnectWithoutContext("Tx", MakeBoundCallback(&RunSummary::EchoTx, this));
+      clients.Get(i)->TraceConnectWithoutContext("Rx", MakeBoundCallback(&RunSummary::EchoRx, this));
+    }
+  }
+
+  void Write(const std::string &path)
+  {
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_wallStart).count();
+    Set("seed", RngSeedManager::GetSeed());
+    Set("run", RngSeedManager::GetRun());
+    Set("echo_tx", m_sent);
+    Set("echo_rx", m_rtt.size());
+    Set("echo_loss", m_sent ? 1.0 - double(m_rtt.size()) / m_sent : 0.0);
+    double sum = 0;
+    double max = 0;
+    for (size_t i = 0; i < m_rtt.size(); i++)
+    {
+      sum += m_rtt[i];
+      max = std::max(max, m_rtt[i]);
+    }
+    Set("rtt_mean_ms", m_rtt.empty() ? 0.0 : sum / m_rtt.size());
+    Set("rtt_max_ms", max);
+    Set("sim_time_s", Simulator::Now().GetSeconds());
+    Set("wall_s", wall);
+
+    std::ofstream out(path.c_str());
+    NS_ABORT_MSG_UNLESS(out.is_open(), "Cannot write run summary " << path);
+    out.precision(9);
+    for (size_t i = 0; i < m_names.size(); i++)
+    {
+      out << (i ? "," : "") << m_names[i];
+    }
+    out << "\n";
+    for (size_t i = 0; i < m_values.size(); i++)
+    {
+      out << (i ? "," : "") << m_values[i];
+    }
+    out << "\n";
+  }
+
+private:
+  static void EchoTx(RunSummary *summary, Ptr<const Packet> packet)
+  {
+    summary->m_sent++;
+    summary->m_pending[packet->GetUid()] = Simulator::Now();
+  }
+
+  static void EchoRx(RunSummary *summary, Ptr<const Packet> packet)
+  {
+    std::map<uint64_t, Time>::iterator it = summary->m_pending.find(packet->GetUid());
+    if (it == summary->m_pending.end())
+    {
+      return;
+    }
+    summary->m_rtt.push_back((Simulator::Now() - it->second).GetSeconds() * 1000.0);
+    summary->m_pending.erase(it);
+  }
+
+  std::chrono::steady_clock::time_point m_wallStart;
+  uint64_t m_sent;
+  std::vector<std::string> m_names;
+  std::vector<double> m_values;
+  std::map<uint64_t, Time> m_pending; // requests by packet uid
+  std::vector<double> m_rtt;
+};
+
+} // namespace ns3
+
+#endif /* RUN_SUMMARY_H */
@@ -0,0 +1,94 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef SCALABLE_GRID_POSITION_ALLOCATOR_H
+#define SCALABLE_GRID_POSITION_ALLOCATOR_H
+
+#include "ns3/core-module.h"
+#include "ns3/mobility-module.h"
+
+#include <cmath>
+
+namespace ns3 {
+
+// Lays N nodes out on a grid that always fits the given bounds: the grid
+// keeps the aspect ratio of the rectangle and the spacing shrinks as N
+// grows, so any number of stations can start inside a RandomWalk2d area.
+class ScalableGridPositionAllocator : public PositionAllocator
+{
+public:
+  static TypeId GetTypeId(void)
+  {
+    static TypeId tid = TypeId("ns3::ScalableGridPositionAllocator")
+                            .SetParent<PositionAllocator>()
+                            .SetGroupName("Mobility")
+                            .AddConstructor<ScalableGridPositionAllocator>()
+                            .AddAttribute("Bounds", "Rectangle the grid has to fit in.",
+                                          RectangleValue(Rectangle(-50.0, 50.0, -50.0, 50.0)),
+                                          MakeRectangleAccessor(&ScalableGridPositionAllocator::m_bounds),
+                                          MakeRectangleChecker())
+                            .AddAttribute("N", "Number of positions the grid is sized for.",
+                                          UintegerValue(1),
+                                          MakeUintegerAccessor(&ScalableGridPositionAllocator::m_n),
+                                          MakeUintegerChecker<uint32_t>(1))
+                            .AddAttribute("Z", "Z coordinate of every position.",
+                                          DoubleValue(0.0),
+                                          MakeDoubleAccessor(&ScalableGridPositionAllocator::m_z),
+                                          MakeDoubleChecker<double>());
+    return tid;
+  }
+
+  ScalableGridPositionAllocator()
+    : m_next(0)
+  {
+  }
+
+  virtual Vector GetNext(void) const
+  {
+    Vector position = GetPosition(m_bounds, m_n, m_next++);
+    position.z = m_z;
+    return position;
+  }
+
+  // Position k of a grid sized for n positions, at z = 0.
+  static Vector GetPosition(const Rectangle &bounds, uint32_t n, uint32_t k)
+  {
+    double width = bounds.xMax - bounds.xMin;
+    double height = bounds.yMax - bounds.yMin;
+    uint32_t columns = std::max(1u, uint32_t(std::ceil(std::sqrt(n * width / std::max(height, 1e-9)))));
+    uint32_t rows = (n + columns - 1) / columns;
+    k %= rows * columns;
+    double x = bounds.xMin + (k % columns + 0.5) * width / columns;
+    double y = bounds.yMin + (k / columns + 0.5) * height / rows;
+    return Vector(x, y, 0.0);
+  }
+
+  virtual int64_t AssignStreams(int64_t stream)
+  {
+    return 0;
+  }
+
+private:
+  Rectangle m_bounds;
+  uint32_t m_n;
+  double m_z;
+  mutable uint32_t m_next;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(ScalableGridPositionAllocator);
+
+} // namespace ns3
+
+#endif /* SCALABLE_GRID_POSITION_ALLOCATOR_H */
@@ -0,0 +1,563 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef SPATIAL_WIFI_CHANNEL_H
+#define SPATIAL_WIFI_CHANNEL_H
+
+#include "ns3/core-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/propagation-module.h"
+#include "ns3/wifi-module.h"
+#include "ns3/yans-wifi-helper.h"
+#include "cached-propagation-loss.h"
+#include "trajectory-mobility-model.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+// Yans channel with a uniform grid index over PHY positions.
+//
+// YansWifiChannel::Send schedules a reception on every PHY of the channel
+// and only drops signals below the receiver sensitivity once the event
+// fires.  Here the sender only looks at grid cells within detection range
+// and schedules receptions for PHYs that can actually detect the signal,
+// in the same order Yans would, so the received frames are unchanged.
+//
+// The detection range is derived from the loss model, the largest transmit
+// power and the lowest sensitivity on the channel, which assumes a
+// deterministic loss that grows with distance (log-distance, Friis, ...).
+// Set "Range" explicitly for other models.
+//
+// Cells are updated from the mobility CourseChange trace, and moving PHYs
+// are re-binned every RefreshInterval; the search radius is widened by the
+// distance a station can have drifted since (at the largest speed of a
+// TrajectoryMobilityModel, which does not trace its turns).
+//
+// The PHYs of the cells searched are then cut down to those within range
+// of their current position (RangeFilter), so the loss model only runs
+// for receivers that may detect the frame.  Links between two PHYs on
+// ConstantPositionMobilityModel keep their loss and delay
+// (PropagationPathCache) until one of them is moved.
+
+namespace ns3 {
+
+class SpatialYansWifiChannel : public YansWifiChannel
+{
+public:
+  static TypeId GetTypeId(void)
+  {
+    static TypeId tid = TypeId("ns3::SpatialYansWifiChannel")
+                            .SetParent<YansWifiChannel>()
+                            .SetGroupName("Wifi")
+                            .AddConstructor<SpatialYansWifiChannel>()
+                            .AddAttribute("Range",
+                                          "Largest distance (m) a transmission can be detected at; "
+                                          "0 derives it from the loss model and PHY thresholds.",
+                                          DoubleValue(0.0),
+                                          MakeDoubleAccessor(&SpatialYansWifiChannel::m_userRange),
+                                          MakeDoubleChecker<double>(0.0))
+                            .AddAttribute("RefreshInterval",
+                                          "How often the cells of moving PHYs are refreshed.",
+                                          TimeValue(Seconds(1.0)),
+                                          MakeTimeAccessor(&SpatialYansWifiChannel::m_refresh),
+                                          MakeTimeChecker())
+                            .AddAttribute("CachePaths",
+                                          "Keep the loss and delay between stationary PHYs when the "
+                                          "models are deterministic.",
+                                          BooleanValue(true),
+                                          MakeBooleanAccessor(&SpatialYansWifiChannel::m_cachePaths),
+                                          MakeBooleanChecker());
+    return tid;
+  }
+
+  SpatialYansWifiChannel()
+    : m_userRange(0.0),
+      m_cachePaths(true),
+      m_range(0.0),
+      m_cellSize(0.0),
+      m_maxSpeed(0.0),
+      m_refreshPending(false)
+  {
+  }
+
+  // Called by SpatialYansWifiPhy instead of YansWifiChannel::Send.
+  void SendNearby(Ptr<YansWifiPhy> sender, Ptr<const WifiPpdu> ppdu, double txPowerDbm)
+  {
+    Sync();
+    Ptr<MobilityModel> senderMobility = sender->GetMobility();
+    Vector origin = senderMobility->GetPosition();
+    uint32_t senderIndex = IndexOf(sender);
+    bool senderStationary = m_entries[senderIndex].stationary;
+
+    // Receivers may have moved since they were binned.
+    double drift = m_maxSpeed * (Simulator::Now() - m_lastRefresh).GetSeconds();
+    int64_t span = int64_t(std::ceil((m_range + drift) / m_cellSize));
+    int64_t cx = CellCoordinate(origin.x);
+    int64_t cy = CellCoordinate(origin.y);
+
+    m_candidates.clear();
+    for (int64_t x = cx - span; x <= cx + span; x++)
+    {
+      for (int64_t y = cy - span; y <= cy + span; y++)
+      {
+        std::unordered_map<uint64_t, std::vector<uint32_t> >::const_iterator cell = m_cells.find(CellKey(x, y));
+        if (cell != m_cells.end())
+        {
+          m_candidates.insert(m_candidates.end(), cell->second.begin(), cell->second.end());
+        }
+      }
+    }
+    // Channel order, as YansWifiChannel::Send schedules them.
+    std::sort(m_candidates.begin(), m_candidates.end());
+
+    size_t n = m_candidates.size();
+    m_x.resize(n);
+    m_y.resize(n);
+    m_z.resize(n);
+    for (size_t i = 0; i < n; i++)
+    {
+      Vector position = m_entries[m_candidates[i]].mobility->GetPosition();
+      m_x[i] = position.x;
+      m_y[i] = position.y;
+      m_z[i] = position.z;
+    }
+    m_inRange.clear();
+    RangeFilter::Select(origin, m_range, m_x.data(), m_y.data(), m_z.data(), n, m_inRange);
+
+    for (size_t k = 0; k < m_inRange.size(); k++)
+    {
+      uint32_t index = m_candidates[m_inRange[k]];
+      const Entry &entry = m_entries[index];
+      Ptr<YansWifiPhy> receiver = entry.phy;
+      if (receiver == sender || receiver->GetChannelNumber() != sender->GetChannelNumber())
+      {
+        continue;
+      }
+      Time delay;
+      double rxPowerDbm;
+      bool cached = senderStationary && entry.stationary && m_paths.IsEnabled();
+      if (cached)
+      {
+        rxPowerDbm = m_paths.GetRxPower(senderIndex, index, txPowerDbm, senderMobility, entry.mobility, delay);
+      }
+      else
+      {
+        rxPowerDbm = m_loss->CalcRxPower(txPowerDbm, senderMobility, entry.mobility);
+      }
+      if (rxPowerDbm + receiver->GetRxGain() < receiver->GetRxSensitivity())
+      {
+        continue;
+      }
+      if (!cached)
+      {
+        delay = m_delay->GetDelay(senderMobility, entry.mobility);
+      }
+      Ptr<NetDevice> device = receiver->GetDevice();
+      uint32_t context = device == 0 ? 0xffffffff : device->GetNode()->GetId();
+      Simulator::ScheduleWithContext(context, delay, &SpatialYansWifiChannel::Receive,
+                                     receiver, Copy(ppdu), rxPowerDbm);
+    }
+  }
+
+  // Number of grid cells currently holding at least one PHY.
+  size_t GetNCells(void) const
+  {
+    return m_cells.size();
+  }
+
+  // Links whose loss and delay came from the cache, and were computed
+  // for it.
+  uint64_t GetPathCacheHits(void) const
+  {
+    return m_paths.GetHits();
+  }
+
+  uint64_t GetPathCacheMisses(void) const
+  {
+    return m_paths.GetMisses();
+  }
+
+protected:
+  virtual void DoDispose(void)
+  {
+    m_entries.clear();
+    m_cells.clear();
+    m_byMobility.clear();
+    m_paths.Clear();
+    m_loss = 0;
+    m_delay = 0;
+    YansWifiChannel::DoDispose();
+  }
+
+private:
+  struct Entry
+  {
+    Ptr<YansWifiPhy> phy;
+    Ptr<MobilityModel> mobility;
+    bool stationary;
+    uint64_t cell;
+    uint32_t slot;
+  };
+
+  static void Receive(Ptr<YansWifiPhy> phy, Ptr<WifiPpdu> ppdu, double rxPowerDbm)
+  {
+    RxPowerWattPerChannelBand rxPowerW;
+    rxPowerW.insert(std::make_pair(WifiSpectrumBand(0, 0), DbmToW(rxPowerDbm + phy->GetRxGain())));
+    phy->StartReceivePreamble(ppdu, rxPowerW);
+  }
+
+  static uint64_t CellKey(int64_t x, int64_t y)
+  {
+    return (uint64_t(uint32_t(int32_t(x))) << 32) | uint32_t(int32_t(y));
+  }
+
+  int64_t CellCoordinate(double v) const
+  {
+    return int64_t(std::floor(v / m_cellSize));
+  }
+
+  // Picks up PHYs added to the channel since the last transmission.
+  void Sync(void)
+  {
+    if (m_entries.size() == GetNDevices())
+    {
+      return;
+    }
+    if (m_loss == 0)
+    {
+      PointerValue loss;
+      PointerValue delay;
+      GetAttribute("PropagationLossModel", loss);
+      GetAttribute("PropagationDelayModel", delay);
+      m_loss = loss.Get<PropagationLossModel>();
+      m_delay = delay.Get<PropagationDelayModel>();
+      if (m_cachePaths)
+      {
+        m_paths.SetModels(m_loss, m_delay);
+      }
+    }
+    size_t first = m_entries.size();
+    for (size_t i = first; i < GetNDevices(); i++)
+    {
+      Entry entry;
+      entry.phy = DynamicCast<YansWifiPhy>(DynamicCast<WifiNetDevice>(GetDevice(i))->GetPhy());
+      entry.mobility = entry.phy->GetMobility();
+      NS_ABORT_MSG_IF(entry.mobility == 0, "SpatialYansWifiChannel needs a mobility model on every PHY");
+      entry.stationary = DynamicCast<ConstantPositionMobilityModel>(entry.mobility) != 0;
+      entry.cell = 0;
+      entry.slot = 0;
+      m_entries.push_back(entry);
+      m_byMobility[PeekPointer(entry.mobility)].push_back(i);
+      entry.mobility->TraceConnectWithoutContext("CourseChange",
+                                                 MakeCallback(&SpatialYansWifiChannel::CourseChanged, this));
+    }
+
+    // The cell size follows the range, so a new PHY with a stronger
+    // transmitter or a better receiver rebuilds the whole grid.
+    double range = m_userRange > 0 ? m_userRange : DetectionRange();
+    if (range != m_range)
+    {
+      m_range = range;
+      m_cellSize = range;
+      m_cells.clear();
+      m_moving.clear();
+      first = 0;
+    }
+    for (size_t i = first; i < m_entries.size(); i++)
+    {
+      Insert(i);
+    }
+    m_lastRefresh = Simulator::Now();
+    ScheduleRefresh();
+  }
+
+  // Distance beyond which the strongest transmitter cannot reach the most
+  // sensitive receiver, found by bisection on the loss model.
+  double DetectionRange(void)
+  {
+    double txDbm = -1e9;
+    double thresholdDbm = 1e9;
+    for (size_t i = 0; i < m_entries.size(); i++)
+    {
+      Ptr<YansWifiPhy> phy = m_entries[i].phy;
+      txDbm = std::max(txDbm, phy->GetTxPowerEnd() + phy->GetTxGain());
+      thresholdDbm = std::min(thresholdDbm, phy->GetRxSensitivity() - phy->GetRxGain());
+    }
+    Ptr<ConstantPositionMobilityModel> a = CreateObject<ConstantPositionMobilityModel>();
+    Ptr<ConstantPositionMobilityModel> b = CreateObject<ConstantPositionMobilityModel>();
+    double lo = 1.0;
+    double hi = 1.0;
+    do
+    {
+      lo = hi;
+      hi *= 2;
+      b->SetPosition(Vector(hi, 0, 0));
+    } while (m_loss->CalcRxPower(txDbm, a, b) >= thresholdDbm && hi < 1e7);
+    for (uint32_t i = 0; i < 64; i++)
+    {
+      double mid = 0.5 * (lo + hi);
+      b->SetPosition(Vector(mid, 0, 0));
+      if (m_loss->CalcRxPower(txDbm, a, b) >= thresholdDbm)
+      {
+        lo = mid;
+      }
+      else
+      {
+        hi = mid;
+      }
+    }
+    return hi + 1.0;
+  }
+
+  void Insert(uint32_t index)
+  {
+    Entry &entry = m_entries[index];
+    Vector pos = entry.mobility->GetPosition();
+    entry.cell = CellKey(CellCoordinate(pos.x), CellCoordinate(pos.y));
+    std::vector<uint32_t> &cell = m_cells[entry.cell];
+    entry.slot = cell.size();
+    cell.push_back(index);
+    double speed = entry.mobility->GetVelocity().GetLength();
+    m_maxSpeed = std::max(m_maxSpeed, SpeedBound(entry.mobility));
+    if (speed > 0)
+    {
+      m_moving.push_back(index);
+    }
+  }
+
+  void Move(uint32_t index)
+  {
+    Entry &entry = m_entries[index];
+    Vector pos = entry.mobility->GetPosition();
+    uint64_t key = CellKey(CellCoordinate(pos.x), CellCoordinate(pos.y));
+    m_maxSpeed = std::max(m_maxSpeed, SpeedBound(entry.mobility));
+    if (key == entry.cell)
+    {
+      return;
+    }
+    std::vector<uint32_t> &old = m_cells[entry.cell];
+    uint32_t last = old.back();
+    old[entry.slot] = last;
+    m_entries[last].slot = entry.slot;
+    old.pop_back();
+    if (old.empty())
+    {
+      m_cells.erase(entry.cell);
+    }
+    entry.cell = key;
+    std::vector<uint32_t> &cell = m_cells[key];
+    entry.slot = cell.size();
+    cell.push_back(index);
+  }
+
+  uint32_t IndexOf(Ptr<YansWifiPhy> phy) const
+  {
+    std::map<const MobilityModel *, std::vector<uint32_t> >::const_iterator it =
+        m_byMobility.find(PeekPointer(phy->GetMobility()));
+    NS_ASSERT(it != m_byMobility.end());
+    for (size_t i = 0; i < it->second.size(); i++)
+    {
+      if (m_entries[it->second[i]].phy == phy)
+      {
+        return it->second[i];
+      }
+    }
+    NS_FATAL_ERROR("PHY is not on this channel");
+    return 0;
+  }
+
+  // A trajectory model does not report its turns, so its largest
+  // possible speed is used instead of the current one.
+  static double SpeedBound(Ptr<MobilityModel> mobility)
+  {
+    Ptr<TrajectoryMobilityModel> trajectory = DynamicCast<TrajectoryMobilityModel>(mobility);
+    return trajectory ? trajectory->GetMaxSpeed() : mobility->GetVelocity().GetLength();
+  }
+
+  void CourseChanged(Ptr<const MobilityModel> mobility)
+  {
+    std::map<const MobilityModel *, std::vector<uint32_t> >::const_iterator it = m_byMobility.find(PeekPointer(mobility));
+    if (it == m_byMobility.end() || m_cellSize == 0.0)
+    {
+      return;
+    }
+    for (size_t i = 0; i < it->second.size(); i++)
+    {
+      m_paths.Invalidate(it->second[i]);
+      Move(it->second[i]);
+      if (mobility->GetVelocity().GetLength() > 0)
+      {
+        m_moving.push_back(it->second[i]);
+      }
+    }
+    ScheduleRefresh();
+  }
+
+  void ScheduleRefresh(void)
+  {
+    if (!m_refreshPending && !m_moving.empty())
+    {
+      m_refreshPending = true;
+      Simulator::Schedule(m_refresh, &SpatialYansWifiChannel::Refresh, this);
+    }
+  }
+
+  void Refresh(void)
+  {
+    m_refreshPending = false;
+    std::sort(m_moving.begin(), m_moving.end());
+    m_moving.erase(std::unique(m_moving.begin(), m_moving.end()), m_moving.end());
+    std::vector<uint32_t> stillMoving;
+    m_maxSpeed = 0.0;
+    for (size_t i = 0; i < m_moving.size(); i++)
+    {
+      Move(m_moving[i]);
+      if (m_entries[m_moving[i]].mobility->GetVelocity().GetLength() > 0)
+      {
+        stillMoving.push_back(m_moving[i]);
+      }
+    }
+    m_moving.swap(stillMoving);
+    m_lastRefresh = Simulator::Now();
+    ScheduleRefresh();
+  }
+
+  double m_userRange;
+  bool m_cachePaths;
+  double m_range;
+  Time m_refresh;
+  double m_cellSize;
+  double m_maxSpeed;
+  bool m_refreshPending;
+  Time m_lastRefresh;
+  Ptr<PropagationLossModel> m_loss;
+  Ptr<PropagationDelayModel> m_delay;
+  std::vector<Entry> m_entries;
+  std::unordered_map<uint64_t, std::vector<uint32_t> > m_cells;
+  std::map<const MobilityModel *, std::vector<uint32_t> > m_byMobility;
+  std::vector<uint32_t> m_moving;
+  std::vector<uint32_t> m_candidates;
+  std::vector<double> m_x;
+  std::vector<double> m_y;
+  std::vector<double> m_z;
+  std::vector<uint32_t> m_inRange;
+  PropagationPathCache m_paths;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(SpatialYansWifiChannel);
+
+// Yans PHY that hands its transmissions to a SpatialYansWifiChannel.
+class SpatialYansWifiPhy : public YansWifiPhy
+{
+public:
+  static TypeId GetTypeId(void)
+  {
+    static TypeId tid = TypeId("ns3::SpatialYansWifiPhy")
+                            .SetParent<YansWifiPhy>()
+                            .SetGroupName("Wifi")
+                            .AddConstructor<SpatialYansWifiPhy>();
+    return tid;
+  }
+
+  virtual void StartTx(Ptr<WifiPpdu> ppdu)
+  {
+    Ptr<SpatialYansWifiChannel> channel = DynamicCast<SpatialYansWifiChannel>(GetChannel());
+    if (channel == 0)
+    {
+      YansWifiPhy::StartTx(ppdu);
+      return;
+    }
+    channel->SendNearby(this, ppdu, GetTxPowerForTransmission(ppdu->GetTxVector()) + GetTxGain());
+  }
+};
+
+NS_OBJECT_ENSURE_REGISTERED(SpatialYansWifiPhy);
+
+// YansWifiPhyHelper creating SpatialYansWifiPhy objects.
+class SpatialYansWifiPhyHelper : public YansWifiPhyHelper
+{
+public:
+  SpatialYansWifiPhyHelper()
+  {
+    m_phy.SetTypeId("ns3::SpatialYansWifiPhy");
+  }
+};
+
+// Channel helper with the same defaults as YansWifiChannelHelper::Default().
+class SpatialYansWifiChannelHelper
+{
+public:
+  static SpatialYansWifiChannelHelper Default(void)
+  {
+    SpatialYansWifiChannelHelper helper;
+    helper.AddPropagationLoss("ns3::LogDistancePropagationLossModel");
+    helper.SetPropagationDelay("ns3::ConstantSpeedPropagationDelayModel");
+    return helper;
+  }
+
+  void AddPropagationLoss(const std::string &type)
+  {
+    ObjectFactory factory;
+    factory.SetTypeId(type);
+    m_loss.push_back(factory);
+  }
+
+  void SetPropagationDelay(const std::string &type)
+  {
+    m_delay.SetTypeId(type);
+  }
+
+  void SetChannelAttribute(const std::string &name, const AttributeValue &value)
+  {
+    m_attributes.push_back(std::make_pair(name, Ptr<AttributeValue>(value.Copy())));
+  }
+
+  Ptr<SpatialYansWifiChannel> Create(void) const
+  {
+    Ptr<SpatialYansWifiChannel> channel = CreateObject<SpatialYansWifiChannel>();
+    for (size_t i = 0; i < m_attributes.size(); i++)
+    {
+      channel->SetAttribute(m_attributes[i].first, *m_attributes[i].second);
+    }
+    Ptr<PropagationLossModel> prev;
+    for (size_t i = 0; i < m_loss.size(); i++)
+    {
+      Ptr<PropagationLossModel> cur = m_loss[i].Create<PropagationLossModel>();
+      if (prev == 0)
+      {
+        channel->SetPropagationLossModel(cur);
+      }
+      else
+      {
+        prev->SetNext(cur);
+      }
+      prev = cur;
+    }
+    channel->SetPropagationDelayModel(m_delay.Create<PropagationDelayModel>());
+    return channel;
+  }
+
+private:
+  std::vector<ObjectFactory> m_loss;
+  ObjectFactory m_delay;
+  std::vector<std::pair<std::string, Ptr<AttributeValue> > > m_attributes;
+};
+
+} // namespace ns3
+
+#endif /* SPATIAL_WIFI_CHANNEL_H */
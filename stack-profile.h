@@ -0,0 +1,231 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef STACK_PROFILE_H
+#define STACK_PROFILE_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/traffic-control-module.h"
+#include "ns3/wifi-module.h"
+#include "run-summary.h"
+
+#include <fstream>
+#include <malloc.h>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+// Internet stacks sized to what the nodes run:
+//
+//   full  InternetStackHelper: IPv4 and IPv6, ARP, ICMP, UDP, TCP, packet
+//         sockets, and a root queue disc on every device
+//   lean  IPv4, ARP, ICMP and UDP, TCP only where asked for, no root
+//         queue disc (the device queue is the only queue), and one
+//         error rate and preamble detection model shared by all Wi-Fi
+//         PHYs instead of one each
+//
+// Both use the same routing (static, then global) and addresses.  The
+// lean stack creates fewer random variables, so the random streams of
+// objects created after it, and with them the results, differ from a
+// full run with the same seed.
+//
+// The heap growth of each Install is recorded per node, from mallinfo2.
+class StackProfileHelper
+{
+public:
+  StackProfileHelper(const std::string &profile = "full")
+    : m_lean(profile == "lean"),
+      m_nodes(0),
+      m_installed(0)
+  {
+    NS_ABORT_MSG_UNLESS(profile == "full" || profile == "lean", "Unknown stack profile " << profile << ", use full or lean");
+  }
+
+  bool IsLean() const
+  {
+    return m_lean;
+  }
+
+  // Tcp only matters to the lean profile, the full one always has it.
+  void Install(const NodeContainer &nodes, bool tcp = false)
+  {
+    for (uint32_t i = 0; i < nodes.GetN(); i++)
+    {
+      Install(nodes.Get(i), tcp);
+    }
+  }
+
+  void Install(Ptr<Node> node, bool tcp = false)
+  {
+    uint64_t before = HeapInUse();
+    if (m_lean)
+    {
+      InstallLean(node, tcp);
+    }
+    else
+    {
+      m_full.Install(node);
+    }
+    uint64_t after = HeapInUse();
+    uint64_t used = after > before ? after - before : 0;
+    m_nodes++;
+    m_installed += used;
+    if (node->GetId() >= m_nodeBytes.size())
+    {
+      m_nodeBytes.resize(node->GetId() + 1, 0);
+    }
+    m_nodeBytes[node->GetId()] += used;
+  }
+
+  // Ipv4AddressHelper::Assign installs the default root queue disc; this
+  // takes it off the devices of a lean profile again.
+  void RemoveQueueDiscs(const NetDeviceContainer &devices) const
+  {
+    if (!m_lean)
+    {
+      return;
+    }
+    TrafficControlHelper tch;
+    for (uint32_t i = 0; i < devices.GetN(); i++)
+    {
+      Ptr<TrafficControlLayer> tc = devices.Get(i)->GetNode()->GetObject<TrafficControlLayer>();
+      if (tc && tc->GetRootQueueDiscOnDevice(devices.Get(i)))
+      {
+        tch.Uninstall(devices.Get(i));
+      }
+    }
+  }
+
+  // Gives the Wi-Fi PHYs among devices the profile's shared models.  The
+  // models only read their attributes, so sharing them does not change
+  // what the PHYs receive.
+  void ShareWifiModels(const NetDeviceContainer &devices)
+  {
+    if (!m_lean)
+    {
+      return;
+    }
+    if (m_errorRateModel == 0)
+    {
+      m_errorRateModel = CreateObject<TableBasedErrorRateModel>();
+      m_preambleDetectionModel = CreateObject<ThresholdPreambleDetectionModel>();
+    }
+    for (uint32_t i = 0; i < devices.GetN(); i++)
+    {
+      Ptr<WifiNetDevice> device = DynamicCast<WifiNetDevice>(devices.Get(i));
+      if (device)
+      {
+        device->GetPhy()->SetErrorRateModel(m_errorRateModel);
+        device->GetPhy()->SetPreambleDetectionModel(m_preambleDetectionModel);
+      }
+    }
+  }
+
+  // Adds stack_kb_per_node (heap taken by Install per node) and
+  // heap_mb / heap_kb_per_node (heap in use now, over all nodes).
+  void Summarize(RunSummary &summary) const
+  {
+    uint64_t heap = HeapInUse();
+    summary.Set("stack_kb_per_node", m_nodes ? m_installed / 1024.0 / m_nodes : 0.0);
+    summary.Set("heap_mb", heap / 1048576.0);
+    summary.Set("heap_kb_per_node", NodeList::GetNNodes() ? heap / 1024.0 / NodeList::GetNNodes() : 0.0);
+  }
+
+  // One row per node: node id and the heap bytes its stack took.
+  void WriteNodeMemory(const std::string &path) const
+  {
+    std::ofstream out(path.c_str());
+    NS_ABORT_MSG_UNLESS(out.is_open(), "Cannot write node memory report " << path);
+    out << "node,stack_bytes\n";
+    for (size_t i = 0; i < m_nodeBytes.size(); i++)
+    {
+      out << i << "," << m_nodeBytes[i] << "\n";
+    }
+  }
+
+  // Bytes of heap in use: allocated chunks plus mmap'ed blocks.
+  static uint64_t HeapInUse()
+  {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = mallinfo2();
+    return uint64_t(info.uordblks) + uint64_t(info.hblkhd);
+#elif defined(__GLIBC__)
+    // The int fields of mallinfo wrap past 2 GB.
+    struct mallinfo info = mallinfo();
+    return uint64_t(uint32_t(info.uordblks)) + uint64_t(uint32_t(info.hblkhd));
+#else
+    return 0;
+#endif
+  }
+
+private:
+  // What InternetStackHelper::Install does for IPv4, minus IPv6, packet
+  // sockets and (without tcp) TCP.
+  void InstallLean(Ptr<Node> node, bool tcp)
+  {
+    NS_ABORT_MSG_IF(node->GetObject<Ipv4>() != 0, "Node " << node->GetId() << " already has an IPv4 stack");
+    node->AggregateObject(CreateObject<ArpL3Protocol>());
+    node->AggregateObject(CreateObject<Ipv4L3Protocol>());
+    node->AggregateObject(CreateObject<Icmpv4L4Protocol>());
+    Ptr<Ipv4> ipv4 = node->GetObject<Ipv4>();
+    ipv4->SetRoutingProtocol(m_routing.Create(node));
+
+    Ptr<TrafficControlLayer> tc = CreateObject<TrafficControlLayer>();
+    node->AggregateObject(tc);
+    node->AggregateObject(CreateObject<UdpL4Protocol>());
+    if (tcp)
+    {
+      node->AggregateObject(CreateObject<TcpL4Protocol>());
+    }
+    node->GetObject<ArpL3Protocol>()->SetTrafficControl(tc);
+  }
+
+  // Same routing as InternetStackHelper's default.
+  class Routing
+  {
+  public:
+    Routing()
+    {
+      m_list.Add(m_static, 0);
+      m_list.Add(m_global, -10);
+    }
+
+    Ptr<Ipv4RoutingProtocol> Create(Ptr<Node> node) const
+    {
+      return m_list.Create(node);
+    }
+
+  private:
+    Ipv4StaticRoutingHelper m_static;
+    Ipv4GlobalRoutingHelper m_global;
+    Ipv4ListRoutingHelper m_list;
+  };
+
+  bool m_lean;
+  InternetStackHelper m_full;
+  Routing m_routing;
+  Ptr<ErrorRateModel> m_errorRateModel;
+  Ptr<PreambleDetectionModel> m_preambleDetectionModel;
+  std::vector<uint64_t> m_nodeBytes;
+  uint32_t m_nodes;
+  uint64_t m_installed;
+};
+
+} // namespace ns3
+
+#endif /* STACK_PROFILE_H */
@@ -0,0 +1,84 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef SWITCHED_LAN_HELPER_H
+#define SWITCHED_LAN_HELPER_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/csma-module.h"
+#include "ns3/bridge-module.h"
+
+#include <string>
+
+namespace ns3 {
+
+// A LAN built as a learning switch instead of one shared CSMA channel.
+//
+// Every host gets a CSMA link of its own to a port of the switch node,
+// whose BridgeNetDevice learns behind which port each MAC address is.  A
+// unicast frame then crosses two links and reaches one host, where on the
+// bus it is handed to every device of the LAN, so its cost no longer grows
+// with the LAN's size.  Broadcasts (ARP requests) and frames to addresses
+// not learnt yet are flooded, as on the bus.
+//
+// The hosts keep one CSMA device each, so addresses, global routing and
+// pcap tracing work as with CsmaHelper.  The switch node needs no internet
+// stack.  Frames are stored and forwarded, which adds one transmission
+// time per frame compared to the bus.
+class SwitchedLanHelper
+{
+public:
+  // DataRate and Delay of every host-to-switch link.
+  void SetChannelAttribute(const std::string &name, const AttributeValue &value)
+  {
+    m_csma.SetChannelAttribute(name, value);
+  }
+
+  void SetDeviceAttribute(const std::string &name, const AttributeValue &value)
+  {
+    m_csma.SetDeviceAttribute(name, value);
+  }
+
+  // E.g. ExpirationTime, how long the switch remembers where an address is.
+  void SetBridgeAttribute(const std::string &name, const AttributeValue &value)
+  {
+    m_bridge.SetDeviceAttribute(name, value);
+  }
+
+  // Links each host to a port of a switch on node sw, and returns the
+  // hosts' devices in the order of hosts.
+  NetDeviceContainer Install(const NodeContainer &hosts, Ptr<Node> sw)
+  {
+    NetDeviceContainer hostDevices;
+    NetDeviceContainer ports;
+    for (uint32_t i = 0; i < hosts.GetN(); i++)
+    {
+      NetDeviceContainer link = m_csma.Install(NodeContainer(hosts.Get(i), sw));
+      hostDevices.Add(link.Get(0));
+      ports.Add(link.Get(1));
+    }
+    m_bridge.Install(sw, ports);
+    return hostDevices;
+  }
+
+private:
+  CsmaHelper m_csma;
+  BridgeHelper m_bridge;
+};
+
+} // namespace ns3
+
+#endif /* SWITCHED_LAN_HELPER_H */
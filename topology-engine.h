@@ -0,0 +1,1809 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef TOPOLOGY_ENGINE_H
+#define TOPOLOGY_ENGINE_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/applications-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/csma-module.h"
+#include "ns3/traffic-control-module.h"
+#include "ns3/yans-wifi-helper.h"
+#include "ns3/ssid.h"
+
+#include "animation-stream.h"
+#include "fluid-background.h"
+#include "pcapng-writer.h"
+#include "phase-timer.h"
+#include "queue-telemetry.h"
+#include "spatial-wifi-channel.h"
+#include "stack-profile.h"
+#include "trajectory-mobility-model.h"
+#include "traffic-generators.h"
+#include "scalable-grid-position-allocator.h"
+#include "switched-lan-helper.h"
+#include "wifi-standard-helper.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Declarative topology files
+//
+// One statement per line, '#' starts a comment, values may be quoted.
+// ${...} is replaced by a variable or a small integer expression
+// (+ - * / and parentheses), so sizes can be changed from the command line.
+//
+//   set <var> <value>                       default for a variable
+//   node <name> [role=] [desc=] [pos=x,y] [size=] [rank=]
+//   nodes <group> <count> name=<prefix> [first=] [suffix=] [role=]
+//         [desc=] [pos=x,y] [step=dx,dy] [size=] [rank=]
+//   p2p <a> <b> rate= delay= net=<a.b.c.d/len> [aqm=] [bg=<rate>|<n>%]
+//       [bgProfile=cbr|poisson|onoff] [bgSize=]
+//   p2p <a> <group> rate= delay= pool=<a.b.c.d/len> [prefix=30] [aqm=]
+//       [bg=<rate>] [bgProfile=] [bgSize=]
+//   csma <lan> <members> rate= delay= net= [fabric=bus|switch]
+//   wifi <bss> ap= sta= ssid= net= grid=minX,minY,dX,dY,width
+//        bounds=xMin,xMax,yMin,yMax [layout=grid|scalable|list]
+//        [channel=yans|spatial] [mobility=walk|trajectory] [number=]
+//        [standard=] [width=] [manager=] [mcs=] [ampdu=] [amsdu=]
+//   campus <group> aps= sta= uplink= rate= delay= pool=<a.b.c.d/len>
+//          [prefix=30] net=<a.b.c.d/len> [subnet=24] bounds= [ssid=]
+//          [channels=] [role=] [desc=] [size=] [channel=] [mobility=]
+//          [standard=] [width=] [manager=] [mcs=] [ampdu=] [amsdu=]
+//   server <node> port= start= stop=
+//   flow <src> <dst> port= packets= interval= size= start= stop= [via=<net>]
+//        [profile=echo|cbr|poisson|onoff|web|bulk] [rate=]
+//   stop <time>
+//   repeat <var> <count> ... end
+//
+// A flow is a UdpEcho client sending to a server.  With a profile other
+// than echo, a load generator (traffic-generators.h) runs next to the
+// echo client between the same nodes and times, sending size-byte
+// packets at rate to a packet sink on port+1000 of the destination, so
+// the echo round trip times are measured under load.
+//
+// aqm=none|fqcodel|pie|red marks a p2p link as a bottleneck and puts that
+// queue disc on both its devices (see queue-telemetry.h); none keeps the
+// stack's default.  The devices of marked links are the ones
+// TrackBottlenecks reports on.
+//
+// bg= loads a p2p link in both directions with background traffic of
+// bgProfile (poisson by default) in bgSize-byte packets (1000), at a rate
+// or at a percentage of the link's rate, from the start to the stop of
+// the run.  SetBackgroundMode chooses whether it is simulated as packets
+// or as a fluid (see fluid-background.h); either way it replaces the
+// link's queue discs, so it does not go with an AQM.  A zero rate leaves
+// the link unloaded.
+//
+// A csma LAN is one shared channel (fabric=bus), or a learning switch
+// with a link of its own to every member (fabric=switch, see
+// switched-lan-helper.h); the switch node comes after the file's nodes.
+//
+// A BSS is on a channel object of its own unless number= gives it a
+// channel number; BSSs with the same number share one channel object, so
+// a transmission only reaches the PHYs of its frequency.  With
+// layout=list the stations start at their pos=.  standard=, width=,
+// manager=, mcs=, ampdu= and amsdu= choose the BSS's Wi-Fi standard,
+// channel width, rate manager and aggregation (see
+// wifi-standard-helper.h); number= must be in the standard's band.
+//
+// A campus is a building-wide Wi-Fi: aps= access points, the group's
+// members, sit on a grid over the bounds, each with a pooled
+// point-to-point uplink to the uplink node and a BSS of its own (SSID
+// <ssid>-<i>, a subnet= sized block of net=).  Each AP takes the one of
+// the first channels= non-overlapping channels of its width= whose
+// nearest co-channel AP is the farthest away; the stations start spread
+// over the bounds and join the nearest AP.  These are 5 GHz channels, so
+// standard= is a, n-5, ac or ax-5.  There are 25 channels of 20 MHz (also
+// for width=0), 12 of 40, 6 of 80 and 2 of 160; channels= beyond that
+// uses them all.
+//
+// A node reference is a node name, a group name (all members, where a list
+// is accepted) or <group>[i], with negative i counting from the end.
+// "%" in a group description is replaced by the member's number.
+//
+// Nodes are created in declaration order, so node ids (and with them pcap
+// file names and NetAnim ids) follow the file.  Links are installed one
+// link class at a time (p2p, csma, wifi) with one helper per distinct
+// attribute set, and addresses are computed arithmetically from each
+// subnet instead of going through Ipv4AddressGenerator, whose allocation
+// list is scanned linearly on every address.
+
+namespace ns3 {
+
+struct TopologySubnet
+{
+  Ipv4Address network;
+  Ipv4Mask mask;
+};
+
+struct TopologyNodeSpec
+{
+  std::string name;
+  std::string role;
+  std::string description;
+  bool hasPosition;
+  double x;
+  double y;
+  double size;
+  int32_t rank;
+};
+
+struct TopologyP2pSpec
+{
+  uint32_t a;
+  uint32_t b;
+  std::string rate;
+  std::string delay;
+  TopologySubnet subnet;
+  std::string aqm; // empty unless a bottleneck
+  std::string bgRate; // empty unless loaded
+  std::string bgProfile;
+  uint32_t bgSize;
+};
+
+struct TopologyCsmaSpec
+{
+  std::string name;
+  std::vector<uint32_t> members;
+  std::string rate;
+  std::string delay;
+  TopologySubnet subnet;
+  bool switched;
+};
+
+struct TopologyWifiSpec
+{
+  std::string name;
+  uint32_t ap;
+  std::vector<uint32_t> stations;
+  std::string ssid;
+  TopologySubnet subnet;
+  double minX;
+  double minY;
+  double deltaX;
+  double deltaY;
+  uint32_t gridWidth;
+  Rectangle bounds;
+  std::string layout;
+  bool spatialChannel;
+  bool trajectoryMobility;
+  uint32_t channelNumber;
+  WifiStandardHelper radio;
+};
+
+struct TopologyServerSpec
+{
+  uint32_t node;
+  uint16_t port;
+  Time start;
+  Time stop;
+};
+
+struct TopologyFlowSpec
+{
+  uint32_t src;
+  uint32_t dst;
+  bool hasVia;
+  TopologySubnet via;
+  uint16_t port;
+  uint32_t packets;
+  Time interval;
+  uint32_t size;
+  Time start;
+  Time stop;
+  std::string profile;
+  std::string rate;
+};
+
+// Parsed form of a topology file.
+class TopologySpec
+{
+public:
+  TopologySpec()
+    : stopTime(Seconds(10.0))
+  {
+  }
+
+  // Variables set here win over "set" statements in the file.
+  void SetVariable(const std::string &name, const std::string &value)
+  {
+    m_vars[name] = value;
+    m_fixed[name] = true;
+  }
+
+  std::string GetVariable(const std::string &name) const
+  {
+    std::map<std::string, std::string>::const_iterator it = m_vars.find(name);
+    NS_ABORT_MSG_IF(it == m_vars.end(), "Unknown topology variable " << name);
+    return it->second;
+  }
+
+  const std::map<std::string, std::string> &GetVariables() const
+  {
+    return m_vars;
+  }
+
+  void Load(const std::string &path)
+  {
+    std::ifstream in(path.c_str());
+    NS_ABORT_MSG_UNLESS(in.is_open(), "Cannot open topology file " << path);
+    std::vector<Line> lines;
+    std::string text;
+    uint32_t number = 0;
+    while (std::getline(in, text))
+    {
+      Line line;
+      line.file = path;
+      line.number = ++number;
+      line.text = text;
+      lines.push_back(line);
+    }
+    Run(lines, 0, lines.size());
+  }
+
+  // Returns the id of the node or group member a reference names.
+  uint32_t GetNodeId(const std::string &ref) const
+  {
+    std::vector<uint32_t> ids = ResolveNodes(ref);
+    NS_ABORT_MSG_UNLESS(ids.size() == 1, "Reference " << ref << " does not name a single node");
+    return ids[0];
+  }
+
+  std::vector<TopologyNodeSpec> nodes;
+  std::vector<TopologyP2pSpec> p2pLinks;
+  std::vector<TopologyCsmaSpec> lans;
+  std::vector<TopologyWifiSpec> bsss;
+  std::vector<TopologyServerSpec> servers;
+  std::vector<TopologyFlowSpec> flows;
+  Time stopTime;
+
+private:
+  struct Line
+  {
+    std::string file;
+    uint32_t number;
+    std::string text;
+  };
+
+  typedef std::vector<std::string> Tokens;
+  typedef std::map<std::string, std::string> Options;
+
+  void Run(const std::vector<Line> &lines, size_t begin, size_t end)
+  {
+    for (size_t i = begin; i < end; i++)
+    {
+      m_where = lines[i].file + ":" + std::to_string(lines[i].number);
+      Tokens tokens = Tokenize(Substitute(lines[i].text));
+      if (tokens.empty())
+      {
+        continue;
+      }
+      if (tokens[0] == "repeat")
+      {
+        size_t close = FindEnd(lines, i + 1, end);
+        Expect(tokens.size() == 3, "repeat <var> <count>");
+        std::string var = tokens[1];
+        int64_t count = ToInt(tokens[2]);
+        for (int64_t k = 0; k < count; k++)
+        {
+          m_vars[var] = std::to_string(k);
+          Run(lines, i + 1, close);
+        }
+        m_vars.erase(var);
+        i = close;
+        continue;
+      }
+      NS_ABORT_MSG_IF(tokens[0] == "end", m_where << ": end without repeat");
+      Statement(tokens);
+    }
+  }
+
+  size_t FindEnd(const std::vector<Line> &lines, size_t begin, size_t end) const
+  {
+    uint32_t depth = 0;
+    for (size_t i = begin; i < end; i++)
+    {
+      Tokens tokens = Tokenize(lines[i].text);
+      if (tokens.empty())
+      {
+        continue;
+      }
+      if (tokens[0] == "repeat")
+      {
+        depth++;
+      }
+      else if (tokens[0] == "end")
+      {
+        if (depth == 0)
+        {
+          return i;
+        }
+        depth--;
+      }
+    }
+    NS_FATAL_ERROR(m_where << ": repeat without end");
+    return end;
+  }
+
+  void Statement(const Tokens &tokens)
+  {
+    Tokens args;
+    Options opts;
+    for (size_t i = 1; i < tokens.size(); i++)
+    {
+      size_t eq = tokens[i].find('=');
+      if (eq == std::string::npos)
+      {
+        args.push_back(tokens[i]);
+      }
+      else
+      {
+        opts[tokens[i].substr(0, eq)] = tokens[i].substr(eq + 1);
+      }
+    }
+
+    const std::string &kind = tokens[0];
+    if (kind == "set")
+    {
+      Expect(args.size() == 2, "set <var> <value>");
+      if (!m_fixed.count(args[0]))
+      {
+        m_vars[args[0]] = args[1];
+      }
+    }
+    else if (kind == "node")
+    {
+      Expect(args.size() == 1, "node <name>");
+      AddNode(args[0], opts, 0);
+    }
+    else if (kind == "nodes")
+    {
+      Expect(args.size() == 2, "nodes <group> <count>");
+      Expect(!m_refs.count(args[0]), "duplicate name " + args[0]);
+      int64_t count = ToInt(args[1]);
+      int64_t first = opts.count("first") ? ToInt(opts["first"]) : 1;
+      std::string prefix = Require(opts, "name");
+      std::string suffix = opts.count("suffix") ? opts["suffix"] : "";
+      std::vector<uint32_t> group;
+      for (int64_t k = 0; k < count; k++)
+      {
+        std::string number = std::to_string(first + k);
+        Options member = opts;
+        if (member.count("desc"))
+        {
+          size_t pct = member["desc"].find('%');
+          if (pct != std::string::npos)
+          {
+            member["desc"].replace(pct, 1, number);
+          }
+        }
+        group.push_back(AddNode(prefix + number + suffix, member, k));
+      }
+      m_refs[args[0]] = group;
+    }
+    else if (kind == "p2p")
+    {
+      Expect(args.size() == 2, "p2p <a> <b>");
+      uint32_t a = OneNode(args[0]);
+      std::vector<uint32_t> peers = ResolveNodes(args[1]);
+      AddPointToPoint(a, peers, opts);
+    }
+    else if (kind == "csma")
+    {
+      Expect(args.size() == 2, "csma <lan> <members>");
+      TopologyCsmaSpec lan;
+      lan.name = args[0];
+      lan.members = ResolveList(args[1]);
+      lan.rate = Require(opts, "rate");
+      lan.delay = Require(opts, "delay");
+      lan.subnet = ParseSubnet(Require(opts, "net"));
+      std::string fabric = opts.count("fabric") ? opts["fabric"] : "bus";
+      Expect(fabric == "bus" || fabric == "switch", "fabric= is bus or switch");
+      lan.switched = fabric == "switch";
+      lans.push_back(lan);
+    }
+    else if (kind == "wifi")
+    {
+      Expect(args.size() == 1, "wifi <bss>");
+      TopologyWifiSpec bss;
+      bss.name = args[0];
+      bss.ap = OneNode(Require(opts, "ap"));
+      bss.stations = ResolveList(Require(opts, "sta"));
+      bss.ssid = Require(opts, "ssid");
+      bss.subnet = ParseSubnet(Require(opts, "net"));
+      bss.layout = opts.count("layout") ? opts["layout"] : "grid";
+      Expect(bss.layout == "grid" || bss.layout == "scalable" || bss.layout == "list",
+             "layout is grid, scalable or list");
+      std::vector<double> grid = bss.layout == "grid" ? ToDoubles(Require(opts, "grid"), 5)
+                                                      : std::vector<double>(5, 0.0);
+      bss.minX = grid[0];
+      bss.minY = grid[1];
+      bss.deltaX = grid[2];
+      bss.deltaY = grid[3];
+      bss.gridWidth = uint32_t(grid[4]);
+      std::vector<double> b = ToDoubles(Require(opts, "bounds"), 4);
+      bss.bounds = Rectangle(b[0], b[1], b[2], b[3]);
+      SetWifiModels(bss, opts);
+      bss.channelNumber = opts.count("number") ? uint32_t(ToInt(opts["number"])) : 0;
+      Expect(bss.channelNumber == 0 || (bss.channelNumber <= 14) == bss.radio.Is24Ghz(),
+             "number= is not a channel of 802.11" + bss.radio.GetStandard());
+      bsss.push_back(bss);
+    }
+    else if (kind == "campus")
+    {
+      Expect(args.size() == 1, "campus <group>");
+      AddCampus(args[0], opts);
+    }
+    else if (kind == "server")
+    {
+      Expect(args.size() == 1, "server <node>");
+      TopologyServerSpec server;
+      server.node = OneNode(args[0]);
+      server.port = uint16_t(ToInt(Require(opts, "port")));
+      server.start = Time(Require(opts, "start"));
+      server.stop = Time(Require(opts, "stop"));
+      servers.push_back(server);
+    }
+    else if (kind == "flow")
+    {
+      Expect(args.size() == 2, "flow <src> <dst>");
+      TopologyFlowSpec flow;
+      flow.src = OneNode(args[0]);
+      flow.dst = OneNode(args[1]);
+      flow.hasVia = opts.count("via") != 0;
+      if (flow.hasVia)
+      {
+        flow.via = ParseSubnet(opts["via"]);
+      }
+      flow.port = uint16_t(ToInt(Require(opts, "port")));
+      flow.packets = uint32_t(ToInt(Require(opts, "packets")));
+      flow.interval = Time(Require(opts, "interval"));
+      flow.size = uint32_t(ToInt(Require(opts, "size")));
+      flow.start = Time(Require(opts, "start"));
+      flow.stop = Time(Require(opts, "stop"));
+      flow.profile = opts.count("profile") ? opts["profile"] : "echo";
+      Expect(flow.profile == "echo" || WorkloadHelper::IsProfile(flow.profile), "unknown profile " + flow.profile);
+      flow.rate = opts.count("rate") ? opts["rate"] : "1Mbps";
+      flows.push_back(flow);
+    }
+    else if (kind == "stop")
+    {
+      Expect(args.size() == 1, "stop <time>");
+      stopTime = Time(args[0]);
+    }
+    else
+    {
+      NS_FATAL_ERROR(m_where << ": unknown statement " << kind);
+    }
+  }
+
+  // Links a to each peer; with pool=, every link gets the next
+  // prefix= sized block of the pool.
+  void AddPointToPoint(uint32_t a, const std::vector<uint32_t> &peers, Options &opts)
+  {
+    bool pooled = opts.count("pool") != 0;
+    Expect(pooled || peers.size() == 1, "p2p to a group needs pool=");
+    TopologySubnet pool = ParseSubnet(pooled ? opts["pool"] : Require(opts, "net"));
+    int64_t prefix = opts.count("prefix") ? ToInt(opts["prefix"]) : 30;
+    Expect(prefix >= 1 && prefix <= 30, "prefix= must be between 1 and 30");
+    uint32_t block = pooled ? (1u << (32 - prefix)) : 0;
+    for (size_t k = 0; k < peers.size(); k++)
+    {
+      TopologyP2pSpec link;
+      link.a = a;
+      link.b = peers[k];
+      link.rate = Require(opts, "rate");
+      link.delay = Require(opts, "delay");
+      link.subnet = pool;
+      link.aqm = opts.count("aqm") ? opts["aqm"] : "";
+      Expect(link.aqm.empty() || link.aqm == "none" || link.aqm == "fqcodel" || link.aqm == "pie" ||
+                 link.aqm == "red",
+             "aqm is none, fqcodel, pie or red");
+      link.bgRate = opts.count("bg") ? BackgroundRate(opts["bg"], link.rate) : "";
+      link.bgProfile = opts.count("bgProfile") ? opts["bgProfile"] : "poisson";
+      Expect(BackgroundLoad::IsProfile(link.bgProfile), "bgProfile is cbr, poisson or onoff");
+      link.bgSize = opts.count("bgSize") ? uint32_t(ToInt(opts["bgSize"])) : 1000;
+      Expect(link.bgRate.empty() || link.aqm.empty() || link.aqm == "none", "bg= does not go with an AQM");
+      if (pooled)
+      {
+        uint64_t base = uint64_t(pool.network.Get()) + uint64_t(block) * k;
+        Expect(base + block <= uint64_t(pool.network.Get()) + (~pool.mask.Get() + uint64_t(1)),
+               "pool " + opts["pool"] + " is too small");
+        link.subnet.network = Ipv4Address(uint32_t(base));
+        link.subnet.mask = Ipv4Mask(~uint32_t(block - 1));
+      }
+      p2pLinks.push_back(link);
+    }
+  }
+
+  // A rate, or a percentage of the link's rate; empty when zero.
+  std::string BackgroundRate(const std::string &bg, const std::string &rate) const
+  {
+    uint64_t bps;
+    if (!bg.empty() && bg[bg.size() - 1] == '%')
+    {
+      double percent = ToDoubles(bg.substr(0, bg.size() - 1), 1)[0];
+      Expect(percent >= 0, "bg= percentage is negative");
+      bps = uint64_t(DataRate(rate).GetBitRate() * percent / 100);
+    }
+    else
+    {
+      bps = DataRate(bg).GetBitRate();
+    }
+    return bps > 0 ? std::to_string(bps) + "bps" : "";
+  }
+
+  // Radio channel, mobility model and Wi-Fi standard options shared by
+  // wifi and campus.
+  void SetWifiModels(TopologyWifiSpec &bss, Options &opts) const
+  {
+    std::string channel = opts.count("channel") ? opts["channel"] : "yans";
+    Expect(channel == "yans" || channel == "spatial", "channel is yans or spatial");
+    bss.spatialChannel = channel == "spatial";
+    std::string mobility = opts.count("mobility") ? opts["mobility"] : "walk";
+    Expect(mobility == "walk" || mobility == "trajectory", "mobility is walk or trajectory");
+    bss.trajectoryMobility = mobility == "trajectory";
+
+    bss.radio.SetStandard(opts.count("standard") ? opts["standard"] : "a");
+    bss.radio.SetChannelWidth(uint32_t(ToCount(opts, "width", 0)));
+    bss.radio.SetRemoteStationManager(opts.count("manager") ? opts["manager"] : "aarf",
+                                      uint32_t(ToCount(opts, "mcs", 0)));
+    bss.radio.SetAggregation(uint32_t(ToCount(opts, "ampdu", 65535)), uint32_t(ToCount(opts, "amsdu", 0)));
+    std::string error = bss.radio.Check();
+    Expect(error.empty(), error);
+  }
+
+  // A non-negative integer option, or fallback when it is not given.
+  int64_t ToCount(Options &opts, const std::string &name, int64_t fallback) const
+  {
+    if (!opts.count(name))
+    {
+      return fallback;
+    }
+    int64_t value = ToInt(opts[name]);
+    Expect(value >= 0 && value <= 0xffffffffLL, name + "= must be a non-negative integer");
+    return value;
+  }
+
+  // Expands a campus statement into nodes, uplinks and BSSs.
+  void AddCampus(const std::string &group, Options &opts)
+  {
+    Expect(!m_refs.count(group), "duplicate name " + group);
+    TopologyWifiSpec models;
+    SetWifiModels(models, opts);
+    Expect(!models.radio.Is24Ghz(), "a campus is on 5 GHz channels: standard= is a, n-5, ac or ax-5");
+    std::vector<uint32_t> channels = GetCampusChannels(models.radio.GetChannelWidth());
+    int64_t count = ToInt(Require(opts, "aps"));
+    Expect(count > 0, "aps= must be positive");
+    std::vector<uint32_t> stations = ResolveList(Require(opts, "sta"));
+    uint32_t uplink = OneNode(Require(opts, "uplink"));
+    Require(opts, "pool");
+    std::vector<double> b = ToDoubles(Require(opts, "bounds"), 4);
+    Rectangle bounds(b[0], b[1], b[2], b[3]);
+    TopologySubnet net = ParseSubnet(Require(opts, "net"));
+    int64_t prefix = opts.count("subnet") ? ToInt(opts["subnet"]) : 24;
+    Expect(prefix >= net.mask.GetPrefixLength() && prefix <= 30, "subnet= must be between the net= length and 30");
+    uint64_t block = uint64_t(1) << (32 - prefix);
+    Expect(uint64_t(count) * block <= uint64_t(~net.mask.Get()) + 1,
+           "net " + opts["net"] + " is too small for " + std::to_string(count) + " subnets");
+    // Fewer channels of a wider width.
+    int64_t nChannels = opts.count("channels") ? ToInt(opts["channels"]) : channels.size();
+    Expect(nChannels >= 1 && nChannels <= 25, "channels= is between 1 and 25");
+    nChannels = std::min<int64_t>(nChannels, channels.size());
+    std::string ssid = opts.count("ssid") ? opts["ssid"] : group;
+
+    Options member;
+    member["role"] = opts.count("role") ? opts["role"] : "router";
+    member["desc"] = opts.count("desc") ? opts["desc"] : "WiFi AP %";
+    if (opts.count("size"))
+    {
+      member["size"] = opts["size"];
+    }
+    std::vector<uint32_t> aps;
+    std::vector<uint32_t> apChannels;
+    for (int64_t k = 0; k < count; k++)
+    {
+      std::string number = std::to_string(k + 1);
+      Options ap = member;
+      size_t pct = ap["desc"].find('%');
+      if (pct != std::string::npos)
+      {
+        ap["desc"].replace(pct, 1, number);
+      }
+      uint32_t id = AddNode(group + number, ap, k);
+      Vector position = ScalableGridPositionAllocator::GetPosition(bounds, count, k);
+      nodes[id].hasPosition = true;
+      nodes[id].x = position.x;
+      nodes[id].y = position.y;
+
+      // Farthest co-channel AP first, lowest channel on a tie.
+      double best = -1;
+      uint32_t choice = 0;
+      for (uint32_t c = 0; c < nChannels; c++)
+      {
+        double nearest = std::numeric_limits<double>::infinity();
+        for (size_t j = 0; j < aps.size(); j++)
+        {
+          if (apChannels[j] == c)
+          {
+            nearest = std::min(nearest, Distance(nodes[aps[j]], nodes[id]));
+          }
+        }
+        if (nearest > best)
+        {
+          best = nearest;
+          choice = c;
+        }
+      }
+      aps.push_back(id);
+      apChannels.push_back(choice);
+    }
+    m_refs[group] = aps;
+    AddPointToPoint(uplink, aps, opts);
+
+    std::vector<std::vector<uint32_t> > members(count);
+    for (size_t k = 0; k < stations.size(); k++)
+    {
+      TopologyNodeSpec &station = nodes[stations[k]];
+      Vector position = ScalableGridPositionAllocator::GetPosition(bounds, stations.size(), k);
+      station.hasPosition = true;
+      station.x = position.x;
+      station.y = position.y;
+      size_t nearest = 0;
+      for (size_t j = 1; j < aps.size(); j++)
+      {
+        if (Distance(nodes[aps[j]], station) < Distance(nodes[aps[nearest]], station))
+        {
+          nearest = j;
+        }
+      }
+      members[nearest].push_back(stations[k]);
+    }
+
+    for (int64_t k = 0; k < count; k++)
+    {
+      TopologyWifiSpec bss;
+      bss.name = nodes[aps[k]].name;
+      bss.ap = aps[k];
+      bss.stations = members[k];
+      // One SSID per AP, so a station cannot associate with a co-channel AP
+      // farther away.
+      bss.ssid = ssid + "-" + std::to_string(k + 1);
+      bss.subnet.network = Ipv4Address(uint32_t(net.network.Get() + block * k));
+      bss.subnet.mask = Ipv4Mask(~uint32_t(block - 1));
+      bss.layout = "list";
+      bss.minX = 0;
+      bss.minY = 0;
+      bss.deltaX = 0;
+      bss.deltaY = 0;
+      bss.gridWidth = 0;
+      bss.bounds = bounds;
+      SetWifiModels(bss, opts);
+      bss.channelNumber = channels[apChannels[k]];
+      bsss.push_back(bss);
+    }
+  }
+
+  // Non-overlapping 5 GHz channels of a width, by the number of their
+  // center frequency; 20 MHz ones for width 0.
+  static std::vector<uint32_t> GetCampusChannels(uint32_t width)
+  {
+    static const uint32_t mhz20[] = {36,  40,  44,  48,  52,  56,  60,  64,  100, 104, 108, 112, 116,
+                                     120, 124, 128, 132, 136, 140, 144, 149, 153, 157, 161, 165};
+    static const uint32_t mhz40[] = {38, 46, 54, 62, 102, 110, 118, 126, 134, 142, 151, 159};
+    static const uint32_t mhz80[] = {42, 58, 106, 122, 138, 155};
+    static const uint32_t mhz160[] = {50, 114};
+    if (width == 40)
+    {
+      return std::vector<uint32_t>(mhz40, mhz40 + sizeof(mhz40) / sizeof(mhz40[0]));
+    }
+    if (width == 80)
+    {
+      return std::vector<uint32_t>(mhz80, mhz80 + sizeof(mhz80) / sizeof(mhz80[0]));
+    }
+    if (width == 160)
+    {
+      return std::vector<uint32_t>(mhz160, mhz160 + sizeof(mhz160) / sizeof(mhz160[0]));
+    }
+    return std::vector<uint32_t>(mhz20, mhz20 + sizeof(mhz20) / sizeof(mhz20[0]));
+  }
+
+  static double Distance(const TopologyNodeSpec &a, const TopologyNodeSpec &b)
+  {
+    return std::hypot(a.x - b.x, a.y - b.y);
+  }
+
+  uint32_t AddNode(const std::string &name, Options &opts, double k)
+  {
+    Expect(!m_refs.count(name), "duplicate name " + name);
+    TopologyNodeSpec node;
+    node.name = name;
+    node.role = opts.count("role") ? opts["role"] : "server";
+    node.description = opts.count("desc") ? opts["desc"] : name;
+    node.hasPosition = opts.count("pos") != 0;
+    node.x = 0;
+    node.y = 0;
+    if (node.hasPosition)
+    {
+      std::vector<double> pos = ToDoubles(opts["pos"], 2);
+      std::vector<double> step(2, 0.0);
+      if (opts.count("step"))
+      {
+        step = ToDoubles(opts["step"], 2);
+      }
+      node.x = pos[0] + k * step[0];
+      node.y = pos[1] + k * step[1];
+    }
+    node.size = opts.count("size") ? std::atof(opts["size"].c_str()) : 20.0;
+    node.rank = opts.count("rank") ? int32_t(ToInt(opts["rank"])) : -1;
+    uint32_t id = nodes.size();
+    nodes.push_back(node);
+    m_refs[name] = std::vector<uint32_t>(1, id);
+    return id;
+  }
+
+  std::vector<uint32_t> ResolveNodes(const std::string &ref) const
+  {
+    size_t open = ref.find('[');
+    if (open != std::string::npos && ref[ref.size() - 1] == ']')
+    {
+      std::map<std::string, std::vector<uint32_t> >::const_iterator it = m_refs.find(ref.substr(0, open));
+      NS_ABORT_MSG_IF(it == m_refs.end(), m_where << ": unknown group in " << ref);
+      int64_t index = ToInt(ref.substr(open + 1, ref.size() - open - 2));
+      int64_t size = it->second.size();
+      if (index < 0)
+      {
+        index += size;
+      }
+      NS_ABORT_MSG_UNLESS(index >= 0 && index < size, m_where << ": " << ref << " is out of range");
+      return std::vector<uint32_t>(1, it->second[index]);
+    }
+    std::map<std::string, std::vector<uint32_t> >::const_iterator it = m_refs.find(ref);
+    NS_ABORT_MSG_IF(it == m_refs.end(), m_where << ": unknown node " << ref);
+    return it->second;
+  }
+
+  uint32_t OneNode(const std::string &ref) const
+  {
+    std::vector<uint32_t> ids = ResolveNodes(ref);
+    NS_ABORT_MSG_UNLESS(ids.size() == 1, m_where << ": " << ref << " is a group, expected one node");
+    return ids[0];
+  }
+
+  std::vector<uint32_t> ResolveList(const std::string &list) const
+  {
+    std::vector<uint32_t> ids;
+    std::stringstream ss(list);
+    std::string ref;
+    while (std::getline(ss, ref, ','))
+    {
+      std::vector<uint32_t> part = ResolveNodes(ref);
+      ids.insert(ids.end(), part.begin(), part.end());
+    }
+    return ids;
+  }
+
+  TopologySubnet ParseSubnet(const std::string &text) const
+  {
+    size_t slash = text.find('/');
+    Expect(slash != std::string::npos, "subnet " + text + " needs a /length");
+    TopologySubnet subnet;
+    subnet.mask = Ipv4Mask(("/" + text.substr(slash + 1)).c_str());
+    subnet.network = Ipv4Address(text.substr(0, slash).c_str()).CombineMask(subnet.mask);
+    return subnet;
+  }
+
+  std::vector<double> ToDoubles(const std::string &text, size_t count) const
+  {
+    std::vector<double> values;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+      values.push_back(std::atof(item.c_str()));
+    }
+    Expect(values.size() == count, "expected " + std::to_string(count) + " values in " + text);
+    return values;
+  }
+
+  int64_t ToInt(const std::string &text) const
+  {
+    char *end = 0;
+    long long value = std::strtoll(text.c_str(), &end, 10);
+    Expect(!text.empty() && *end == '\0', "expected an integer, got " + text);
+    return value;
+  }
+
+  std::string Require(Options &opts, const std::string &key) const
+  {
+    Expect(opts.count(key) != 0, "missing " + key + "=");
+    return opts[key];
+  }
+
+  void Expect(bool condition, const std::string &what) const
+  {
+    NS_ABORT_MSG_UNLESS(condition, m_where << ": " << what);
+  }
+
+  Tokens Tokenize(const std::string &text) const
+  {
+    Tokens tokens;
+    std::string current;
+    bool quoted = false;
+    bool any = false;
+    for (size_t i = 0; i < text.size(); i++)
+    {
+      char c = text[i];
+      if (c == '"')
+      {
+        quoted = !quoted;
+        any = true;
+      }
+      else if (!quoted && c == '#')
+      {
+        break;
+      }
+      else if (!quoted && std::isspace(static_cast<unsigned char>(c)))
+      {
+        if (any)
+        {
+          tokens.push_back(current);
+        }
+        current.clear();
+        any = false;
+      }
+      else
+      {
+        current += c;
+        any = true;
+      }
+    }
+    if (any)
+    {
+      tokens.push_back(current);
+    }
+    return tokens;
+  }
+
+  std::string Substitute(const std::string &text) const
+  {
+    std::string out;
+    size_t pos = 0;
+    while (true)
+    {
+      size_t open = text.find("${", pos);
+      if (open == std::string::npos)
+      {
+        out += text.substr(pos);
+        return out;
+      }
+      size_t close = text.find('}', open);
+      Expect(close != std::string::npos, "unterminated ${");
+      out += text.substr(pos, open - pos);
+      std::string expr = text.substr(open + 2, close - open - 2);
+      std::map<std::string, std::string>::const_iterator var = m_vars.find(expr);
+      if (var != m_vars.end())
+      {
+        out += var->second;
+      }
+      else
+      {
+        size_t at = 0;
+        int64_t value = Sum(expr, at);
+        Skip(expr, at);
+        Expect(at == expr.size(), "cannot evaluate ${" + expr + "}");
+        out += std::to_string(value);
+      }
+      pos = close + 1;
+    }
+  }
+
+  // Integer expressions inside ${...}.
+  void Skip(const std::string &e, size_t &at) const
+  {
+    while (at < e.size() && std::isspace(static_cast<unsigned char>(e[at])))
+    {
+      at++;
+    }
+  }
+
+  int64_t Sum(const std::string &e, size_t &at) const
+  {
+    int64_t value = Product(e, at);
+    for (Skip(e, at); at < e.size() && (e[at] == '+' || e[at] == '-'); Skip(e, at))
+    {
+      char op = e[at++];
+      int64_t rhs = Product(e, at);
+      value = op == '+' ? value + rhs : value - rhs;
+    }
+    return value;
+  }
+
+  int64_t Product(const std::string &e, size_t &at) const
+  {
+    int64_t value = Factor(e, at);
+    for (Skip(e, at); at < e.size() && (e[at] == '*' || e[at] == '/'); Skip(e, at))
+    {
+      char op = e[at++];
+      int64_t rhs = Factor(e, at);
+      Expect(op == '*' || rhs != 0, "division by zero in ${" + e + "}");
+      value = op == '*' ? value * rhs : value / rhs;
+    }
+    return value;
+  }
+
+  int64_t Factor(const std::string &e, size_t &at) const
+  {
+    Skip(e, at);
+    Expect(at < e.size(), "truncated ${" + e + "}");
+    if (e[at] == '-')
+    {
+      at++;
+      return -Factor(e, at);
+    }
+    if (e[at] == '(')
+    {
+      at++;
+      int64_t value = Sum(e, at);
+      Skip(e, at);
+      Expect(at < e.size() && e[at] == ')', "missing ) in ${" + e + "}");
+      at++;
+      return value;
+    }
+    size_t start = at;
+    while (at < e.size() && (std::isalnum(static_cast<unsigned char>(e[at])) || e[at] == '_'))
+    {
+      at++;
+    }
+    Expect(at > start, "bad expression ${" + e + "}");
+    std::string word = e.substr(start, at - start);
+    if (std::isdigit(static_cast<unsigned char>(word[0])))
+    {
+      return ToInt(word);
+    }
+    return ToInt(GetVariable(word));
+  }
+
+  std::map<std::string, std::string> m_vars;
+  std::map<std::string, bool> m_fixed;
+  std::map<std::string, std::vector<uint32_t> > m_refs;
+  std::string m_where;
+};
+
+// Builds a TopologySpec in one pass per link class.
+class TopologyBuilder
+{
+public:
+  // Load generators send to a sink on the flow's port plus this.
+  static const uint16_t LOAD_PORT_OFFSET = 1000;
+
+  TopologyBuilder(const TopologySpec &spec)
+    : m_spec(spec),
+      m_ranks(spec.nodes.size(), 0),
+      m_localRank(0)
+  {
+  }
+
+  // Spreads the nodes over MPI ranks.  CSMA LANs and Wi-Fi BSSs cannot
+  // span ranks, so only point-to-point links are cut; whole islands are
+  // handed to the least loaded rank, largest first.  Nodes with rank= in
+  // the file keep their rank and pull their island along.
+  void Partition(uint32_t ranks)
+  {
+    uint32_t n = m_spec.nodes.size();
+    std::vector<uint32_t> parent(n);
+    for (uint32_t i = 0; i < n; i++)
+    {
+      parent[i] = i;
+    }
+    for (size_t i = 0; i < m_spec.lans.size(); i++)
+    {
+      const std::vector<uint32_t> &members = m_spec.lans[i].members;
+      for (size_t k = 1; k < members.size(); k++)
+      {
+        Join(parent, members[0], members[k]);
+      }
+    }
+    // BSSs sharing a channel object stay on one rank as well.
+    std::map<std::string, uint32_t> channels;
+    for (size_t i = 0; i < m_spec.bsss.size(); i++)
+    {
+      const TopologyWifiSpec &bss = m_spec.bsss[i];
+      for (size_t k = 0; k < bss.stations.size(); k++)
+      {
+        Join(parent, bss.ap, bss.stations[k]);
+      }
+      if (bss.channelNumber)
+      {
+        std::pair<std::map<std::string, uint32_t>::iterator, bool> first =
+            channels.insert(std::make_pair(ChannelKey(bss), bss.ap));
+        Join(parent, first.first->second, bss.ap);
+      }
+    }
+
+    // Islands in order of their lowest node id, so the result is stable.
+    std::map<uint32_t, std::vector<uint32_t> > islands;
+    for (uint32_t i = 0; i < n; i++)
+    {
+      islands[Find(parent, i)].push_back(i);
+    }
+    std::vector<uint64_t> load(ranks, 0);
+    std::vector<const std::vector<uint32_t> *> unpinned;
+    std::map<uint32_t, std::vector<uint32_t> >::const_iterator it;
+    for (it = islands.begin(); it != islands.end(); it++)
+    {
+      int32_t rank = -1;
+      for (size_t k = 0; k < it->second.size(); k++)
+      {
+        int32_t pinned = m_spec.nodes[it->second[k]].rank;
+        NS_ABORT_MSG_IF(pinned >= int32_t(ranks),
+                        "Node " << m_spec.nodes[it->second[k]].name << " is pinned to rank " << pinned
+                                << " but only " << ranks << " ranks run");
+        NS_ABORT_MSG_IF(pinned >= 0 && rank >= 0 && pinned != rank,
+                        "Node " << m_spec.nodes[it->second[k]].name
+                                << " shares a LAN or BSS with a node pinned to another rank");
+        if (pinned >= 0)
+        {
+          rank = pinned;
+        }
+      }
+      if (rank < 0)
+      {
+        unpinned.push_back(&it->second);
+      }
+      else
+      {
+        SetRank(it->second, rank, load);
+      }
+    }
+    std::stable_sort(unpinned.begin(), unpinned.end(), LargerIsland);
+    for (size_t i = 0; i < unpinned.size(); i++)
+    {
+      uint32_t lightest = std::min_element(load.begin(), load.end()) - load.begin();
+      SetRank(*unpinned[i], lightest, load);
+    }
+
+    // A remote channel needs a positive delay to give the synchronizer lookahead.
+    for (size_t i = 0; i < m_spec.p2pLinks.size(); i++)
+    {
+      const TopologyP2pSpec &link = m_spec.p2pLinks[i];
+      NS_ABORT_MSG_IF(m_ranks[link.a] != m_ranks[link.b] && Time(link.delay).IsZero(),
+                      "Link " << m_spec.nodes[link.a].name << "-" << m_spec.nodes[link.b].name
+                              << " crosses ranks but has no delay");
+    }
+  }
+
+  // Full or lean internet stacks (stack-profile.h); with lean, only the
+  // ends of bulk flows get TCP.
+  void SetStackProfile(const std::string &profile)
+  {
+    m_stack = StackProfileHelper(profile);
+  }
+
+  const StackProfileHelper &GetStackProfile() const
+  {
+    return m_stack;
+  }
+
+  // fluid or packet, for the bg= links.
+  void SetBackgroundMode(const std::string &mode)
+  {
+    m_background = BackgroundLoad(mode);
+  }
+
+  // Applications and traces are only installed on nodes of this rank.
+  void SetLocalRank(uint32_t rank)
+  {
+    m_localRank = rank;
+  }
+
+  uint32_t GetRank(uint32_t node) const
+  {
+    return m_ranks[node];
+  }
+
+  bool IsLocal(uint32_t node) const
+  {
+    return m_ranks[node] == m_localRank;
+  }
+
+  NodeContainer GetLocalNodes() const
+  {
+    NodeContainer local;
+    for (uint32_t i = 0; i < m_nodes.GetN(); i++)
+    {
+      if (IsLocal(i))
+      {
+        local.Add(m_nodes.Get(i));
+      }
+    }
+    return local;
+  }
+
+  // Phases, when given, times the devices, stack, addresses and
+  // applications steps.
+  void Build(PhaseTimer *phases = 0)
+  {
+    StartPhase(phases, "devices");
+    for (uint32_t i = 0; i < m_spec.nodes.size(); i++)
+    {
+      m_nodes.Add(CreateObject<Node>(m_ranks[i]));
+    }
+    InstallPointToPoint();
+    InstallCsma();
+    InstallWifi();
+
+    StartPhase(phases, "stack");
+    std::vector<bool> tcp(m_spec.nodes.size(), false);
+    for (size_t i = 0; i < m_spec.flows.size(); i++)
+    {
+      if (m_spec.flows[i].profile == "bulk")
+      {
+        tcp[m_spec.flows[i].src] = true;
+        tcp[m_spec.flows[i].dst] = true;
+      }
+    }
+    for (uint32_t i = 0; i < m_nodes.GetN(); i++)
+    {
+      m_stack.Install(m_nodes.Get(i), tcp[i]);
+    }
+
+    StartPhase(phases, "addresses");
+    AssignAddresses();
+    InstallAqm();
+    StartPhase(phases, "applications");
+    // Mobility first: it is built on every rank, the background only on
+    // the local one, so its automatic streams match the sequential run.
+    InstallMobility();
+    m_background.Install(Seconds(0), m_spec.stopTime, m_localRank);
+    InstallApplications();
+  }
+
+  // Gives the random variables of the topology fixed streams, counted
+  // from stream, in an order that does not depend on the MPI rank.  The
+  // devices, mobility models, stacks and AQMs exist on every rank; the
+  // background load (by direction) and the load generators (by flow
+  // index) take their streams on every rank too, built there or not.
+  // Call after Build().  Returns the number of streams used.
+  int64_t AssignStreams(int64_t stream)
+  {
+    int64_t current = stream;
+    NodeContainer nodes(m_nodes, m_switches);
+    NetDeviceContainer devices;
+    for (uint32_t n = 0; n < nodes.GetN(); n++)
+    {
+      for (uint32_t d = 0; d < nodes.Get(n)->GetNDevices(); d++)
+      {
+        devices.Add(nodes.Get(n)->GetDevice(d));
+      }
+    }
+    WifiHelper wifi;
+    current += wifi.AssignStreams(devices, current);
+    CsmaHelper csma;
+    current += csma.AssignStreams(devices, current);
+    current += MobilityHelper::AssignStreams(nodes, current);
+    InternetStackHelper internet;
+    current += internet.AssignStreams(nodes, current);
+
+    for (size_t i = 0; i < m_bottlenecks.size(); i++)
+    {
+      Ptr<NetDevice> device = m_bottlenecks[i].device;
+      Ptr<QueueDisc> root = device->GetNode()->GetObject<TrafficControlLayer>()->GetRootQueueDiscOnDevice(device);
+      Ptr<RedQueueDisc> red = DynamicCast<RedQueueDisc>(root);
+      Ptr<PieQueueDisc> pie = DynamicCast<PieQueueDisc>(root);
+      if (red)
+      {
+        current += red->AssignStreams(current);
+      }
+      if (pie)
+      {
+        current += pie->AssignStreams(current);
+      }
+    }
+    current += m_background.AssignStreams(current);
+    for (size_t i = 0; i < m_generators.size(); i++)
+    {
+      if (m_generators[i])
+      {
+        m_generators[i]->AssignStreams(current);
+      }
+      current += WorkloadApplication::STREAMS;
+    }
+    return current - stream;
+  }
+
+  Ptr<Node> GetNode(const std::string &ref) const
+  {
+    return m_nodes.Get(m_spec.GetNodeId(ref));
+  }
+
+  NodeContainer GetNodes() const
+  {
+    return m_nodes;
+  }
+
+  ApplicationContainer GetClientApps() const
+  {
+    return m_clientApps;
+  }
+
+  ApplicationContainer GetServerApps() const
+  {
+    return m_serverApps;
+  }
+
+  ApplicationContainer GetLoadApps() const
+  {
+    return m_loadApps;
+  }
+
+  ApplicationContainer GetSinkApps() const
+  {
+    return m_sinkApps;
+  }
+
+  // The local Wi-Fi stations, BSS by BSS.
+  NodeContainer GetStations() const
+  {
+    NodeContainer stations;
+    for (size_t i = 0; i < m_spec.bsss.size(); i++)
+    {
+      for (size_t k = 0; k < m_spec.bsss[i].stations.size(); k++)
+      {
+        if (IsLocal(m_spec.bsss[i].stations[k]))
+        {
+          stations.Add(m_nodes.Get(m_spec.bsss[i].stations[k]));
+        }
+      }
+    }
+    return stations;
+  }
+
+  const BackgroundLoad &GetBackground() const
+  {
+    return m_background;
+  }
+
+  // Returns the address of a node on the given subnet, or its first
+  // address when the subnet is not given.
+  Ipv4Address GetAddress(uint32_t node, const TopologySubnet *subnet = 0) const
+  {
+    Ptr<Ipv4> ipv4 = m_nodes.Get(node)->GetObject<Ipv4>();
+    for (uint32_t i = 1; i < ipv4->GetNInterfaces(); i++)
+    {
+      for (uint32_t j = 0; j < ipv4->GetNAddresses(i); j++)
+      {
+        Ipv4Address local = ipv4->GetAddress(i, j).GetLocal();
+        if (subnet == 0 || local.CombineMask(subnet->mask) == subnet->network)
+        {
+          return local;
+        }
+      }
+    }
+    NS_FATAL_ERROR("Node " << m_spec.nodes[node].name << " has no matching address");
+    return Ipv4Address();
+  }
+
+  void EnablePcapAll(const std::string &prefix)
+  {
+    // Each helper class traces every local device of its type.
+    NodeContainer local = GetLocalNodes();
+    if (!m_p2pHelpers.empty())
+    {
+      m_p2pHelpers.begin()->second.EnablePcap(prefix, local, true);
+    }
+    if (!m_spec.lans.empty())
+    {
+      // Bus and switched LANs alike: the members' CSMA devices.
+      CsmaHelper csma;
+      csma.EnablePcap(prefix, local, true);
+    }
+    if (!m_spec.bsss.empty())
+    {
+      m_phy.EnablePcap(prefix, local, true);
+    }
+  }
+
+  // Queue telemetry for the local devices of the aqm= links.
+  void TrackBottlenecks(QueueTelemetry &telemetry) const
+  {
+    for (uint32_t i = 0; i < m_spec.nodes.size(); i++)
+    {
+      telemetry.NameNode(m_nodes.Get(i), m_spec.nodes[i].name);
+    }
+    for (size_t i = 0; i < m_bottlenecks.size(); i++)
+    {
+      if (IsLocal(m_bottlenecks[i].node))
+      {
+        telemetry.Track(m_bottlenecks[i].device, m_bottlenecks[i].aqm);
+      }
+    }
+  }
+
+  // Same devices as EnablePcapAll, written by one PCAP-NG writer.
+  void EnablePcapNg(PcapNgWriter &writer)
+  {
+    writer.AddNodes(GetLocalNodes());
+  }
+
+  void SetupAnimation(AnimationStream &anim, const std::string &assets)
+  {
+    std::map<std::string, uint32_t> images;
+    for (uint32_t i = 0; i < m_spec.nodes.size(); i++)
+    {
+      const TopologyNodeSpec &node = m_spec.nodes[i];
+      if (!images.count(node.role))
+      {
+        images[node.role] = anim.AddResource(assets + node.role + ".png");
+      }
+      uint32_t id = m_nodes.Get(i)->GetId();
+      anim.UpdateNodeDescription(id, node.description);
+      anim.UpdateNodeImage(id, images[node.role]);
+      anim.UpdateNodeSize(id, node.size, node.size);
+    }
+  }
+
+private:
+  struct Assignment
+  {
+    Ptr<NetDevice> device;
+    const TopologySubnet *subnet;
+    uint32_t host;
+  };
+
+  struct Bottleneck
+  {
+    Ptr<NetDevice> device;
+    uint32_t node;
+    std::string aqm;
+  };
+
+  static uint32_t Find(std::vector<uint32_t> &parent, uint32_t i)
+  {
+    while (parent[i] != i)
+    {
+      parent[i] = parent[parent[i]];
+      i = parent[i];
+    }
+    return i;
+  }
+
+  static void Join(std::vector<uint32_t> &parent, uint32_t a, uint32_t b)
+  {
+    a = Find(parent, a);
+    b = Find(parent, b);
+    parent[std::max(a, b)] = std::min(a, b);
+  }
+
+  static void StartPhase(PhaseTimer *phases, const std::string &name)
+  {
+    if (phases)
+    {
+      phases->Start(name);
+    }
+  }
+
+  static bool LargerIsland(const std::vector<uint32_t> *a, const std::vector<uint32_t> *b)
+  {
+    return a->size() > b->size();
+  }
+
+  void SetRank(const std::vector<uint32_t> &island, uint32_t rank, std::vector<uint64_t> &load)
+  {
+    for (size_t k = 0; k < island.size(); k++)
+    {
+      m_ranks[island[k]] = rank;
+    }
+    load[rank] += island.size();
+  }
+
+  static std::string LinkClass(const std::string &rate, const std::string &delay)
+  {
+    return rate + "/" + delay;
+  }
+
+  static std::string ChannelKey(const TopologyWifiSpec &bss)
+  {
+    return (bss.spatialChannel ? "spatial/" : "yans/") + std::to_string(bss.channelNumber);
+  }
+
+  // A new channel object, or the one of the BSS's channel number.
+  Ptr<YansWifiChannel> GetChannel(const TopologyWifiSpec &bss)
+  {
+    std::string key = ChannelKey(bss);
+    if (bss.channelNumber && m_channels.count(key))
+    {
+      return m_channels[key];
+    }
+    Ptr<YansWifiChannel> channel;
+    if (bss.spatialChannel)
+    {
+      channel = SpatialYansWifiChannelHelper::Default().Create();
+    }
+    else
+    {
+      channel = YansWifiChannelHelper::Default().Create();
+    }
+    if (bss.channelNumber)
+    {
+      m_channels[key] = channel;
+    }
+    return channel;
+  }
+
+  void InstallPointToPoint()
+  {
+    for (size_t i = 0; i < m_spec.p2pLinks.size(); i++)
+    {
+      const TopologyP2pSpec &link = m_spec.p2pLinks[i];
+      std::string key = LinkClass(link.rate, link.delay);
+      if (!m_p2pHelpers.count(key))
+      {
+        PointToPointHelper helper;
+        helper.SetDeviceAttribute("DataRate", StringValue(link.rate));
+        helper.SetChannelAttribute("Delay", StringValue(link.delay));
+        m_p2pHelpers[key] = helper;
+      }
+      NetDeviceContainer devices = m_p2pHelpers[key].Install(m_nodes.Get(link.a), m_nodes.Get(link.b));
+      AddAssignment(devices.Get(0), link.subnet, 1);
+      AddAssignment(devices.Get(1), link.subnet, 2);
+      if (!link.bgRate.empty())
+      {
+        m_background.Add(devices.Get(0), link.bgRate, link.bgProfile, link.bgSize);
+        m_background.Add(devices.Get(1), link.bgRate, link.bgProfile, link.bgSize);
+      }
+      if (!link.aqm.empty())
+      {
+        Bottleneck a = {devices.Get(0), link.a, link.aqm};
+        Bottleneck b = {devices.Get(1), link.b, link.aqm};
+        m_bottlenecks.push_back(a);
+        m_bottlenecks.push_back(b);
+      }
+    }
+  }
+
+  void InstallCsma()
+  {
+    for (size_t i = 0; i < m_spec.lans.size(); i++)
+    {
+      const TopologyCsmaSpec &lan = m_spec.lans[i];
+      std::string key = LinkClass(lan.rate, lan.delay);
+      NodeContainer members;
+      for (size_t k = 0; k < lan.members.size(); k++)
+      {
+        members.Add(m_nodes.Get(lan.members[k]));
+      }
+      NetDeviceContainer devices;
+      if (lan.switched)
+      {
+        if (!m_switchHelpers.count(key))
+        {
+          // Half the delay each way, so host to host takes the bus's.
+          SwitchedLanHelper helper;
+          helper.SetChannelAttribute("DataRate", StringValue(lan.rate));
+          helper.SetChannelAttribute("Delay", TimeValue(Time(lan.delay) / 2));
+          m_switchHelpers[key] = helper;
+        }
+        Ptr<Node> sw = CreateObject<Node>(m_ranks[lan.members[0]]);
+        m_switches.Add(sw);
+        devices = m_switchHelpers[key].Install(members, sw);
+      }
+      else
+      {
+        if (!m_csmaHelpers.count(key))
+        {
+          CsmaHelper helper;
+          helper.SetChannelAttribute("DataRate", StringValue(lan.rate));
+          helper.SetChannelAttribute("Delay", StringValue(lan.delay));
+          m_csmaHelpers[key] = helper;
+        }
+        devices = m_csmaHelpers[key].Install(members);
+      }
+      for (uint32_t k = 0; k < devices.GetN(); k++)
+      {
+        AddAssignment(devices.Get(k), lan.subnet, k + 1);
+      }
+    }
+  }
+
+  void InstallWifi()
+  {
+    WifiMacHelper mac;
+
+    for (size_t i = 0; i < m_spec.bsss.size(); i++)
+    {
+      const TopologyWifiSpec &bss = m_spec.bsss[i];
+      WifiHelper wifi;
+      bss.radio.Configure(wifi);
+      YansWifiPhyHelper &phy = bss.spatialChannel ? m_spatialPhy : m_phy;
+      phy.SetChannel(GetChannel(bss));
+      // Zero leaves the standard's default channel.
+      phy.Set("ChannelNumber", UintegerValue(bss.channelNumber));
+
+      NodeContainer stations;
+      for (size_t k = 0; k < bss.stations.size(); k++)
+      {
+        stations.Add(m_nodes.Get(bss.stations[k]));
+      }
+
+      Ssid ssid = Ssid(bss.ssid);
+      mac.SetType("ns3::StaWifiMac",
+                  "Ssid", SsidValue(ssid),
+                  "ActiveProbing", BooleanValue(false));
+      NetDeviceContainer staDevices = wifi.Install(phy, mac, stations);
+
+      mac.SetType("ns3::ApWifiMac",
+                  "Ssid", SsidValue(ssid));
+      NetDeviceContainer apDevices = wifi.Install(phy, mac, m_nodes.Get(bss.ap));
+      bss.radio.Apply(staDevices);
+      bss.radio.Apply(apDevices);
+      m_stack.ShareWifiModels(staDevices);
+      m_stack.ShareWifiModels(apDevices);
+
+      // Stations are numbered before the AP, as in the hand-built scenarios.
+      for (uint32_t k = 0; k < staDevices.GetN(); k++)
+      {
+        AddAssignment(staDevices.Get(k), bss.subnet, k + 1);
+      }
+      AddAssignment(apDevices.Get(0), bss.subnet, staDevices.GetN() + 1);
+    }
+  }
+
+  void AddAssignment(Ptr<NetDevice> device, const TopologySubnet &subnet, uint32_t host)
+  {
+    Assignment assignment;
+    assignment.device = device;
+    assignment.subnet = &subnet;
+    assignment.host = host;
+    m_assignments.push_back(assignment);
+  }
+
+  void AssignAddresses()
+  {
+    std::map<std::size_t, NetDeviceContainer> queued; // by number of TX queues
+    for (size_t i = 0; i < m_assignments.size(); i++)
+    {
+      const Assignment &a = m_assignments[i];
+      uint32_t hosts = ~a.subnet->mask.Get();
+      NS_ABORT_MSG_UNLESS(a.host < hosts,
+                          "Subnet " << a.subnet->network << a.subnet->mask << " is too small");
+      Ipv4Address address(a.subnet->network.Get() + a.host);
+
+      Ptr<Node> node = a.device->GetNode();
+      Ptr<Ipv4> ipv4 = node->GetObject<Ipv4>();
+      int32_t interface = ipv4->GetInterfaceForDevice(a.device);
+      if (interface == -1)
+      {
+        interface = ipv4->AddInterface(a.device);
+      }
+      ipv4->AddAddress(interface, Ipv4InterfaceAddress(address, a.subnet->mask));
+      ipv4->SetMetric(interface, 1);
+      ipv4->SetUp(interface);
+
+      // Same default queue disc Ipv4AddressHelper::Assign would install
+      // (an mq with one child per queue on QoS Wi-Fi devices), collected so
+      // the traffic control helper runs once per queue count.  Lean stacks
+      // have none.
+      Ptr<TrafficControlLayer> tc = node->GetObject<TrafficControlLayer>();
+      Ptr<NetDeviceQueueInterface> ndqi = a.device->GetObject<NetDeviceQueueInterface>();
+      if (!m_stack.IsLean() && tc && ndqi && tc->GetRootQueueDiscOnDevice(a.device) == 0)
+      {
+        queued[ndqi->GetNTxQueues()].Add(a.device);
+      }
+    }
+    for (std::map<std::size_t, NetDeviceContainer>::const_iterator it = queued.begin(); it != queued.end(); it++)
+    {
+      TrafficControlHelper tch = TrafficControlHelper::Default(it->first);
+      tch.Install(it->second);
+    }
+  }
+
+  // After AssignAddresses, whose default queue discs it replaces.
+  void InstallAqm()
+  {
+    std::map<std::string, NetDeviceContainer> byAqm;
+    for (size_t i = 0; i < m_bottlenecks.size(); i++)
+    {
+      byAqm[m_bottlenecks[i].aqm].Add(m_bottlenecks[i].device);
+    }
+    for (std::map<std::string, NetDeviceContainer>::const_iterator it = byAqm.begin(); it != byAqm.end(); it++)
+    {
+      AqmHelper(it->first).Install(it->second);
+    }
+  }
+
+  void InstallMobility()
+  {
+    std::vector<bool> mobile(m_spec.nodes.size(), false);
+    for (size_t i = 0; i < m_spec.bsss.size(); i++)
+    {
+      const TopologyWifiSpec &bss = m_spec.bsss[i];
+      MobilityHelper mobility;
+      if (bss.layout == "scalable")
+      {
+        mobility.SetPositionAllocator("ns3::ScalableGridPositionAllocator",
+                                      "Bounds", RectangleValue(bss.bounds),
+                                      "N", UintegerValue(bss.stations.size()));
+      }
+      else if (bss.layout == "list")
+      {
+        Ptr<ListPositionAllocator> positions = CreateObject<ListPositionAllocator>();
+        for (size_t k = 0; k < bss.stations.size(); k++)
+        {
+          const TopologyNodeSpec &node = m_spec.nodes[bss.stations[k]];
+          positions->Add(Vector(node.x, node.y, 0.0));
+        }
+        mobility.SetPositionAllocator(positions);
+      }
+      else
+      {
+        mobility.SetPositionAllocator("ns3::GridPositionAllocator",
+                                      "MinX", DoubleValue(bss.minX),
+                                      "MinY", DoubleValue(bss.minY),
+                                      "DeltaX", DoubleValue(bss.deltaX),
+                                      "DeltaY", DoubleValue(bss.deltaY),
+                                      "GridWidth", UintegerValue(bss.gridWidth),
+                                      "LayoutType", StringValue("RowFirst"));
+      }
+      // The same random walk, generated ahead instead of event by event.
+      mobility.SetMobilityModel(bss.trajectoryMobility ? "ns3::TrajectoryMobilityModel"
+                                                       : "ns3::RandomWalk2dMobilityModel",
+                                "Bounds", RectangleValue(bss.bounds));
+      NodeContainer stations;
+      for (size_t k = 0; k < bss.stations.size(); k++)
+      {
+        stations.Add(m_nodes.Get(bss.stations[k]));
+        mobile[bss.stations[k]] = true;
+      }
+      mobility.Install(stations);
+    }
+
+    // Everything else stays where the file puts it.
+    Ptr<ListPositionAllocator> positions = CreateObject<ListPositionAllocator>();
+    NodeContainer fixed;
+    for (size_t i = 0; i < m_spec.nodes.size(); i++)
+    {
+      if (!mobile[i])
+      {
+        const TopologyNodeSpec &node = m_spec.nodes[i];
+        positions->Add(Vector(node.x, node.y, 0.0));
+        fixed.Add(m_nodes.Get(i));
+      }
+    }
+    // Switches sit in the middle of their LAN.
+    for (size_t i = 0, s = 0; i < m_spec.lans.size(); i++)
+    {
+      const TopologyCsmaSpec &lan = m_spec.lans[i];
+      if (lan.switched)
+      {
+        Vector center;
+        for (size_t k = 0; k < lan.members.size(); k++)
+        {
+          center.x += m_spec.nodes[lan.members[k]].x / lan.members.size();
+          center.y += m_spec.nodes[lan.members[k]].y / lan.members.size();
+        }
+        positions->Add(center);
+        fixed.Add(m_switches.Get(s++));
+      }
+    }
+    MobilityHelper mobility;
+    mobility.SetPositionAllocator(positions);
+    mobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
+    mobility.Install(fixed);
+  }
+
+  void InstallApplications()
+  {
+    for (size_t i = 0; i < m_spec.servers.size(); i++)
+    {
+      const TopologyServerSpec &server = m_spec.servers[i];
+      if (!IsLocal(server.node))
+      {
+        continue;
+      }
+      UdpEchoServerHelper echoServer(server.port);
+      ApplicationContainer apps = echoServer.Install(m_nodes.Get(server.node));
+      apps.Start(server.start);
+      apps.Stop(server.stop);
+      m_serverApps.Add(apps);
+    }
+
+    for (size_t i = 0; i < m_spec.flows.size(); i++)
+    {
+      const TopologyFlowSpec &flow = m_spec.flows[i];
+      if (!IsLocal(flow.src))
+      {
+        continue;
+      }
+      UdpEchoClientHelper echoClient(GetAddress(flow.dst, flow.hasVia ? &flow.via : 0), flow.port);
+      echoClient.SetAttribute("MaxPackets", UintegerValue(flow.packets));
+      echoClient.SetAttribute("Interval", TimeValue(flow.interval));
+      echoClient.SetAttribute("PacketSize", UintegerValue(flow.size));
+      ApplicationContainer apps = echoClient.Install(m_nodes.Get(flow.src));
+      apps.Start(flow.start);
+      apps.Stop(flow.stop);
+      m_clientApps.Add(apps);
+    }
+
+    // Load generators and their sinks, one sink per destination port.
+    std::set<std::pair<uint32_t, uint16_t> > sinks;
+    m_generators.assign(m_spec.flows.size(), Ptr<WorkloadApplication>());
+    for (size_t i = 0; i < m_spec.flows.size(); i++)
+    {
+      const TopologyFlowSpec &flow = m_spec.flows[i];
+      if (flow.profile == "echo")
+      {
+        continue;
+      }
+      uint16_t port = flow.port + LOAD_PORT_OFFSET;
+      if (IsLocal(flow.dst) && sinks.insert(std::make_pair(flow.dst, port)).second)
+      {
+        m_sinkApps.Add(WorkloadHelper::InstallSink(flow.profile, m_nodes.Get(flow.dst), port));
+      }
+      if (!IsLocal(flow.src))
+      {
+        continue;
+      }
+      Address remote = InetSocketAddress(GetAddress(flow.dst, flow.hasVia ? &flow.via : 0), port);
+      WorkloadHelper load(flow.profile, remote);
+      load.SetAttribute("PacketSize", UintegerValue(flow.size));
+      load.SetAttribute("DataRate", DataRateValue(DataRate(flow.rate)));
+      ApplicationContainer apps = load.Install(m_nodes.Get(flow.src));
+      apps.Start(flow.start);
+      apps.Stop(flow.stop);
+      m_loadApps.Add(apps);
+      m_generators[i] = DynamicCast<WorkloadApplication>(apps.Get(0));
+    }
+  }
+
+  const TopologySpec &m_spec;
+  std::vector<uint32_t> m_ranks;
+  uint32_t m_localRank;
+  NodeContainer m_nodes;
+  std::map<std::string, PointToPointHelper> m_p2pHelpers;
+  std::map<std::string, CsmaHelper> m_csmaHelpers;
+  std::map<std::string, SwitchedLanHelper> m_switchHelpers;
+  NodeContainer m_switches; // one per switched LAN, in file order
+  YansWifiPhyHelper m_phy;
+  SpatialYansWifiPhyHelper m_spatialPhy;
+  StackProfileHelper m_stack;
+  std::map<std::string, Ptr<YansWifiChannel> > m_channels;
+  std::vector<Assignment> m_assignments;
+  std::vector<Bottleneck> m_bottlenecks;
+  BackgroundLoad m_background;
+  ApplicationContainer m_serverApps;
+  ApplicationContainer m_clientApps;
+  ApplicationContainer m_loadApps;
+  std::vector<Ptr<WorkloadApplication> > m_generators; // by flow, 0 where not built here
+  ApplicationContainer m_sinkApps;
+};
+
+} // namespace ns3
+
+#endif /* TOPOLOGY_ENGINE_H */
@@ -0,0 +1,295 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef TRAFFIC_GENERATORS_H
+#define TRAFFIC_GENERATORS_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/applications-module.h"
+
+#include <cmath>
+#include <string>
+
+namespace ns3 {
+
+// UDP load generator with four profiles:
+//
+//   cbr      one packet every PacketSize / DataRate
+//   poisson  exponential gaps with that mean
+//   onoff    cbr during OnTime, silent during OffTime
+//   web      objects of ObjectSize bytes (heavy-tailed by default) sent
+//            at DataRate, separated by ThinkTime
+//
+// Every packet is a copy of one prototype packet made at start.  Copies
+// share the prototype's buffer, so no payload is allocated per send and
+// a flow costs one event and one Packet object per packet.
+class WorkloadApplication : public Application
+{
+public:
+  // Streams AssignStreams uses.
+  static const int64_t STREAMS = 5;
+
+  enum Profile
+  {
+    CBR,
+    POISSON,
+    ON_OFF,
+    WEB
+  };
+
+  static TypeId GetTypeId(void)
+  {
+    static TypeId tid =
+        TypeId("ns3::WorkloadApplication")
+            .SetParent<Application>()
+            .SetGroupName("Applications")
+            .AddConstructor<WorkloadApplication>()
+            .AddAttribute("Remote", "Destination address and port.", AddressValue(),
+                          MakeAddressAccessor(&WorkloadApplication::m_remote), MakeAddressChecker())
+            .AddAttribute("Profile", "Traffic profile.", EnumValue(CBR),
+                          MakeEnumAccessor(&WorkloadApplication::m_profile),
+                          MakeEnumChecker(CBR, "cbr", POISSON, "poisson", ON_OFF, "onoff", WEB, "web"))
+            .AddAttribute("PacketSize", "Payload bytes per packet.", UintegerValue(1024),
+                          MakeUintegerAccessor(&WorkloadApplication::m_size), MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("DataRate", "Sending rate while active.", DataRateValue(DataRate("1Mbps")),
+                          MakeDataRateAccessor(&WorkloadApplication::m_rate), MakeDataRateChecker())
+            .AddAttribute("OnTime", "Length of onoff bursts (s).",
+                          StringValue("ns3::ExponentialRandomVariable[Mean=1.0]"),
+                          MakePointerAccessor(&WorkloadApplication::m_onTime),
+                          MakePointerChecker<RandomVariableStream>())
+            .AddAttribute("OffTime", "Length of onoff pauses (s).",
+                          StringValue("ns3::ExponentialRandomVariable[Mean=1.0]"),
+                          MakePointerAccessor(&WorkloadApplication::m_offTime),
+                          MakePointerChecker<RandomVariableStream>())
+            .AddAttribute("ObjectSize", "Bytes per web object.",
+                          StringValue("ns3::ParetoRandomVariable[Scale=10000|Shape=1.2]"),
+                          MakePointerAccessor(&WorkloadApplication::m_objectSize),
+                          MakePointerChecker<RandomVariableStream>())
+            .AddAttribute("ThinkTime", "Pause between web objects (s).",
+                          StringValue("ns3::ExponentialRandomVariable[Mean=1.0]"),
+                          MakePointerAccessor(&WorkloadApplication::m_thinkTime),
+                          MakePointerChecker<RandomVariableStream>())
+            .AddAttribute("MaxPackets", "Packets to send (0: no limit).", UintegerValue(0),
+                          MakeUintegerAccessor(&WorkloadApplication::m_maxPackets),
+                          MakeUintegerChecker<uint64_t>())
+            .AddTraceSource("Tx", "A packet is sent.", MakeTraceSourceAccessor(&WorkloadApplication::m_txTrace),
+                            "ns3::Packet::TracedCallback");
+    return tid;
+  }
+
+  WorkloadApplication()
+    : m_profile(CBR),
+      m_size(1024),
+      m_maxPackets(0),
+      m_sent(0),
+      m_burstPackets(0)
+  {
+    m_gap = CreateObject<ExponentialRandomVariable>();
+  }
+
+  int64_t AssignStreams(int64_t stream)
+  {
+    m_gap->SetStream(stream);
+    m_onTime->SetStream(stream + 1);
+    m_offTime->SetStream(stream + 2);
+    m_objectSize->SetStream(stream + 3);
+    m_thinkTime->SetStream(stream + 4);
+    return STREAMS;
+  }
+
+  uint64_t GetSent() const
+  {
+    return m_sent;
+  }
+
+protected:
+  virtual void DoDispose(void)
+  {
+    m_socket = 0;
+    m_prototype = 0;
+    Application::DoDispose();
+  }
+
+private:
+  virtual void StartApplication(void)
+  {
+    if (m_socket == 0)
+    {
+      m_socket = Socket::CreateSocket(GetNode(), UdpSocketFactory::GetTypeId());
+      m_socket->Bind();
+      m_socket->Connect(m_remote);
+      m_socket->SetRecvCallback(MakeNullCallback<void, Ptr<Socket> >());
+      m_prototype = Create<Packet>(m_size);
+    }
+    StartBurst();
+  }
+
+  virtual void StopApplication(void)
+  {
+    Simulator::Cancel(m_next);
+  }
+
+  Time PacketTime() const
+  {
+    return m_rate.CalculateBytesTxTime(m_size);
+  }
+
+  void StartBurst()
+  {
+    if (m_profile == ON_OFF)
+    {
+      m_burstEnd = Simulator::Now() + Seconds(m_onTime->GetValue());
+    }
+    else if (m_profile == WEB)
+    {
+      m_burstPackets = uint64_t(std::ceil(std::max(m_objectSize->GetValue(), 1.0) / m_size));
+    }
+    Send();
+  }
+
+  void Send()
+  {
+    if (m_maxPackets && m_sent >= m_maxPackets)
+    {
+      return;
+    }
+    Ptr<Packet> packet = m_prototype->Copy();
+    m_txTrace(packet);
+    m_socket->Send(packet);
+    m_sent++;
+
+    Time gap = PacketTime();
+    switch (m_profile)
+    {
+    case POISSON:
+      gap = Seconds(m_gap->GetValue(gap.GetSeconds(), 0));
+      break;
+    case ON_OFF:
+      if (Simulator::Now() + gap > m_burstEnd)
+      {
+        m_next = Simulator::Schedule(m_burstEnd - Simulator::Now() + Seconds(m_offTime->GetValue()),
+                                     &WorkloadApplication::StartBurst, this);
+        return;
+      }
+      break;
+    case WEB:
+      if (--m_burstPackets == 0)
+      {
+        m_next = Simulator::Schedule(gap + Seconds(m_thinkTime->GetValue()), &WorkloadApplication::StartBurst,
+                                     this);
+        return;
+      }
+      break;
+    default:
+      break;
+    }
+    m_next = Simulator::Schedule(gap, &WorkloadApplication::Send, this);
+  }
+
+  Address m_remote;
+  Profile m_profile;
+  uint32_t m_size;
+  DataRate m_rate;
+  Ptr<RandomVariableStream> m_onTime;
+  Ptr<RandomVariableStream> m_offTime;
+  Ptr<RandomVariableStream> m_objectSize;
+  Ptr<RandomVariableStream> m_thinkTime;
+  Ptr<ExponentialRandomVariable> m_gap;
+  uint64_t m_maxPackets;
+  uint64_t m_sent;
+  uint64_t m_burstPackets;
+  Time m_burstEnd;
+  Ptr<Socket> m_socket;
+  Ptr<Packet> m_prototype;
+  EventId m_next;
+  TracedCallback<Ptr<const Packet> > m_txTrace;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(WorkloadApplication);
+
+// Installs a workload profile: "cbr", "poisson", "onoff" and "web" use
+// WorkloadApplication over UDP, "bulk" is a BulkSendApplication over TCP
+// (which is paced by TCP, so DataRate does not apply).  Pair it with
+// InstallSink on the destination.
+class WorkloadHelper
+{
+public:
+  WorkloadHelper(const std::string &profile, const Address &remote)
+    : m_profile(profile),
+      m_remote(remote)
+  {
+    NS_ABORT_MSG_UNLESS(IsProfile(profile), "Unknown traffic profile " << profile);
+    if (profile == "bulk")
+    {
+      m_factory.SetTypeId("ns3::BulkSendApplication");
+      m_factory.Set("Protocol", TypeIdValue(TcpSocketFactory::GetTypeId()));
+      m_factory.Set("Remote", AddressValue(remote));
+    }
+    else
+    {
+      m_factory.SetTypeId("ns3::WorkloadApplication");
+      m_factory.Set("Profile", StringValue(profile));
+      m_factory.Set("Remote", AddressValue(remote));
+    }
+  }
+
+  static bool IsProfile(const std::string &profile)
+  {
+    return profile == "cbr" || profile == "poisson" || profile == "onoff" || profile == "web" || profile == "bulk";
+  }
+
+  // PacketSize and DataRate are mapped to BulkSend's SendSize for bulk.
+  void SetAttribute(const std::string &name, const AttributeValue &value)
+  {
+    if (m_profile == "bulk")
+    {
+      if (name == "PacketSize")
+      {
+        m_factory.Set("SendSize", value);
+      }
+      else if (name != "DataRate")
+      {
+        m_factory.Set(name, value);
+      }
+      return;
+    }
+    m_factory.Set(name, value);
+  }
+
+  ApplicationContainer Install(Ptr<Node> node) const
+  {
+    Ptr<Application> app = m_factory.Create<Application>();
+    node->AddApplication(app);
+    return ApplicationContainer(app);
+  }
+
+  static ApplicationContainer InstallSink(const std::string &profile, Ptr<Node> node, uint16_t port)
+  {
+    std::string factory = profile == "bulk" ? "ns3::TcpSocketFactory" : "ns3::UdpSocketFactory";
+    PacketSinkHelper sink(factory, InetSocketAddress(Ipv4Address::GetAny(), port));
+    return sink.Install(node);
+  }
+
+private:
+  std::string m_profile;
+  Address m_remote;
+  ObjectFactory m_factory;
+};
+
+} // namespace ns3
+
+#endif /* TRAFFIC_GENERATORS_H */
@@ -0,0 +1,340 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef TRAJECTORY_MOBILITY_MODEL_H
+#define TRAJECTORY_MOBILITY_MODEL_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/mobility-module.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace ns3 {
+
+// The walk of RandomWalk2dMobilityModel, without its events.
+//
+// RandomWalk2d schedules an event at every change of direction and at
+// every rebound on the bounds.  This model draws the same walk (same
+// attributes, same random variables and streams, the same rebounds) but
+// generates it ahead, ChunkDuration at a time, as a piecewise-linear
+// trajectory kept as arrays of segment start times, start positions and
+// velocities.  A position query finds the segment covering the current
+// time, which is usually the one of the previous query, and generates the
+// next chunk when it runs past the end; no simulator event is ever
+// scheduled.
+//
+// CourseChange is only notified when the walk starts (at initialization
+// or after SetPosition), not at each turn.  GetMaxSpeed bounds the speed
+// for users that need to know how far a station may have moved.
+class TrajectoryMobilityModel : public MobilityModel
+{
+public:
+  enum Mode
+  {
+    MODE_DISTANCE,
+    MODE_TIME
+  };
+
+  static TypeId GetTypeId(void)
+  {
+    static TypeId tid =
+        TypeId("ns3::TrajectoryMobilityModel")
+            .SetParent<MobilityModel>()
+            .SetGroupName("Mobility")
+            .AddConstructor<TrajectoryMobilityModel>()
+            .AddAttribute("Bounds", "Bounds of the area to cruise.", RectangleValue(Rectangle(0.0, 100.0, 0.0, 100.0)),
+                          MakeRectangleAccessor(&TrajectoryMobilityModel::m_bounds), MakeRectangleChecker())
+            .AddAttribute("Time", "Change current direction and speed after moving for this delay.",
+                          TimeValue(Seconds(1.0)), MakeTimeAccessor(&TrajectoryMobilityModel::m_modeTime),
+                          MakeTimeChecker())
+            .AddAttribute("Distance", "Change current direction and speed after moving for this distance.",
+                          DoubleValue(1.0), MakeDoubleAccessor(&TrajectoryMobilityModel::m_modeDistance),
+                          MakeDoubleChecker<double>())
+            .AddAttribute("Mode", "The mode indicates the condition used to change the current speed and direction",
+                          EnumValue(MODE_DISTANCE), MakeEnumAccessor(&TrajectoryMobilityModel::m_mode),
+                          MakeEnumChecker(MODE_DISTANCE, "Distance", MODE_TIME, "Time"))
+            .AddAttribute("Direction", "A random variable used to pick the direction (radians).",
+                          StringValue("ns3::UniformRandomVariable[Min=0.0|Max=6.283184]"),
+                          MakePointerAccessor(&TrajectoryMobilityModel::m_direction),
+                          MakePointerChecker<RandomVariableStream>())
+            .AddAttribute("Speed", "A random variable used to pick the speed (m/s).",
+                          StringValue("ns3::UniformRandomVariable[Min=2.0|Max=4.0]"),
+                          MakePointerAccessor(&TrajectoryMobilityModel::m_speed),
+                          MakePointerChecker<RandomVariableStream>())
+            .AddAttribute("ChunkDuration", "How much of the trajectory is generated at a time.",
+                          TimeValue(Seconds(10.0)), MakeTimeAccessor(&TrajectoryMobilityModel::m_chunk),
+                          MakeTimeChecker(NanoSeconds(1)));
+    return tid;
+  }
+
+  TrajectoryMobilityModel()
+    : m_mode(MODE_DISTANCE),
+      m_modeDistance(1.0),
+      m_walking(false),
+      m_z(0.0),
+      m_cursor(0),
+      m_horizon(0),
+      m_px(0.0),
+      m_py(0.0),
+      m_pvx(0.0),
+      m_pvy(0.0),
+      m_needDraw(true),
+      m_left(0),
+      m_fastest(0.0)
+  {
+  }
+
+  // Upper bound of the speed: the maximum of a uniform or the value of a
+  // constant Speed variable, otherwise the fastest segment generated so
+  // far.
+  double GetMaxSpeed() const
+  {
+    Ptr<UniformRandomVariable> uniform = DynamicCast<UniformRandomVariable>(m_speed);
+    if (uniform)
+    {
+      return uniform->GetMax();
+    }
+    Ptr<ConstantRandomVariable> constant = DynamicCast<ConstantRandomVariable>(m_speed);
+    if (constant)
+    {
+      return constant->GetConstant();
+    }
+    return m_fastest;
+  }
+
+protected:
+  virtual void DoDispose(void)
+  {
+    m_direction = 0;
+    m_speed = 0;
+    MobilityModel::DoDispose();
+  }
+
+  virtual void DoInitialize(void)
+  {
+    Restart();
+    MobilityModel::DoInitialize();
+  }
+
+private:
+  virtual Vector DoGetPosition(void) const
+  {
+    return PositionAt(Simulator::Now().GetNanoSeconds());
+  }
+
+  virtual void DoSetPosition(const Vector &position)
+  {
+    NS_ASSERT(m_bounds.IsInside(position));
+    m_start = position;
+    m_z = position.z;
+    if (m_walking)
+    {
+      // Like RandomWalk2d, a new position starts a new walk from now.
+      Restart();
+    }
+  }
+
+  virtual Vector DoGetVelocity(void) const
+  {
+    if (!m_walking)
+    {
+      return Vector(0.0, 0.0, 0.0);
+    }
+    size_t s = Seek(Simulator::Now().GetNanoSeconds());
+    return Vector(m_vx[s], m_vy[s], 0.0);
+  }
+
+  virtual int64_t DoAssignStreams(int64_t stream)
+  {
+    m_speed->SetStream(stream);
+    m_direction->SetStream(stream + 1);
+    return 2;
+  }
+
+  void Restart()
+  {
+    m_walking = true;
+    m_time.clear();
+    m_x.clear();
+    m_y.clear();
+    m_vx.clear();
+    m_vy.clear();
+    m_cursor = 0;
+    m_horizon = Simulator::Now().GetNanoSeconds();
+    m_px = m_start.x;
+    m_py = m_start.y;
+    m_needDraw = true;
+    m_left = 0;
+    m_fastest = 0.0;
+    NotifyCourseChange();
+  }
+
+  Vector PositionAt(int64_t ns) const
+  {
+    if (!m_walking)
+    {
+      return m_start;
+    }
+    size_t s = Seek(ns);
+    double dt = (ns - m_time[s]) * 1e-9;
+    return Vector(m_x[s] + m_vx[s] * dt, m_y[s] + m_vy[s] * dt, m_z);
+  }
+
+  // Index of the segment covering ns, generating the trajectory up to ns.
+  size_t Seek(int64_t ns) const
+  {
+    while (m_horizon <= ns)
+    {
+      Generate();
+    }
+    NS_ASSERT_MSG(ns >= m_time[0], "Trajectory queried before its retained segments");
+    if (m_cursor > 0 && m_time[m_cursor] > ns)
+    {
+      m_cursor = std::upper_bound(m_time.begin(), m_time.begin() + m_cursor, ns) - m_time.begin() - 1;
+    }
+    while (m_cursor + 1 < m_time.size() && m_time[m_cursor + 1] <= ns)
+    {
+      m_cursor++;
+    }
+    return m_cursor;
+  }
+
+  // Appends ChunkDuration of walk.  Segments that lie wholly before the
+  // current one are dropped first.
+  void Generate() const
+  {
+    if (m_cursor > 0 && m_cursor * 2 >= m_time.size())
+    {
+      m_time.erase(m_time.begin(), m_time.begin() + m_cursor);
+      m_x.erase(m_x.begin(), m_x.begin() + m_cursor);
+      m_y.erase(m_y.begin(), m_y.begin() + m_cursor);
+      m_vx.erase(m_vx.begin(), m_vx.begin() + m_cursor);
+      m_vy.erase(m_vy.begin(), m_vy.begin() + m_cursor);
+      m_cursor = 0;
+    }
+    int64_t end = m_horizon + m_chunk.GetNanoSeconds();
+    while (m_horizon < end)
+    {
+      Step();
+    }
+  }
+
+  // One step of RandomWalk2d: a new speed and direction for Time or
+  // Distance (DoInitializePrivate), or the rest of that delay after a
+  // rebound (Rebound), walked until the delay ends or the bounds are hit
+  // (DoWalk).
+  void Step() const
+  {
+    if (m_needDraw)
+    {
+      double speed = m_speed->GetValue();
+      double direction = m_direction->GetValue();
+      m_pvx = std::cos(direction) * speed;
+      m_pvy = std::sin(direction) * speed;
+      m_left = m_mode == MODE_TIME ? m_modeTime.GetNanoSeconds() : Seconds(m_modeDistance / speed).GetNanoSeconds();
+      m_fastest = std::max(m_fastest, speed);
+      m_needDraw = false;
+    }
+    Vector position(m_px, m_py, 0.0);
+    Vector velocity(m_pvx, m_pvy, 0.0);
+    Vector next(m_px + m_pvx * m_left * 1e-9, m_py + m_pvy * m_left * 1e-9, 0.0);
+    if (m_bounds.IsInside(next))
+    {
+      Append(m_left);
+      m_px = next.x;
+      m_py = next.y;
+      m_needDraw = true;
+      return;
+    }
+
+    Vector hit = m_bounds.CalculateIntersection(position, velocity);
+    double seconds = std::fabs(m_pvx) >= std::fabs(m_pvy) ? (hit.x - m_px) / m_pvx : (hit.y - m_py) / m_pvy;
+    int64_t delay = std::min(Seconds(std::max(seconds, 0.0)).GetNanoSeconds(), m_left);
+    Append(delay);
+    m_left -= delay;
+    m_px = std::min(std::max(hit.x, m_bounds.xMin), m_bounds.xMax);
+    m_py = std::min(std::max(hit.y, m_bounds.yMin), m_bounds.yMax);
+    switch (m_bounds.GetClosestSide(Vector(m_px, m_py, 0.0)))
+    {
+    case Rectangle::RIGHT:
+    case Rectangle::LEFT:
+      m_pvx = -m_pvx;
+      break;
+    case Rectangle::TOP:
+    case Rectangle::BOTTOM:
+      m_pvy = -m_pvy;
+      break;
+    }
+    if (m_left == 0)
+    {
+      m_needDraw = true;
+    }
+  }
+
+  // Adds a segment from the walk's current state; empty ones are skipped.
+  void Append(int64_t duration) const
+  {
+    if (duration <= 0)
+    {
+      return;
+    }
+    m_time.push_back(m_horizon);
+    m_x.push_back(m_px);
+    m_y.push_back(m_py);
+    m_vx.push_back(m_pvx);
+    m_vy.push_back(m_pvy);
+    m_horizon += duration;
+  }
+
+  Rectangle m_bounds;
+  Time m_modeTime;
+  Mode m_mode;
+  double m_modeDistance;
+  Ptr<RandomVariableStream> m_direction;
+  Ptr<RandomVariableStream> m_speed;
+  Time m_chunk;
+  bool m_walking;
+  Vector m_start;
+  double m_z;
+
+  // Generated trajectory, struct of arrays: segment i starts at m_time[i]
+  // (ns) at (m_x[i], m_y[i]) and moves at (m_vx[i], m_vy[i]) until the
+  // next segment starts, or until m_horizon for the last one.
+  mutable std::vector<int64_t> m_time;
+  mutable std::vector<double> m_x;
+  mutable std::vector<double> m_y;
+  mutable std::vector<double> m_vx;
+  mutable std::vector<double> m_vy;
+  mutable size_t m_cursor;
+  mutable int64_t m_horizon;
+
+  // State of the walk at m_horizon.
+  mutable double m_px;
+  mutable double m_py;
+  mutable double m_pvx;
+  mutable double m_pvy;
+  mutable bool m_needDraw;
+  mutable int64_t m_left;
+  mutable double m_fastest;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(TrajectoryMobilityModel);
+
+} // namespace ns3
+
+#endif /* TRAJECTORY_MOBILITY_MODEL_H */
@@ -0,0 +1,337 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef WARM_START_H
+#define WARM_START_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/traffic-control-module.h"
+#include "ns3/csma-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/wifi-module.h"
+#include "traffic-generators.h"
+#include "fluid-background.h"
+#include "process-launcher.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace ns3 {
+
+// Seed sweeps from one warm-up.
+//
+// Fork() runs the simulation up to the warm-up time once (topology, stack,
+// routes, Wi-Fi association), then forks one worker process per RNG run.
+// The workers share the warmed-up memory copy-on-write, so only the pages
+// a worker writes get copied.  Each worker sets its run, gives the random
+// variables of the devices, mobility models, internet stacks, queue discs
+// (including the background fluid) and load generators new streams under
+// that run, moves into <dir>/run-<r> (where relative output paths now
+// land, output.log takes stdout and stderr) and returns true to continue
+// the simulation.  The parent keeps the warmed-up state, forks up to jobs
+// workers at a time, one pinned to each core, and returns false once all
+// have exited; Merge() then gathers their summaries as SweepRunner does.
+//
+// A worker is not the cold run with the same RngRun: what the warm-up drew
+// is shared, and the new streams are not the ones a cold run would use.
+// Runs are still independent of each other.  Random variables the helpers
+// cannot reach keep their warm-up stream, as does the part of a walk that
+// TrajectoryMobilityModel already generated.
+//
+// fork() only copies the calling thread and shares open files, so no
+// thread may run (PcapNgWriter) and no output file be open when Fork() is
+// called; set up tracing and instrumentation in the worker instead.
+class WarmStart
+{
+public:
+  WarmStart()
+    : m_dir("warm"),
+      m_firstRun(1),
+      m_runs(1),
+      m_jobs(0),
+      m_run(0),
+      m_failed(0)
+  {
+  }
+
+  void SetDirectory(const std::string &dir)
+  {
+    m_dir = dir;
+  }
+
+  // Workers run firstRun to firstRun + runs - 1.
+  void SetRuns(uint32_t firstRun, uint32_t runs)
+  {
+    NS_ABORT_MSG_IF(runs == 0, "WarmStart needs at least one run");
+    m_firstRun = firstRun;
+    m_runs = runs;
+  }
+
+  // Concurrent workers (0: one per available core).
+  void SetJobs(uint32_t jobs)
+  {
+    m_jobs = jobs;
+  }
+
+  // Returns true in a worker, whose RNG streams are those of its run, and
+  // false in the parent after every worker has exited.
+  bool Fork(Time warmUp, const NodeContainer &nodes)
+  {
+    NS_ABORT_MSG_IF(warmUp <= Simulator::Now(), "Warm-up must end after " << Simulator::Now().GetSeconds() << " s");
+    Simulator::Stop(warmUp - Simulator::Now());
+    Simulator::Run();
+    ProcessLauncher::MakeDirs(m_dir);
+
+    // Buffered output would be written again by every worker.
+    std::cout.flush();
+    std::clog.flush();
+    std::fflush(0);
+
+    std::vector<int> cpus = ProcessLauncher::GetCpus();
+    uint32_t jobs = m_jobs == 0 || m_jobs > cpus.size() ? cpus.size() : m_jobs;
+
+    std::vector<pid_t> slots(jobs, 0);
+    std::map<pid_t, uint32_t> running;
+    uint32_t next = m_firstRun;
+    while (next < m_firstRun + m_runs || !running.empty())
+    {
+      for (size_t s = 0; s < slots.size() && next < m_firstRun + m_runs; s++)
+      {
+        if (slots[s] == 0)
+        {
+          std::string dir = GetRunDirectory(next);
+          ProcessLauncher::MakeDirs(dir);
+          pid_t pid = fork();
+          NS_ABORT_MSG_IF(pid < 0, "fork failed: " << std::strerror(errno));
+          if (pid == 0)
+          {
+            StartWorker(next, dir, cpus[s], nodes);
+            return true;
+          }
+          slots[s] = pid;
+          running[pid] = next++;
+        }
+      }
+
+      int status = 0;
+      pid_t pid = waitpid(-1, &status, 0);
+      if (pid < 0)
+      {
+        NS_ABORT_MSG_UNLESS(errno == EINTR, "waitpid failed: " << std::strerror(errno));
+        continue;
+      }
+      uint32_t run = running[pid];
+      running.erase(pid);
+      for (size_t s = 0; s < slots.size(); s++)
+      {
+        if (slots[s] == pid)
+        {
+          slots[s] = 0;
+        }
+      }
+      if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+      {
+        m_failed++;
+        std::cerr << "Run " << run << " failed (see " << GetRunDirectory(run) << "/output.log)" << std::endl;
+      }
+    }
+    return false;
+  }
+
+  // The worker's run, 0 in the parent.
+  uint32_t GetRun() const
+  {
+    return m_run;
+  }
+
+  uint32_t GetFailed() const
+  {
+    return m_failed;
+  }
+
+  std::string GetRunDirectory(uint32_t run) const
+  {
+    return m_dir + "/run-" + std::to_string(run);
+  }
+
+  // Merges the one-row CSV each worker wrote to name (relative to its run
+  // directory) into one table at path, with the union of their columns.
+  // Returns the number of rows.
+  uint32_t Merge(const std::string &name, const std::string &path) const
+  {
+    std::vector<std::string> columns;
+    std::map<std::string, bool> known;
+    std::vector<std::map<std::string, std::string> > rows;
+    std::vector<uint32_t> owners;
+    for (uint32_t run = m_firstRun; run < m_firstRun + m_runs; run++)
+    {
+      std::ifstream in((GetRunDirectory(run) + "/" + name).c_str());
+      std::string header;
+      std::string values;
+      if (!std::getline(in, header) || !std::getline(in, values))
+      {
+        continue;
+      }
+      std::vector<std::string> names = Split(header);
+      std::vector<std::string> cells = Split(values);
+      std::map<std::string, std::string> row;
+      for (size_t c = 0; c < names.size() && c < cells.size(); c++)
+      {
+        row[names[c]] = cells[c];
+        if (!known.count(names[c]))
+        {
+          known[names[c]] = true;
+          columns.push_back(names[c]);
+        }
+      }
+      rows.push_back(row);
+      owners.push_back(run);
+    }
+
+    std::ofstream out(path.c_str());
+    NS_ABORT_MSG_UNLESS(out.is_open(), "Cannot write " << path);
+    out << "dir";
+    for (size_t c = 0; c < columns.size(); c++)
+    {
+      out << "," << columns[c];
+    }
+    out << "\n";
+    for (size_t r = 0; r < rows.size(); r++)
+    {
+      out << GetRunDirectory(owners[r]);
+      for (size_t c = 0; c < columns.size(); c++)
+      {
+        out << "," << rows[r][columns[c]];
+      }
+      out << "\n";
+    }
+    return rows.size();
+  }
+
+  // Gives the random variables of nodes fixed streams, counted from
+  // stream, under the current RngRun.  Returns the number of streams used.
+  static int64_t Reseed(const NodeContainer &nodes, int64_t stream)
+  {
+    int64_t current = stream;
+    NetDeviceContainer devices;
+    for (uint32_t n = 0; n < nodes.GetN(); n++)
+    {
+      for (uint32_t d = 0; d < nodes.Get(n)->GetNDevices(); d++)
+      {
+        devices.Add(nodes.Get(n)->GetDevice(d));
+      }
+    }
+    WifiHelper wifi;
+    current += wifi.AssignStreams(devices, current);
+    CsmaHelper csma;
+    current += csma.AssignStreams(devices, current);
+    current += MobilityHelper::AssignStreams(nodes, current);
+    InternetStackHelper internet;
+    current += internet.AssignStreams(nodes, current);
+
+    for (uint32_t n = 0; n < nodes.GetN(); n++)
+    {
+      Ptr<Node> node = nodes.Get(n);
+      Ptr<TrafficControlLayer> tc = node->GetObject<TrafficControlLayer>();
+      for (uint32_t d = 0; tc && d < node->GetNDevices(); d++)
+      {
+        Ptr<QueueDisc> root = tc->GetRootQueueDiscOnDevice(node->GetDevice(d));
+        Ptr<RedQueueDisc> red = DynamicCast<RedQueueDisc>(root);
+        Ptr<PieQueueDisc> pie = DynamicCast<PieQueueDisc>(root);
+        Ptr<FluidBackgroundQueueDisc> fluid = DynamicCast<FluidBackgroundQueueDisc>(root);
+        if (red)
+        {
+          current += red->AssignStreams(current);
+        }
+        if (pie)
+        {
+          current += pie->AssignStreams(current);
+        }
+        if (fluid)
+        {
+          current += fluid->AssignStreams(current);
+        }
+      }
+      for (uint32_t a = 0; a < node->GetNApplications(); a++)
+      {
+        Ptr<WorkloadApplication> load = DynamicCast<WorkloadApplication>(node->GetApplication(a));
+        if (load)
+        {
+          current += load->AssignStreams(current);
+        }
+      }
+    }
+    return current - stream;
+  }
+
+  // Earliest StartTime of apps, or the maximum time when there are none.
+  static Time GetFirstStart(const ApplicationContainer &apps)
+  {
+    Time first = Time::Max();
+    for (uint32_t i = 0; i < apps.GetN(); i++)
+    {
+      TimeValue start;
+      apps.Get(i)->GetAttribute("StartTime", start);
+      first = std::min(first, start.Get());
+    }
+    return first;
+  }
+
+private:
+  void StartWorker(uint32_t run, const std::string &dir, int cpu, const NodeContainer &nodes)
+  {
+    m_run = run;
+    ProcessLauncher::EnterDirectory(dir, cpu);
+    RngSeedManager::SetRun(run);
+    Reseed(nodes, 0);
+  }
+
+  // Cells of a CSV line, empty ones included.
+  static std::vector<std::string> Split(const std::string &line)
+  {
+    std::vector<std::string> cells;
+    std::stringstream ss(line);
+    std::string cell;
+    while (std::getline(ss, cell, ','))
+    {
+      cells.push_back(cell);
+    }
+    return cells;
+  }
+
+  std::string m_dir;
+  uint32_t m_firstRun;
+  uint32_t m_runs;
+  uint32_t m_jobs;
+  uint32_t m_run;    // in a worker
+  uint32_t m_failed; // in the parent
+};
+
+} // namespace ns3
+
+#endif /* WARM_START_H */
@@ -0,0 +1,239 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef WIFI_GOODPUT_H
+#define WIFI_GOODPUT_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "run-summary.h"
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+// Goodput of each Wi-Fi station and what the simulation spent per
+// delivered megabyte.
+//
+// Bytes are UDP and TCP payload where IPv4 hands a packet to the transport
+// layer (the LocalDeliver trace of the installed nodes): down to the
+// station, up from it to any node.  MAC and IP overhead, retries and
+// packets that never arrive do not count; retransmitted TCP segments do.
+// A station's rates are over the time from its first to its last
+// delivery.  Write gives one row per station and an "all" row with the
+// totals, where a packet from one station to another counts once, as down,
+// and, from SetRunCost, the wall seconds and events the run took
+// per delivered megabyte (MiB), which is what a faster standard or larger
+// aggregates should bring down.  Under MPI each rank only sees deliveries
+// to its nodes.
+class WifiGoodput
+{
+public:
+  WifiGoodput()
+    : m_wall(0),
+      m_events(0)
+  {
+    m_all.down = 0;
+    m_all.up = 0;
+  }
+
+  // Names used for stations instead of n<id>; name them before tracking.
+  void NameNode(Ptr<Node> node, const std::string &name)
+  {
+    m_names[node->GetId()] = name;
+  }
+
+  void TrackStations(const NodeContainer &stations)
+  {
+    for (uint32_t i = 0; i < stations.GetN(); i++)
+    {
+      Ptr<Node> node = stations.Get(i);
+      Station station;
+      std::map<uint32_t, std::string>::const_iterator it = m_names.find(node->GetId());
+      station.name = it != m_names.end() ? it->second : "n" + std::to_string(node->GetId());
+      station.down = 0;
+      station.up = 0;
+      m_byNode[node->GetId()] = m_stations.size();
+      Ptr<Ipv4> ipv4 = node->GetObject<Ipv4>();
+      for (uint32_t j = 1; ipv4 && j < ipv4->GetNInterfaces(); j++)
+      {
+        for (uint32_t k = 0; k < ipv4->GetNAddresses(j); k++)
+        {
+          Ipv4Address local = ipv4->GetAddress(j, k).GetLocal();
+          if (station.address == Ipv4Address())
+          {
+            station.address = local;
+          }
+          m_byAddress[local.Get()] = m_stations.size();
+        }
+      }
+      m_stations.push_back(station);
+    }
+  }
+
+  // Counts what is delivered on the nodes, stations and the others.
+  void Install(const NodeContainer &nodes)
+  {
+    for (uint32_t i = 0; i < nodes.GetN(); i++)
+    {
+      Ptr<Ipv4L3Protocol> ipv4 = nodes.Get(i)->GetObject<Ipv4L3Protocol>();
+      if (ipv4)
+      {
+        ipv4->TraceConnectWithoutContext(
+            "LocalDeliver", MakeBoundCallback(&WifiGoodput::Deliver, this, nodes.Get(i)->GetId()));
+      }
+    }
+  }
+
+  // Wall seconds and events of the simulation run, e.g. of PhaseTimer's
+  // run phase.
+  void SetRunCost(double wall, uint64_t events)
+  {
+    m_wall = wall;
+    m_events = events;
+  }
+
+  void Write(const std::string &path) const
+  {
+    std::ofstream out(path.c_str());
+    NS_ABORT_MSG_UNLESS(out.is_open(), "Cannot write " << path);
+    out.precision(9);
+    out << "sta,address,down_bytes,up_bytes,down_mbps,up_mbps,goodput_mbps,wall_s_per_mb,events_per_mb\n";
+    for (size_t i = 0; i < m_stations.size(); i++)
+    {
+      const Station &s = m_stations[i];
+      double span = (s.last - s.first).GetSeconds();
+      out << s.name << "," << s.address << "," << s.down << "," << s.up << "," << Mbps(s.down, span) << ","
+          << Mbps(s.up, span) << "," << Mbps(s.down + s.up, span) << ",,\n";
+    }
+    const Station &all = m_all;
+    double span = (all.last - all.first).GetSeconds();
+    double mb = (all.down + all.up) / 1048576.0;
+    out << "all,," << all.down << "," << all.up << "," << Mbps(all.down, span) << "," << Mbps(all.up, span) << ","
+        << Mbps(all.down + all.up, span) << "," << (mb > 0 ? m_wall / mb : 0.0) << ","
+        << (mb > 0 ? m_events / mb : 0.0) << "\n";
+  }
+
+  // Adds wifi_delivered_mb, wifi_goodput_mbps (all stations together),
+  // wifi_sta_goodput_mean_mbps, wifi_sta_goodput_min_mbps, Jain's
+  // fairness index of the stations' goodputs as wifi_goodput_fairness,
+  // and wall_s_per_mb and events_per_mb.
+  void Summarize(RunSummary &summary) const
+  {
+    const Station &all = m_all;
+    double mb = (all.down + all.up) / 1048576.0;
+    double sum = 0;
+    double squares = 0;
+    double least = m_stations.empty() ? 0 : std::numeric_limits<double>::infinity();
+    for (size_t i = 0; i < m_stations.size(); i++)
+    {
+      const Station &s = m_stations[i];
+      double goodput = Mbps(s.down + s.up, (s.last - s.first).GetSeconds());
+      sum += goodput;
+      squares += goodput * goodput;
+      least = std::min(least, goodput);
+    }
+    summary.Set("wifi_delivered_mb", mb);
+    summary.Set("wifi_goodput_mbps", Mbps(all.down + all.up, (all.last - all.first).GetSeconds()));
+    summary.Set("wifi_sta_goodput_mean_mbps", m_stations.empty() ? 0.0 : sum / m_stations.size());
+    summary.Set("wifi_sta_goodput_min_mbps", least);
+    summary.Set("wifi_goodput_fairness", squares > 0 ? sum * sum / (m_stations.size() * squares) : 0.0);
+    summary.Set("wall_s_per_mb", mb > 0 ? m_wall / mb : 0.0);
+    summary.Set("events_per_mb", mb > 0 ? m_events / mb : 0.0);
+  }
+
+private:
+  struct Station
+  {
+    std::string name;
+    Ipv4Address address;
+    uint64_t down; // payload bytes
+    uint64_t up;
+    Time first; // first and last delivery
+    Time last;
+  };
+
+  static double Mbps(uint64_t bytes, double seconds)
+  {
+    return seconds > 0 ? bytes * 8 / seconds / 1e6 : 0.0;
+  }
+
+  static void Deliver(WifiGoodput *goodput, uint32_t node, const Ipv4Header &header, Ptr<const Packet> packet,
+                      uint32_t interface)
+  {
+    uint32_t bytes = packet->GetSize();
+    if (header.GetProtocol() == UdpL4Protocol::PROT_NUMBER)
+    {
+      bytes = bytes > 8 ? bytes - 8 : 0;
+    }
+    else if (header.GetProtocol() == TcpL4Protocol::PROT_NUMBER)
+    {
+      TcpHeader tcp;
+      packet->PeekHeader(tcp);
+      bytes -= std::min(bytes, tcp.GetSerializedSize());
+    }
+    else
+    {
+      return;
+    }
+    if (bytes == 0)
+    {
+      return;
+    }
+    std::map<uint32_t, size_t>::const_iterator to = goodput->m_byNode.find(node);
+    if (to != goodput->m_byNode.end())
+    {
+      goodput->Count(goodput->m_stations[to->second], bytes, true);
+    }
+    std::map<uint32_t, size_t>::const_iterator from = goodput->m_byAddress.find(header.GetSource().Get());
+    if (from != goodput->m_byAddress.end())
+    {
+      goodput->Count(goodput->m_stations[from->second], bytes, false);
+    }
+    // Once per delivery, also between two stations.
+    if (to != goodput->m_byNode.end() || from != goodput->m_byAddress.end())
+    {
+      goodput->Count(goodput->m_all, bytes, to != goodput->m_byNode.end());
+    }
+  }
+
+  void Count(Station &station, uint32_t bytes, bool down)
+  {
+    if (station.down + station.up == 0)
+    {
+      station.first = Simulator::Now();
+    }
+    station.last = Simulator::Now();
+    (down ? station.down : station.up) += bytes;
+  }
+
+  std::map<uint32_t, std::string> m_names;
+  std::vector<Station> m_stations;
+  std::map<uint32_t, size_t> m_byNode;    // node id to station
+  std::map<uint32_t, size_t> m_byAddress; // address to station
+  Station m_all;                          // totals
+  double m_wall;
+  uint64_t m_events;
+};
+
+} // namespace ns3
+
+#endif /* WIFI_GOODPUT_H */
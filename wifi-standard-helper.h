@@ -0,0 +1,316 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef WIFI_STANDARD_HELPER_H
+#define WIFI_STANDARD_HELPER_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/wifi-module.h"
+
+#include <string>
+
+namespace ns3 {
+
+// Wi-Fi standard, channel width, rate manager and frame aggregation of a
+// BSS, named as on the command line and in topology files:
+//
+//   standard  a, b, g, n-2.4, n-5, ac, ax-2.4 or ax-5 (a by default, what
+//             WifiHelper uses on its own)
+//   width     channel width in MHz, 0 for the standard's default (22 for
+//             b, 80 for ac and ax-5, 20 for the others)
+//   manager   aarf, minstrel-ht (not with ax), ideal or constant
+//   mcs       the constant manager's rate: the HT, VHT or HE MCS index of
+//             one spatial stream, or the index of the standard's legacy
+//             rate (6 to 54 Mbit/s for a and g, 1 to 11 for b)
+//   ampdu     largest A-MPDU, in bytes (0: none)
+//   amsdu     largest A-MSDU, in bytes (0: none)
+//
+// Aggregation only exists from 802.11n on; ampdu and amsdu are ignored for
+// a, b and g, and set for the BE, BK and VI access categories only (VO
+// keeps ns-3's default of no A-MPDUs).  With it a transmission carries
+// several MAC frames behind one preamble and one block ack, so the PHY
+// events simulated per byte go down with the size of the aggregates.
+//
+// Check() tells whether the settings go together.  Configure() sets the
+// standard and the rate manager of a WifiHelper before Install; Apply()
+// sets the channel width and the aggregate sizes of the installed
+// devices, which configuring the standard at Install would overwrite.
+class WifiStandardHelper
+{
+public:
+  WifiStandardHelper()
+    : m_standard("a"),
+      m_width(0),
+      m_manager("aarf"),
+      m_mcs(0),
+      m_ampdu(65535),
+      m_amsdu(0)
+  {
+  }
+
+  void SetStandard(const std::string &standard)
+  {
+    m_standard = standard;
+  }
+
+  void SetChannelWidth(uint32_t width)
+  {
+    m_width = width;
+  }
+
+  // mcs only matters to the constant manager.
+  void SetRemoteStationManager(const std::string &manager, uint32_t mcs = 0)
+  {
+    m_manager = manager;
+    m_mcs = mcs;
+  }
+
+  void SetAggregation(uint32_t ampdu, uint32_t amsdu)
+  {
+    m_ampdu = ampdu;
+    m_amsdu = amsdu;
+  }
+
+  const std::string &GetStandard() const
+  {
+    return m_standard;
+  }
+
+  // 0 for the standard's default.
+  uint32_t GetChannelWidth() const
+  {
+    return m_width;
+  }
+
+  static bool IsStandard(const std::string &standard)
+  {
+    return standard == "a" || standard == "b" || standard == "g" || standard == "n-2.4" || standard == "n-5" ||
+           standard == "ac" || standard == "ax-2.4" || standard == "ax-5";
+  }
+
+  bool Is24Ghz() const
+  {
+    return m_standard == "b" || m_standard == "g" || m_standard == "n-2.4" || m_standard == "ax-2.4";
+  }
+
+  // 802.11n and later: MCS rates and aggregation.
+  bool IsHt() const
+  {
+    return m_standard.compare(0, 1, "n") == 0 || m_standard == "ac" || m_standard.compare(0, 2, "ax") == 0;
+  }
+
+  // Empty when the settings go together, else what is wrong.
+  std::string Check() const
+  {
+    if (!IsStandard(m_standard))
+    {
+      return "standard is a, b, g, n-2.4, n-5, ac, ax-2.4 or ax-5, not " + m_standard;
+    }
+    uint32_t w = m_width;
+    bool widthOk = w == 0;
+    if (m_standard == "b")
+    {
+      widthOk = widthOk || w == 22;
+    }
+    else if (m_standard == "a" || m_standard == "g")
+    {
+      widthOk = widthOk || w == 20;
+    }
+    else if (m_standard == "ac" || m_standard == "ax-5")
+    {
+      widthOk = widthOk || w == 20 || w == 40 || w == 80 || w == 160;
+    }
+    else
+    {
+      widthOk = widthOk || w == 20 || w == 40;
+    }
+    if (!widthOk)
+    {
+      return "802.11" + m_standard + " has no " + std::to_string(w) + " MHz channels";
+    }
+    if (m_manager != "aarf" && m_manager != "minstrel-ht" && m_manager != "ideal" && m_manager != "constant")
+    {
+      return "manager is aarf, minstrel-ht, ideal or constant, not " + m_manager;
+    }
+    if (m_manager == "minstrel-ht" && m_standard.compare(0, 2, "ax") == 0)
+    {
+      return "minstrel-ht has no HE rates, use ideal or constant with ax";
+    }
+    if (m_manager == "constant")
+    {
+      if (m_mcs > GetMaxMcs())
+      {
+        return "mcs of 802.11" + m_standard + " is at most " + std::to_string(GetMaxMcs());
+      }
+      // VHT MCS 9 needs 3 spatial streams on 20 MHz.
+      if (m_standard == "ac" && m_width == 20 && m_mcs == 9)
+      {
+        return "VHT MCS 9 is not allowed on 20 MHz";
+      }
+    }
+    if (IsHt())
+    {
+      uint32_t maxAmpdu = m_standard == "ac" ? 1048575 : m_standard.compare(0, 2, "ax") == 0 ? 8388607 : 65535;
+      uint32_t maxAmsdu = m_standard.compare(0, 1, "n") == 0 ? 7935 : 11398;
+      if (m_ampdu > maxAmpdu)
+      {
+        return "A-MPDUs of 802.11" + m_standard + " are at most " + std::to_string(maxAmpdu) + " bytes";
+      }
+      if (m_amsdu > maxAmsdu)
+      {
+        return "A-MSDUs of 802.11" + m_standard + " are at most " + std::to_string(maxAmsdu) + " bytes";
+      }
+    }
+    return "";
+  }
+
+  void Configure(WifiHelper &wifi) const
+  {
+    NS_ABORT_MSG_UNLESS(Check().empty(), Check());
+    wifi.SetStandard(GetWifiStandard());
+    if (m_manager == "aarf")
+    {
+      wifi.SetRemoteStationManager("ns3::AarfWifiManager");
+    }
+    else if (m_manager == "minstrel-ht")
+    {
+      wifi.SetRemoteStationManager("ns3::MinstrelHtWifiManager");
+    }
+    else if (m_manager == "ideal")
+    {
+      wifi.SetRemoteStationManager("ns3::IdealWifiManager");
+    }
+    else
+    {
+      // Control frames at the data rate too, as in the ns-3 HT examples.
+      StringValue mode(GetConstantMode());
+      wifi.SetRemoteStationManager("ns3::ConstantRateWifiManager", "DataMode", mode, "ControlMode", mode);
+    }
+  }
+
+  void Apply(const NetDeviceContainer &devices) const
+  {
+    static const char *categories[] = {"BE", "BK", "VI"};
+    for (uint32_t i = 0; i < devices.GetN(); i++)
+    {
+      Ptr<WifiNetDevice> device = DynamicCast<WifiNetDevice>(devices.Get(i));
+      if (!device)
+      {
+        continue;
+      }
+      if (m_width)
+      {
+        device->GetPhy()->SetChannelWidth(m_width);
+      }
+      for (uint32_t c = 0; IsHt() && c < sizeof(categories) / sizeof(categories[0]); c++)
+      {
+        std::string category = categories[c];
+        device->GetMac()->SetAttribute(category + "_MaxAmpduSize", UintegerValue(m_ampdu));
+        device->GetMac()->SetAttribute(category + "_MaxAmsduSize", UintegerValue(m_amsdu));
+      }
+    }
+  }
+
+private:
+  WifiStandard GetWifiStandard() const
+  {
+    if (m_standard == "b")
+    {
+      return WIFI_STANDARD_80211b;
+    }
+    if (m_standard == "g")
+    {
+      return WIFI_STANDARD_80211g;
+    }
+    if (m_standard == "n-2.4")
+    {
+      return WIFI_STANDARD_80211n_2_4GHZ;
+    }
+    if (m_standard == "n-5")
+    {
+      return WIFI_STANDARD_80211n_5GHZ;
+    }
+    if (m_standard == "ac")
+    {
+      return WIFI_STANDARD_80211ac;
+    }
+    if (m_standard == "ax-2.4")
+    {
+      return WIFI_STANDARD_80211ax_2_4GHZ;
+    }
+    if (m_standard == "ax-5")
+    {
+      return WIFI_STANDARD_80211ax_5GHZ;
+    }
+    return WIFI_STANDARD_80211a;
+  }
+
+  uint32_t GetMaxMcs() const
+  {
+    if (m_standard == "b")
+    {
+      return 3;
+    }
+    if (m_standard == "ac")
+    {
+      return 9;
+    }
+    if (m_standard.compare(0, 2, "ax") == 0)
+    {
+      return 11;
+    }
+    return 7;
+  }
+
+  std::string GetConstantMode() const
+  {
+    static const char *ofdm[] = {"6", "9", "12", "18", "24", "36", "48", "54"};
+    static const char *dsss[] = {"DsssRate1Mbps", "DsssRate2Mbps", "DsssRate5_5Mbps", "DsssRate11Mbps"};
+    std::string mcs = std::to_string(m_mcs);
+    if (m_standard == "a")
+    {
+      return std::string("OfdmRate") + ofdm[m_mcs] + "Mbps";
+    }
+    if (m_standard == "g")
+    {
+      return std::string("ErpOfdmRate") + ofdm[m_mcs] + "Mbps";
+    }
+    if (m_standard == "b")
+    {
+      return dsss[m_mcs];
+    }
+    if (m_standard == "ac")
+    {
+      return "VhtMcs" + mcs;
+    }
+    if (m_standard.compare(0, 2, "ax") == 0)
+    {
+      return "HeMcs" + mcs;
+    }
+    return "HtMcs" + mcs;
+  }
+
+  std::string m_standard;
+  uint32_t m_width;
+  std::string m_manager;
+  uint32_t m_mcs;
+  uint32_t m_ampdu;
+  uint32_t m_amsdu;
+};
+
+} // namespace ns3
+
+#endif /* WIFI_STANDARD_HELPER_H */